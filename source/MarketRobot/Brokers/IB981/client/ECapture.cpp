@@ -0,0 +1,525 @@
+#include "StdAfx.h"
+#include "ECapture.h"
+#include "EDecoder.h"
+#include "EPosixClientSocketPlatform.h"
+
+#include <string.h>
+#include <stddef.h>
+#include <assert.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#if defined(IB_POSIX)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#endif
+
+#if !defined(MSG_NOSIGNAL)
+#define MSG_NOSIGNAL 0
+#endif
+
+#define SERVE_BATCH_SIZE (64 * 1024)
+
+
+///////////////////////////////////////////////////////////
+// ECaptureWriter
+ECaptureWriter::ECaptureWriter()
+#if defined(IB_POSIX)
+	: m_fd(-1)
+	, m_map(0)
+	, m_mapSize(0)
+#else
+	: m_file(0)
+#endif
+	, m_dataEnd(0)
+{
+}
+
+ECaptureWriter::~ECaptureWriter()
+{
+	close();
+}
+
+uint64_t ECaptureWriter::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool ECaptureWriter::open(const char *path, int serverVersion, bool useV100Plus, const std::string &connectionTime)
+{
+	close();
+
+	ECaptureHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+	header.serverVersion = serverVersion;
+	header.useV100Plus = useV100Plus ? 1 : 0;
+	strncpy(header.connectionTime, connectionTime.c_str(), sizeof(header.connectionTime) - 1);
+	header.dataEnd = sizeof(header);
+
+	m_dataEnd = 0;
+
+#if defined(IB_POSIX)
+	m_fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (m_fd < 0)
+		return false;
+
+	if (!reserve(sizeof(header))) {
+		close();
+		return false;
+	}
+	memcpy(m_map, &header, sizeof(header));
+#else
+	m_file = fopen(path, "wb+");
+	if (!m_file)
+		return false;
+
+	if (fwrite(&header, sizeof(header), 1, m_file) != 1) {
+		close();
+		return false;
+	}
+#endif
+
+	m_dataEnd = sizeof(header);
+	return true;
+}
+
+bool ECaptureWriter::isOpen() const
+{
+#if defined(IB_POSIX)
+	return m_map != 0;
+#else
+	return m_file != 0;
+#endif
+}
+
+// Make sure need more bytes fit in the mapping, growing the file by whole
+// chunks.
+bool ECaptureWriter::reserve(size_t need)
+{
+#if defined(IB_POSIX)
+	if (m_map && m_dataEnd + need <= m_mapSize)
+		return true;
+
+	size_t size = (size_t)((m_dataEnd + need + CAPTURE_MAP_CHUNK - 1) / CAPTURE_MAP_CHUNK) * CAPTURE_MAP_CHUNK;
+
+	if (m_map)
+		munmap(m_map, m_mapSize);
+	m_map = 0;
+
+	if (ftruncate(m_fd, size) < 0)
+		return false;
+
+	void *map = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+	if (map == MAP_FAILED)
+		return false;
+
+	m_map = (char *)map;
+	m_mapSize = size;
+#endif
+	return true;
+}
+
+bool ECaptureWriter::append(uint64_t timestamp, const char *buf, size_t sz)
+{
+	if (!isOpen())
+		return false;
+
+	uint32_t len = (uint32_t)sz;
+
+#if defined(IB_POSIX)
+	if (!reserve(CAPTURE_RECORD_HEADER + sz)) {
+		close();
+		return false;
+	}
+
+	char *p = m_map + m_dataEnd;
+	memcpy(p, &timestamp, sizeof(timestamp));
+	memcpy(p + sizeof(timestamp), &len, sizeof(len));
+	memcpy(p + CAPTURE_RECORD_HEADER, buf, sz);
+
+	m_dataEnd += CAPTURE_RECORD_HEADER + sz;
+	memcpy(m_map + offsetof(ECaptureHeader, dataEnd), &m_dataEnd, sizeof(m_dataEnd));
+#else
+	if (fwrite(&timestamp, sizeof(timestamp), 1, m_file) != 1
+		|| fwrite(&len, sizeof(len), 1, m_file) != 1
+		|| fwrite(buf, 1, sz, m_file) != sz) {
+		close();
+		return false;
+	}
+
+	m_dataEnd += CAPTURE_RECORD_HEADER + sz;
+#endif
+	return true;
+}
+
+// Cuts the file to the recorded data.
+void ECaptureWriter::close()
+{
+#if defined(IB_POSIX)
+	if (m_map)
+		munmap(m_map, m_mapSize);
+	m_map = 0;
+	m_mapSize = 0;
+
+	if (m_fd >= 0) {
+		if (m_dataEnd > 0 && ftruncate(m_fd, m_dataEnd) < 0)
+			m_dataEnd = 0;
+		::close(m_fd);
+	}
+	m_fd = -1;
+#else
+	if (m_file) {
+		if (m_dataEnd > 0) {
+			fseek(m_file, offsetof(ECaptureHeader, dataEnd), SEEK_SET);
+			fwrite(&m_dataEnd, sizeof(m_dataEnd), 1, m_file);
+		}
+		fclose(m_file);
+	}
+	m_file = 0;
+#endif
+	m_dataEnd = 0;
+}
+
+
+///////////////////////////////////////////////////////////
+// ECaptureReader
+ECaptureReader::ECaptureReader()
+	: m_data(0)
+	, m_size(0)
+#if defined(IB_POSIX)
+	, m_mapSize(0)
+#endif
+{
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+ECaptureReader::~ECaptureReader()
+{
+	close();
+}
+
+bool ECaptureReader::open(const char *path)
+{
+	close();
+
+#if defined(IB_POSIX)
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(ECaptureHeader)) {
+		::close(fd);
+		return false;
+	}
+
+	void *map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (map == MAP_FAILED)
+		return false;
+
+	m_data = (const char *)map;
+	m_mapSize = st.st_size;
+	m_size = st.st_size;
+#else
+	FILE *file = fopen(path, "rb");
+	if (!file)
+		return false;
+
+	char buf[64 * 1024];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), file)) > 0)
+		m_content.append(buf, n);
+	fclose(file);
+
+	if (m_content.size() < sizeof(ECaptureHeader))
+		return false;
+
+	m_data = m_content.data();
+	m_size = m_content.size();
+#endif
+
+	memcpy(&m_header, m_data, sizeof(m_header));
+
+	if (memcmp(m_header.magic, CAPTURE_MAGIC, sizeof(m_header.magic)) != 0
+		|| m_header.dataEnd < sizeof(m_header) || m_header.dataEnd > m_size) {
+		close();
+		return false;
+	}
+
+	m_header.connectionTime[sizeof(m_header.connectionTime) - 1] = 0;
+	m_size = (size_t)m_header.dataEnd;
+	return true;
+}
+
+void ECaptureReader::close()
+{
+#if defined(IB_POSIX)
+	if (m_data)
+		munmap((void *)m_data, m_mapSize);
+	m_mapSize = 0;
+#else
+	m_content.clear();
+#endif
+	m_data = 0;
+	m_size = 0;
+}
+
+int ECaptureReader::serverVersion() const
+{
+	return m_header.serverVersion;
+}
+
+bool ECaptureReader::useV100Plus() const
+{
+	return m_header.useV100Plus != 0;
+}
+
+std::string ECaptureReader::connectionTime() const
+{
+	return m_header.connectionTime;
+}
+
+bool ECaptureReader::next(size_t &pos, uint64_t &timestamp, const char *&beginPtr, const char *&endPtr) const
+{
+	if (pos < sizeof(ECaptureHeader))
+		pos = sizeof(ECaptureHeader);
+
+	if (pos + CAPTURE_RECORD_HEADER > m_size)
+		return false;
+
+	uint32_t len;
+	memcpy(&timestamp, m_data + pos, sizeof(timestamp));
+	memcpy(&len, m_data + pos + sizeof(timestamp), sizeof(len));
+
+	if (pos + CAPTURE_RECORD_HEADER + len > m_size)
+		return false;
+
+	beginPtr = m_data + pos + CAPTURE_RECORD_HEADER;
+	endPtr = beginPtr + len;
+	pos += CAPTURE_RECORD_HEADER + len;
+	return true;
+}
+
+
+///////////////////////////////////////////////////////////
+// ECaptureServer
+ECaptureServer::ECaptureServer(const ECaptureReader &capture)
+	: m_capture(capture)
+	, m_listenFd(-1)
+	, m_port(0)
+{
+	SocketsInit();
+}
+
+ECaptureServer::~ECaptureServer()
+{
+	if (m_listenFd >= 0)
+		SocketClose(m_listenFd);
+	SocketsDestroy();
+}
+
+bool ECaptureServer::listen(int port)
+{
+	m_listenFd = socket(AF_INET, SOCK_STREAM, 0);
+	if (m_listenFd < 0)
+		return false;
+
+	int on = 1;
+	setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, (const char *)&on, sizeof(on));
+
+	struct sockaddr_in sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons(port);
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	socklen_t len = sizeof(sa);
+	if (bind(m_listenFd, (struct sockaddr *)&sa, sizeof(sa)) < 0
+		|| ::listen(m_listenFd, 1) < 0
+		|| getsockname(m_listenFd, (struct sockaddr *)&sa, &len) < 0) {
+		SocketClose(m_listenFd);
+		m_listenFd = -1;
+		return false;
+	}
+
+	m_port = ntohs(sa.sin_port);
+	return true;
+}
+
+int ECaptureServer::port() const
+{
+	return m_port;
+}
+
+static bool recvAll(int fd, char *buf, size_t sz)
+{
+	while (sz > 0) {
+		int n = recv(fd, buf, sz, 0);
+		if (n <= 0)
+			return false;
+		buf += n;
+		sz -= n;
+	}
+	return true;
+}
+
+// Read and drop whatever the client sent; false once it disconnected.
+static bool drainRequests(int fd, bool wait)
+{
+	char buf[4096];
+
+	for (;;) {
+		fd_set readSet;
+		FD_ZERO(&readSet);
+		FD_SET(fd, &readSet);
+
+		struct timeval tval;
+		tval.tv_sec = wait ? 1 : 0;
+		tval.tv_usec = 0;
+
+		int ret = select(fd + 1, &readSet, 0, 0, &tval);
+		if (ret < 0)
+			return false;
+		if (ret == 0)
+			return true;
+
+		if (recv(fd, buf, sizeof(buf), 0) <= 0)
+			return false;
+	}
+}
+
+bool ECaptureServer::sendAll(int fd, const char *buf, size_t sz)
+{
+	while (sz > 0) {
+		int n = send(fd, buf, sz, MSG_NOSIGNAL);
+		if (n <= 0)
+			return false;
+		buf += n;
+		sz -= n;
+	}
+	return true;
+}
+
+// Accept the client version (the "API\0" prefixed V100 one or a legacy
+// version field), answer with the recorded server version and time and wait
+// for the client to start the API.
+bool ECaptureServer::handshake(int fd, bool &useV100Plus)
+{
+	// the first field is either the "API" sign or the legacy client version
+	std::string first;
+	char c;
+	do {
+		if (!recvAll(fd, &c, 1) || first.size() > 16)
+			return false;
+		if (c)
+			first.push_back(c);
+	} while (c);
+
+	useV100Plus = first == "API";
+
+	if (useV100Plus) {
+		unsigned netlen;
+		if (!recvAll(fd, (char *)&netlen, HEADER_LEN))
+			return false;
+
+		std::vector<char> versions(ntohl(netlen));
+		if (!versions.empty() && !recvAll(fd, versions.data(), versions.size()))
+			return false;
+	}
+
+	char version[16];
+	snprintf(version, sizeof(version), "%d", m_capture.serverVersion());
+
+	std::string ack(version);
+	ack.push_back(0);
+	ack += m_capture.connectionTime();
+	ack.push_back(0);
+
+	if (useV100Plus) {
+		unsigned netlen = htonl((unsigned)ack.size());
+		ack.insert(0, (const char *)&netlen, HEADER_LEN);
+	}
+
+	if (!sendAll(fd, ack.data(), ack.size()))
+		return false;
+
+	// TWS is silent until startApi, the connect reader would eat any frame
+	fd_set readSet;
+	FD_ZERO(&readSet);
+	FD_SET(fd, &readSet);
+
+	return select(fd + 1, &readSet, 0, 0, 0) > 0 && drainRequests(fd, false);
+}
+
+long ECaptureServer::serve(bool paced)
+{
+	int fd = accept(m_listenFd, 0, 0);
+	if (fd < 0)
+		return -1;
+
+	int on = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (const char *)&on, sizeof(on));
+
+	bool useV100Plus = false;
+	if (!handshake(fd, useV100Plus)) {
+		SocketClose(fd);
+		return -1;
+	}
+
+	std::vector<char> out;
+	out.reserve(SERVE_BATCH_SIZE + HEADER_LEN + MAX_MSG_LEN);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	uint64_t first = 0;
+	long nFrames = 0;
+	bool ok = true;
+
+	size_t pos = 0;
+	uint64_t timestamp;
+	const char *beginPtr;
+	const char *endPtr;
+
+	while (ok && m_capture.next(pos, timestamp, beginPtr, endPtr)) {
+		if (paced) {
+			if (nFrames == 0)
+				first = timestamp;
+
+			std::chrono::steady_clock::time_point due = start + std::chrono::nanoseconds(timestamp - first);
+
+			if (due > std::chrono::steady_clock::now()) {
+				// send what is due before sleeping until the next frame
+				ok = sendAll(fd, out.data(), out.size()) && drainRequests(fd, false);
+				out.clear();
+				std::this_thread::sleep_until(due);
+			}
+		}
+
+		if (useV100Plus) {
+			unsigned netlen = htonl((unsigned)(endPtr - beginPtr));
+			out.insert(out.end(), (const char *)&netlen, (const char *)&netlen + HEADER_LEN);
+		}
+		out.insert(out.end(), beginPtr, endPtr);
+		++nFrames;
+
+		if (out.size() >= SERVE_BATCH_SIZE) {
+			ok = ok && sendAll(fd, out.data(), out.size()) && drainRequests(fd, false);
+			out.clear();
+		}
+	}
+
+	bool sent = ok && sendAll(fd, out.data(), out.size());
+
+	// like TWS, keep the session open until the client leaves
+	while (sent && drainRequests(fd, true))
+		;
+
+	SocketClose(fd);
+	return sent ? nFrames : -1;
+}
@@ -0,0 +1,130 @@
+#pragma once
+#ifndef TWS_API_CLIENT_ECAPTURE_H
+#define TWS_API_CLIENT_ECAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include "platformspecific.h"
+
+#define CAPTURE_MAGIC "TWSCAP01"
+#define CAPTURE_MAP_CHUNK (64 * 1024 * 1024)
+
+// Capture of the inbound TWS stream: a header with what the connect handshake
+// needs to be replayed, followed by one record per frame
+//
+//     uint64_t timestamp   monotonic nanoseconds at arrival
+//     uint32_t len         payload length
+//     char     payload[len] frame without its V100 length prefix
+//
+// Fields are stored in host byte order; a capture is replayed on the machine
+// type it was taken on.
+struct ECaptureHeader
+{
+    char magic[8];
+    int32_t serverVersion;
+    int32_t useV100Plus;
+    char connectionTime[48];
+    uint64_t dataEnd;           // file offset behind the last complete record
+};
+
+const size_t CAPTURE_RECORD_HEADER = sizeof(uint64_t) + sizeof(uint32_t);
+
+// Appends frames to a capture file. The file is memory mapped and grown in
+// CAPTURE_MAP_CHUNK steps, so a record costs a copy and no system call; the
+// header tracks the last complete record and is valid at any time.
+class TWSAPIDLLEXP ECaptureWriter
+{
+#if defined(IB_POSIX)
+    int m_fd;
+    char *m_map;
+    size_t m_mapSize;
+#else
+    FILE *m_file;
+#endif
+    uint64_t m_dataEnd;
+
+    bool reserve(size_t need);
+
+public:
+    ECaptureWriter();
+    ~ECaptureWriter();
+
+    bool open(const char *path, int serverVersion, bool useV100Plus, const std::string &connectionTime);
+    bool isOpen() const;
+    bool append(uint64_t timestamp, const char *buf, size_t sz);
+    void close();
+
+    static uint64_t now();
+
+private:
+    // disable copy (compatible with pre C++11 compiler hence =delete not used)
+    ECaptureWriter(const ECaptureWriter&);
+    ECaptureWriter& operator=(const ECaptureWriter&);
+};
+
+// Read-only view of a capture file.
+class TWSAPIDLLEXP ECaptureReader
+{
+    const char *m_data;
+    size_t m_size;
+#if defined(IB_POSIX)
+    size_t m_mapSize;
+#else
+    std::string m_content;
+#endif
+    ECaptureHeader m_header;
+
+public:
+    ECaptureReader();
+    ~ECaptureReader();
+
+    bool open(const char *path);
+    void close();
+
+    int serverVersion() const;
+    bool useV100Plus() const;
+    std::string connectionTime() const;
+
+    // walk the records; start with pos = 0, returns false behind the last one
+    bool next(size_t &pos, uint64_t &timestamp, const char *&beginPtr, const char *&endPtr) const;
+
+private:
+    // disable copy (compatible with pre C++11 compiler hence =delete not used)
+    ECaptureReader(const ECaptureReader&);
+    ECaptureReader& operator=(const ECaptureReader&);
+};
+
+// Stand-in for TWS serving a capture over a loopback socket: it completes the
+// connect handshake of EClientSocket with the recorded server version, then
+// sends the recorded frames either at their recorded pace or as fast as the
+// client reads them. Requests of the client are read and dropped.
+class TWSAPIDLLEXP ECaptureServer
+{
+    const ECaptureReader &m_capture;
+    int m_listenFd;
+    int m_port;
+
+    bool handshake(int fd, bool &useV100Plus);
+    bool sendAll(int fd, const char *buf, size_t sz);
+
+public:
+    explicit ECaptureServer(const ECaptureReader &capture);
+    ~ECaptureServer();
+
+    // port 0 picks a free one, see port()
+    bool listen(int port = 0);
+    int port() const;
+
+    // serve one client until it disconnects; returns the number of frames
+    // sent or -1 when the client went away before the end of the capture
+    long serve(bool paced);
+
+private:
+    // disable copy (compatible with pre C++11 compiler hence =delete not used)
+    ECaptureServer(const ECaptureServer&);
+    ECaptureServer& operator=(const ECaptureServer&);
+};
+
+#endif
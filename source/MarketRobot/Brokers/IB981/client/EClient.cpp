@@ -20,6 +20,7 @@
 #include "ETransport.h"
 #include "FamilyCode.h"
 #include "EClientException.h"
+#include "EEncodeBuffer.h"
 
 #include <sstream>
 #include <iomanip>
@@ -32,6 +33,15 @@
 
 using namespace ibapi::client_constants;
 
+// requests are encoded into a buffer owned by the calling thread, it keeps its
+// storage from one request to the next
+static EEncodeBuffer& encodeBuffer()
+{
+    static thread_local EEncodeBuffer buffer;
+
+    return buffer;
+}
+
 ///////////////////////////////////////////////////////////
 // encoders
 template<>
@@ -56,6 +66,11 @@ void EClient::EncodeField(std::ostream& os, T value)
     os << value << '\0';
 }
 
+// used by the order conditions, which no longer get them through the requests
+template void EClient::EncodeField<int>(std::ostream& os, int);
+template void EClient::EncodeField<long>(std::ostream& os, long);
+template void EClient::EncodeField<const char*>(std::ostream& os, const char*);
+
 template<> 
 void EClient::EncodeField<std::string>(std::ostream& os, std::string value)
 {
@@ -66,6 +81,15 @@ void EClient::EncodeField<std::string>(std::ostream& os, std::string value)
     EncodeField<std::string&>(os, value);
 }
 
+void EClient::EncodeField(EEncodeBuffer& buf, const std::string& value)
+{
+    if (!value.empty() && !isAsciiPrintable(value)) {
+        throw EClientException(INVALID_SYMBOL, value);
+    }
+
+    buf.encode(value);
+}
+
 bool EClient::isAsciiPrintable(const std::string& s)
 {
     return std::all_of(s.begin(), s.end(), [](char c) {
@@ -109,6 +133,25 @@ void EClient::EncodeTagValueList(std::ostream& os, const TagValueListSPtr &tagVa
     EncodeField(os, tagValueListStr);
 }
 
+void EClient::EncodeTagValueList(EEncodeBuffer& os, const TagValueListSPtr &tagValueList) 
+{
+    std::string tagValueListStr("");
+    const int tagValueListCount = tagValueList.get() ? tagValueList->size() : 0;
+
+    if (tagValueListCount > 0) {
+        for (int i = 0; i < tagValueListCount; ++i) {
+            const TagValue* tagValue = ((*tagValueList)[i]).get();
+
+            tagValueListStr += tagValue->tag;
+            tagValueListStr += "=";
+            tagValueListStr += tagValue->value;
+            tagValueListStr += ";";
+        }
+    }
+
+    EncodeField(os, tagValueListStr);
+}
+
 ///////////////////////////////////////////////////////////
 // "max" encoders
 void EClient::EncodeFieldMax(std::ostream& os, int intValue)
@@ -129,6 +172,24 @@ void EClient::EncodeFieldMax(std::ostream& os, double doubleValue)
     EncodeField(os, doubleValue);
 }
 
+void EClient::EncodeFieldMax(EEncodeBuffer& os, double doubleValue)
+{
+    if( doubleValue == DBL_MAX) {
+        os.encode("");
+        return;
+    }
+    os.encode(doubleValue);
+}
+
+void EClient::EncodeFieldMax(EEncodeBuffer& os, int intValue)
+{
+    if( intValue == INT_MAX) {
+        os.encode("");
+        return;
+    }
+    os.encode(intValue);
+}
+
 
 ///////////////////////////////////////////////////////////
 // member funcs
@@ -266,7 +327,7 @@ void EClient::reqMktData(TickerId tickerId, const Contract& contract,
         }
     }
 
-    std::stringstream msg;
+    EEncodeBuffer& msg = encodeBuffer();
     prepareBuffer( msg);
 
     try {
@@ -346,7 +407,7 @@ void EClient::reqMktData(TickerId tickerId, const Contract& contract,
         return;
     }
 
-    closeAndSend( msg.str());
+    closeAndSend( msg);
 }
 
 void EClient::cancelMktData(TickerId tickerId)
@@ -405,7 +466,7 @@ void EClient::reqMktDepth( TickerId tickerId, const Contract& contract, int numR
         return;
     }
 
-    std::stringstream msg;
+    EEncodeBuffer& msg = encodeBuffer();
     prepareBuffer( msg);
 
     try {
@@ -452,7 +513,7 @@ void EClient::reqMktDepth( TickerId tickerId, const Contract& contract, int numR
         return;
     }
 
-    closeAndSend( msg.str());
+    closeAndSend( msg);
 }
 
 
@@ -519,7 +580,7 @@ void EClient::reqHistoricalData(TickerId tickerId, const Contract& contract,
         }
     }
 
-    std::stringstream msg;
+    EEncodeBuffer& msg = encodeBuffer();
     prepareBuffer(msg);
 
     try {
@@ -592,7 +653,7 @@ void EClient::reqHistoricalData(TickerId tickerId, const Contract& contract,
         return;
     }
 
-    closeAndSend(msg.str());
+    closeAndSend(msg);
 }
 
 void EClient::cancelHistoricalData(TickerId tickerId)
@@ -647,7 +708,7 @@ void EClient::reqRealTimeBars(TickerId tickerId, const Contract& contract,
         }
     }
 
-    std::stringstream msg;
+    EEncodeBuffer& msg = encodeBuffer();
     prepareBuffer( msg);
 
     try {
@@ -688,7 +749,7 @@ void EClient::reqRealTimeBars(TickerId tickerId, const Contract& contract,
         return;
     }
 
-    closeAndSend( msg.str());
+    closeAndSend( msg);
 }
 
 
@@ -1239,7 +1300,64 @@ void EClient::reqCurrentTime()
     closeAndSend( msg.str());
 }
 
+void EClient::encodeOrderContract(EEncodeBuffer& msg, const Contract& contract)
+{
+    if( m_serverVersion >= MIN_SERVER_VER_PLACE_ORDER_CONID) {
+        ENCODE_FIELD( contract.conId);
+    }
+    ENCODE_FIELD( contract.symbol);
+    ENCODE_FIELD( contract.secType);
+    ENCODE_FIELD( contract.lastTradeDateOrContractMonth);
+    ENCODE_FIELD( contract.strike);
+    ENCODE_FIELD( contract.right);
+    ENCODE_FIELD( contract.multiplier); // srv v15 and above
+    ENCODE_FIELD( contract.exchange);
+    ENCODE_FIELD( contract.primaryExchange); // srv v14 and above
+    ENCODE_FIELD( contract.currency);
+    ENCODE_FIELD( contract.localSymbol); // srv v2 and above
+    if( m_serverVersion >= MIN_SERVER_VER_TRADING_CLASS) {
+        ENCODE_FIELD( contract.tradingClass);
+    }
+
+    if( m_serverVersion >= MIN_SERVER_VER_SEC_ID_TYPE){
+        ENCODE_FIELD( contract.secIdType);
+        ENCODE_FIELD( contract.secId);
+    }
+}
+
+bool EClient::encodeOrderContract(const Contract& contract, std::string& encoded)
+{
+    // not connected?
+    if( !isConnected()) {
+        m_pEWrapper->error( NO_VALID_ID, NOT_CONNECTED.code(), NOT_CONNECTED.msg());
+        return false;
+    }
+
+    EEncodeBuffer msg(256);
+
+    try {
+        encodeOrderContract(msg, contract);
+    }
+    catch (EClientException& ex) {
+        m_pEWrapper->error(NO_VALID_ID, ex.error().code(), ex.error().msg() + ex.text());
+        return false;
+    }
+
+    encoded.assign(msg.data(), msg.size());
+    return true;
+}
+
 void EClient::placeOrder( OrderId id, const Contract& contract, const Order& order)
+{
+    placeOrderImpl( id, contract, order, 0);
+}
+
+void EClient::placeOrder( OrderId id, const Contract& contract, const Order& order, const std::string& encodedContract)
+{
+    placeOrderImpl( id, contract, order, &encodedContract);
+}
+
+void EClient::placeOrderImpl( OrderId id, const Contract& contract, const Order& order, const std::string* encodedContract)
 {
     // not connected?
     if( !isConnected()) {
@@ -1545,7 +1663,7 @@ void EClient::placeOrder( OrderId id, const Contract& contract, const Order& ord
             return;
     }
 
-    std::stringstream msg;
+    EEncodeBuffer& msg = encodeBuffer();
     prepareBuffer( msg);
 
     try {
@@ -1561,27 +1679,10 @@ void EClient::placeOrder( OrderId id, const Contract& contract, const Order& ord
         ENCODE_FIELD( id);
 
         // send contract fields
-        if( m_serverVersion >= MIN_SERVER_VER_PLACE_ORDER_CONID) {
-            ENCODE_FIELD( contract.conId);
-        }
-        ENCODE_FIELD( contract.symbol);
-        ENCODE_FIELD( contract.secType);
-        ENCODE_FIELD( contract.lastTradeDateOrContractMonth);
-        ENCODE_FIELD( contract.strike);
-        ENCODE_FIELD( contract.right);
-        ENCODE_FIELD( contract.multiplier); // srv v15 and above
-        ENCODE_FIELD( contract.exchange);
-        ENCODE_FIELD( contract.primaryExchange); // srv v14 and above
-        ENCODE_FIELD( contract.currency);
-        ENCODE_FIELD( contract.localSymbol); // srv v2 and above
-        if( m_serverVersion >= MIN_SERVER_VER_TRADING_CLASS) {
-            ENCODE_FIELD( contract.tradingClass);
-        }
-
-        if( m_serverVersion >= MIN_SERVER_VER_SEC_ID_TYPE){
-            ENCODE_FIELD( contract.secIdType);
-            ENCODE_FIELD( contract.secId);
-        }
+        if (encodedContract)
+            msg.append(encodedContract->data(), encodedContract->size());
+        else
+            encodeOrderContract(msg, contract);
 
         // send main order fields
         ENCODE_FIELD( order.action);
@@ -1907,7 +2008,9 @@ void EClient::placeOrder( OrderId id, const Contract& contract, const Order& ord
             if (order.conditions.size() > 0) {
                 for (std::shared_ptr<OrderCondition> item : order.conditions) {
                     ENCODE_FIELD(item->type());
-                    item->writeExternal(msg);
+                    std::stringstream condition;
+                    item->writeExternal(condition);
+                    msg.append(condition.str().data(), condition.str().size());
                 }
 
                 ENCODE_FIELD(order.conditionsIgnoreRth);
@@ -1967,7 +2070,7 @@ void EClient::placeOrder( OrderId id, const Contract& contract, const Order& ord
         return;
     }
 
-    closeAndSend( msg.str());
+    closeAndSend( msg);
 }
 
 void EClient::cancelOrder( OrderId id)
@@ -1981,14 +2084,14 @@ void EClient::cancelOrder( OrderId id)
     const int VERSION = 1;
 
     // send cancel order msg
-    std::stringstream msg;
+    EEncodeBuffer& msg = encodeBuffer();
     prepareBuffer( msg);
 
     ENCODE_FIELD( CANCEL_ORDER);
     ENCODE_FIELD( VERSION);
     ENCODE_FIELD( id);
 
-    closeAndSend( msg.str());
+    closeAndSend( msg);
 }
 
 void EClient::reqAccountUpdates(bool subscribe, const std::string& acctCode)
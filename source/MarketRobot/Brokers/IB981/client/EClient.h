@@ -13,6 +13,7 @@
 #include "CommonDefs.h"
 #include "TagValue.h"
 #include "Contract.h"
+#include "EEncodeBuffer.h"
 
 namespace ibapi {
 namespace client_constants {
@@ -268,6 +269,11 @@ public:
 		const std::string& genericTicks, bool snapshot, bool regulatorySnaphsot, const TagValueListSPtr& mktDataOptions);
 	void cancelMktData(TickerId id);
 	void placeOrder(OrderId id, const Contract& contract, const Order& order);
+	// Pre-encodes the contract fields of placeOrder() for the connected server;
+	// orders on that contract can then be sent with the bytes instead of
+	// formatting the contract again. Encode again after reconnecting.
+	bool encodeOrderContract(const Contract& contract, std::string& encoded);
+	void placeOrder(OrderId id, const Contract& contract, const Order& order, const std::string& encodedContract);
 	void cancelOrder(OrderId id) ;
 	void reqOpenOrders();
 	void reqAccountUpdates(bool subscribe, const std::string& acctCode);
@@ -366,10 +372,14 @@ protected:
 	virtual void prepareBuffer(std::ostream&) const = 0;
 	virtual bool closeAndSend(std::string msg, unsigned offset = 0) = 0;
 	virtual int bufferedSend(const std::string& msg);
+	virtual void prepareBuffer(EEncodeBuffer&) const = 0;
+	virtual bool closeAndSend(EEncodeBuffer& msg) = 0;
 
 
    	// encoders
 	template<class T> static void EncodeField(std::ostream&, T);
+	template<class T> static void EncodeField(EEncodeBuffer& buf, T value) { buf.encode(value); }
+	static void EncodeField(EEncodeBuffer& buf, const std::string& value);
 
 public:
 	void startApi();
@@ -378,10 +388,17 @@ public:
 
     void EncodeContract(std::ostream& os, const Contract &contract);
     void EncodeTagValueList(std::ostream& os, const TagValueListSPtr &tagValueList);
+    void EncodeTagValueList(EEncodeBuffer& os, const TagValueListSPtr &tagValueList);
 
 	// "max" encoders
 	static void EncodeFieldMax(std::ostream& os, int);
 	static void EncodeFieldMax(std::ostream& os, double);
+	static void EncodeFieldMax(EEncodeBuffer& os, int);
+	static void EncodeFieldMax(EEncodeBuffer& os, double);
+
+private:
+	void encodeOrderContract(EEncodeBuffer& msg, const Contract& contract);
+	void placeOrderImpl(OrderId id, const Contract& contract, const Order& order, const std::string* encodedContract);
 
 	// socket state
 private:
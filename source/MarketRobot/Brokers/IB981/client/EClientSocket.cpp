@@ -18,6 +18,11 @@
 #include <assert.h>
 #include <ostream>
 
+#if defined(IB_EPOLL)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
 
 const int MIN_SERVER_VER_SUPPORTED    = 38; //all supported server versions are defined in EDecoder.h
 
@@ -26,14 +31,41 @@ const int MIN_SERVER_VER_SUPPORTED    = 38; //all supported server versions are
 EClientSocket::EClientSocket(EWrapper *ptr, EReaderSignal *pSignal) : EClient( ptr, new ESocket())
 {
 	m_fd = SocketsInit() ? -1 : -2;
+	m_pollFd = -1;
+	m_wakeFd = -1;
     m_allowRedirect = false;
     m_asyncEConnect = false;
     m_pSignal = pSignal;
     m_redirectCount = 0;
+
+#if defined(IB_EPOLL)
+	m_pollFd = epoll_create1(EPOLL_CLOEXEC);
+	m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	struct epoll_event ev;
+	memset( &ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLET;
+	ev.data.fd = m_wakeFd;
+
+	if( m_pollFd < 0 || m_wakeFd < 0 || epoll_ctl( m_pollFd, EPOLL_CTL_ADD, m_wakeFd, &ev) < 0) {
+		// fall back to select() in EReader
+		if( m_pollFd >= 0)
+			close( m_pollFd);
+		if( m_wakeFd >= 0)
+			close( m_wakeFd);
+		m_pollFd = m_wakeFd = -1;
+	}
+#endif
 }
 
 EClientSocket::~EClientSocket()
 {
+#if defined(IB_EPOLL)
+	if( m_pollFd >= 0) {
+		close( m_pollFd);
+		close( m_wakeFd);
+	}
+#endif
 	if( m_fd != -2)
 		SocketsDestroy();
 }
@@ -128,6 +160,10 @@ bool EClientSocket::eConnectImpl(int clientId, bool extraAuth, ConnState* stateO
 		return false;
 	}
 
+	// requests are small and latency bound, never let Nagle hold one back;
+	// bursts are coalesced explicitly with cork()/flush()
+	SetSocketNoDelay( m_fd);
+
     getTransport()->fd(m_fd);
 
 	// set client id
@@ -158,6 +194,22 @@ bool EClientSocket::eConnectImpl(int clientId, bool extraAuth, ConnState* stateO
 		return false;
 	}
 
+#if defined(IB_EPOLL)
+	if( m_pollFd >= 0) {
+		// edge-triggered: EReader reads until the socket is drained
+		struct epoll_event ev;
+		memset( &ev, 0, sizeof(ev));
+		ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+		ev.data.fd = m_fd;
+
+		if( epoll_ctl( m_pollFd, EPOLL_CTL_ADD, m_fd, &ev) < 0) {
+			eDisconnect();
+			getWrapper()->error( NO_VALID_ID, CONNECT_FAIL.code(), CONNECT_FAIL.msg());
+			return false;
+		}
+	}
+#endif
+
 	assert( connState() == CS_CONNECTED);
 	if( stateOutPt) {
 		*stateOutPt = connState();
@@ -208,6 +260,29 @@ bool EClientSocket::closeAndSend(std::string msg, unsigned offset)
     return true;
 }
 
+// The message is sent straight from the encode buffer; its header was
+// reserved by prepareBuffer().
+bool EClientSocket::closeAndSend(EEncodeBuffer& msg)
+{
+	assert( msg.size() > 0);
+	if( m_useV100Plus) {
+		assert( msg.size() > (size_t)HEADER_LEN);
+		unsigned len = msg.size() - HEADER_LEN;
+		if( len > MAX_MSG_LEN) {
+			m_pEWrapper->error( NO_VALID_ID, BAD_LENGTH.code(), BAD_LENGTH.msg());
+		}
+		else {
+			unsigned netlen = htonl( len);
+			memcpy( msg.data(), &netlen, HEADER_LEN);
+		}
+	}
+
+	if (getTransport()->bufferedSend(msg.data(), msg.size()) == -1)
+        return handleSocketError();
+
+    return true;
+}
+
 void EClientSocket::prepareBufferImpl(std::ostream& buf) const
 {
 	assert( m_useV100Plus);
@@ -225,13 +300,44 @@ void EClientSocket::prepareBuffer(std::ostream& buf) const
 	prepareBufferImpl( buf);
 }
 
+void EClientSocket::prepareBuffer(EEncodeBuffer& buf) const
+{
+	buf.clear();
+
+	if( !m_useV100Plus)
+		return;
+
+	char header[HEADER_LEN] = { 0 };
+	buf.append( header, sizeof(header));
+}
+
 void EClientSocket::eDisconnect(bool resetState)
 {
-	if ( m_fd >= 0 )
+	bool closed = false;
+
+	if ( m_fd >= 0 ) {
+#if defined(IB_EPOLL)
+		if( m_pollFd >= 0)
+			epoll_ctl( m_pollFd, EPOLL_CTL_DEL, m_fd, 0);
+#endif
 		// close socket
 			SocketClose( m_fd);
+		closed = true;
+	}
 	m_fd = -1;
 
+#if defined(IB_EPOLL)
+	if( closed && m_pollFd >= 0) {
+		// wake up a reader blocked in epoll_wait()
+		uint64_t one = 1;
+		if( write( m_wakeFd, &one, sizeof(one)) < 0) {
+			// counter saturated, the reader is awake already
+		}
+	}
+#else
+	(void)closed;
+#endif
+
     if (resetState) {
 	    eDisconnectBase();
     }
@@ -247,6 +353,11 @@ int EClientSocket::fd() const
 	return m_fd;
 }
 
+int EClientSocket::pollFd() const
+{
+	return m_pollFd;
+}
+
 int EClientSocket::receive(char* buf, size_t sz)
 {
 	if( sz <= 0)
@@ -338,6 +449,19 @@ bool EClientSocket::handleSocketError()
 }
 
 
+void EClientSocket::cork()
+{
+	getTransport()->cork();
+}
+
+bool EClientSocket::flush()
+{
+	if (getTransport()->flush() == -1)
+		return handleSocketError();
+
+	return true;
+}
+
 ///////////////////////////////////////////////////////////
 // callbacks from socket
 
@@ -357,3 +481,15 @@ void EClientSocket::onError()
 {
 	handleSocketError();
 }
+
+///////////////////////////////////////////////////////////
+// ESendBatch
+ESendBatch::ESendBatch(EClientSocket& client) : m_client(client)
+{
+	m_client.cork();
+}
+
+ESendBatch::~ESendBatch()
+{
+	m_client.flush();
+}
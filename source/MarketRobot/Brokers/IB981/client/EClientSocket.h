@@ -19,6 +19,8 @@ protected:
     virtual void prepareBufferImpl(std::ostream&) const;
 	virtual void prepareBuffer(std::ostream&) const;
 	virtual bool closeAndSend(std::string msg, unsigned offset = 0);
+	virtual void prepareBuffer(EEncodeBuffer&) const;
+	virtual bool closeAndSend(EEncodeBuffer& msg);
 
 public:
 
@@ -32,6 +34,7 @@ public:
 
 	bool isSocketOK() const;
 	int fd() const;
+	int pollFd() const;
     bool asyncEConnect() const;
     void asyncEConnect(bool val);
     ESocket *getTransport();
@@ -39,6 +42,11 @@ public:
     void allowRedirect(bool v);
     bool allowRedirect() const; 
 
+    // queue the requests of this thread until the matching flush(), which
+    // sends them with one write
+    void cork();
+    bool flush();
+
 private:
 
 	bool eConnectImpl(int clientId, bool extraAuth, ConnState* stateOutPt);
@@ -61,6 +69,8 @@ private:
 private:
 
 	std::atomic<int> m_fd;
+	int m_pollFd;	// epoll instance watching m_fd, -1 where select() is used
+	int m_wakeFd;	// eventfd in m_pollFd, signalled on disconnect to wake the reader
     bool m_allowRedirect;    
     bool m_asyncEConnect;
     EReaderSignal *m_pSignal;
@@ -74,4 +84,19 @@ public:
     void redirect(const char *host, int port);    
 };
 
+// Corks the client for the lifetime of the guard, e.g. around a burst of
+// subscriptions or cancels.
+class TWSAPIDLLEXP ESendBatch
+{
+    EClientSocket& m_client;
+public:
+    explicit ESendBatch(EClientSocket& client);
+    ~ESendBatch();
+
+private:
+    // disable copy (compatible with pre C++11 compiler hence =delete not used)
+    ESendBatch(const ESendBatch&);
+    ESendBatch& operator=(const ESendBatch&);
+};
+
 #endif
@@ -21,12 +21,100 @@
 #include <assert.h>
 #include <string>
 #include <bitset>
+#include <charconv>
+
+
+namespace {
+
+	// std::from_chars over [beg, end) is locale independent and does not rescan
+	// for the terminator; anything it does not take as a whole (a leading '+' or
+	// blank, out of range values, trailing garbage) goes through the C parser on
+	// the NUL-terminated field so that the values stay what atoi()/atof() gave.
+	template<typename T>
+	inline bool parseNumber(T& value, const char* beg, const char* end) {
+		if (beg == end) {
+			value = 0;
+			return true;
+		}
+		std::from_chars_result res = std::from_chars(beg, end, value);
+		return res.ec == std::errc() && res.ptr == end;
+	}
+
+	inline int parseInt(const char* beg, const char* end) {
+		int value;
+		return parseNumber(value, beg, end) ? value : atoi(beg);
+	}
+
+	inline long parseLong(const char* beg, const char* end) {
+		long value;
+		return parseNumber(value, beg, end) ? value : atol(beg);
+	}
+
+	inline long long parseLongLong(const char* beg, const char* end) {
+		long long value;
+		return parseNumber(value, beg, end) ? value : atoll(beg);
+	}
+
+	// Prices are short plain decimals: with at most 15 significant digits both
+	// the mantissa and the power of ten are exact doubles, so one division
+	// gives the correctly rounded value without the general algorithm.
+	inline bool parseDecimal(double& value, const char* beg, const char* end) {
+		static const double pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+			1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15 };
+
+		bool negative = *beg == '-';
+		const char* p = beg + negative;
+
+		if (p == end || end - p > 16)
+			return false;
+
+		unsigned long long mantissa = 0;
+		int digits = 0;
+		int fraction = -1;
+
+		for (; p != end; ++p) {
+			unsigned d = (unsigned char)*p - '0';
+			if (d <= 9) {
+				mantissa = mantissa * 10 + d;
+				++digits;
+				if (fraction >= 0)
+					++fraction;
+			}
+			else if (*p == '.' && fraction < 0)
+				fraction = 0;
+			else
+				return false;
+		}
+
+		if (digits == 0 || digits > 15)
+			return false;
+
+		value = fraction > 0 ? (double)mantissa / pow10[fraction] : (double)mantissa;
+		if (negative)
+			value = -value;
+		return true;
+	}
+
+	inline double parseDouble(const char* beg, const char* end) {
+		double value;
+		if (parseDecimal(value, beg, end))
+			return value;
+#if defined(__cpp_lib_to_chars) || defined(_MSC_VER)
+		if (parseNumber(value, beg, end))
+			return value;
+#endif
+		return atof(beg);
+	}
+}
 
 
 EDecoder::EDecoder(int serverVersion, EWrapper *callback, EClientMsgSink *clientMsgSink) {
 	m_pEWrapper = callback;
 	m_serverVersion = serverVersion;
 	m_pClientMsgSink = clientMsgSink;
+	m_msgBegin = 0;
+	m_restOffset = 0;
+	m_restFields = 0;
 }
 
 const char* EDecoder::processTickPriceMsg(const char* ptr, const char* endPtr) {
@@ -894,6 +982,8 @@ const char* EDecoder::processHistoricalDataMsg(const char* ptr, const char* endP
 	int itemCount;
 	DECODE_FIELD( itemCount);
 
+	expectFields( ptr, (long long)itemCount * (m_serverVersion < MIN_SERVER_VER_SYNT_REALTIME_BARS ? 9 : 8));
+
 	typedef std::vector<Bar> BarDataList;
 	BarDataList bars;
 
@@ -979,6 +1069,8 @@ const char* EDecoder::processScannerDataMsg(const char* ptr, const char* endPtr)
 	int numberOfElements;
 	DECODE_FIELD( numberOfElements);
 
+	expectFields( ptr, (long long)numberOfElements * 16);
+
 	typedef std::vector<ScanData> ScanDataList;
 	ScanDataList scannerDataList;
 
@@ -2180,7 +2272,7 @@ const char* EDecoder::processCompletedOrderMsg(const char* ptr, const char* endP
 	return ptr;
 }
 
-const char* EDecoder::processCompletedOrdersEndMsg(const char* ptr, const char* endPtr) 
+const char* EDecoder::processCompletedOrdersEndMsg(const char* ptr, const char* /*endPtr*/) 
 {
 	m_pEWrapper->completedOrdersEnd();
 	return ptr;
@@ -2199,15 +2291,138 @@ const char* EDecoder::processReplaceFAEndMsg(const char* ptr, const char* endPtr
 }
 
 
+const EDecoder::MsgHandler* EDecoder::msgHandlers() {
+	struct HandlerTable {
+		MsgHandler handlers[MAX_MSG_ID + 1];
+
+		HandlerTable() {
+			for (int i = 0; i <= MAX_MSG_ID; ++i)
+				handlers[i] = 0;
+
+			handlers[TICK_PRICE] = &EDecoder::processTickPriceMsg;
+			handlers[TICK_SIZE] = &EDecoder::processTickSizeMsg;
+			handlers[TICK_OPTION_COMPUTATION] = &EDecoder::processTickOptionComputationMsg;
+			handlers[TICK_GENERIC] = &EDecoder::processTickGenericMsg;
+			handlers[TICK_STRING] = &EDecoder::processTickStringMsg;
+			handlers[TICK_EFP] = &EDecoder::processTickEfpMsg;
+			handlers[ORDER_STATUS] = &EDecoder::processOrderStatusMsg;
+			handlers[ERR_MSG] = &EDecoder::processErrMsgMsg;
+			handlers[OPEN_ORDER] = &EDecoder::processOpenOrderMsg;
+			handlers[ACCT_VALUE] = &EDecoder::processAcctValueMsg;
+			handlers[PORTFOLIO_VALUE] = &EDecoder::processPortfolioValueMsg;
+			handlers[ACCT_UPDATE_TIME] = &EDecoder::processAcctUpdateTimeMsg;
+			handlers[NEXT_VALID_ID] = &EDecoder::processNextValidIdMsg;
+			handlers[CONTRACT_DATA] = &EDecoder::processContractDataMsg;
+			handlers[BOND_CONTRACT_DATA] = &EDecoder::processBondContractDataMsg;
+			handlers[EXECUTION_DATA] = &EDecoder::processExecutionDetailsMsg;
+			handlers[MARKET_DEPTH] = &EDecoder::processMarketDepthMsg;
+			handlers[MARKET_DEPTH_L2] = &EDecoder::processMarketDepthL2Msg;
+			handlers[NEWS_BULLETINS] = &EDecoder::processNewsBulletinsMsg;
+			handlers[MANAGED_ACCTS] = &EDecoder::processManagedAcctsMsg;
+			handlers[RECEIVE_FA] = &EDecoder::processReceiveFaMsg;
+			handlers[HISTORICAL_DATA] = &EDecoder::processHistoricalDataMsg;
+			handlers[SCANNER_DATA] = &EDecoder::processScannerDataMsg;
+			handlers[SCANNER_PARAMETERS] = &EDecoder::processScannerParametersMsg;
+			handlers[CURRENT_TIME] = &EDecoder::processCurrentTimeMsg;
+			handlers[REAL_TIME_BARS] = &EDecoder::processRealTimeBarsMsg;
+			handlers[FUNDAMENTAL_DATA] = &EDecoder::processFundamentalDataMsg;
+			handlers[CONTRACT_DATA_END] = &EDecoder::processContractDataEndMsg;
+			handlers[OPEN_ORDER_END] = &EDecoder::processOpenOrderEndMsg;
+			handlers[ACCT_DOWNLOAD_END] = &EDecoder::processAcctDownloadEndMsg;
+			handlers[EXECUTION_DATA_END] = &EDecoder::processExecutionDetailsEndMsg;
+			handlers[DELTA_NEUTRAL_VALIDATION] = &EDecoder::processDeltaNeutralValidationMsg;
+			handlers[TICK_SNAPSHOT_END] = &EDecoder::processTickSnapshotEndMsg;
+			handlers[MARKET_DATA_TYPE] = &EDecoder::processMarketDataTypeMsg;
+			handlers[COMMISSION_REPORT] = &EDecoder::processCommissionReportMsg;
+			handlers[POSITION_DATA] = &EDecoder::processPositionDataMsg;
+			handlers[POSITION_END] = &EDecoder::processPositionEndMsg;
+			handlers[ACCOUNT_SUMMARY] = &EDecoder::processAccountSummaryMsg;
+			handlers[ACCOUNT_SUMMARY_END] = &EDecoder::processAccountSummaryEndMsg;
+			handlers[VERIFY_MESSAGE_API] = &EDecoder::processVerifyMessageApiMsg;
+			handlers[VERIFY_COMPLETED] = &EDecoder::processVerifyCompletedMsg;
+			handlers[DISPLAY_GROUP_LIST] = &EDecoder::processDisplayGroupListMsg;
+			handlers[DISPLAY_GROUP_UPDATED] = &EDecoder::processDisplayGroupUpdatedMsg;
+			handlers[VERIFY_AND_AUTH_MESSAGE_API] = &EDecoder::processVerifyAndAuthMessageApiMsg;
+			handlers[VERIFY_AND_AUTH_COMPLETED] = &EDecoder::processVerifyAndAuthCompletedMsg;
+			handlers[POSITION_MULTI] = &EDecoder::processPositionMultiMsg;
+			handlers[POSITION_MULTI_END] = &EDecoder::processPositionMultiEndMsg;
+			handlers[ACCOUNT_UPDATE_MULTI] = &EDecoder::processAccountUpdateMultiMsg;
+			handlers[ACCOUNT_UPDATE_MULTI_END] = &EDecoder::processAccountUpdateMultiEndMsg;
+			handlers[SECURITY_DEFINITION_OPTION_PARAMETER] = &EDecoder::processSecurityDefinitionOptionalParameterMsg;
+			handlers[SECURITY_DEFINITION_OPTION_PARAMETER_END] = &EDecoder::processSecurityDefinitionOptionalParameterEndMsg;
+			handlers[SOFT_DOLLAR_TIERS] = &EDecoder::processSoftDollarTiersMsg;
+			handlers[FAMILY_CODES] = &EDecoder::processFamilyCodesMsg;
+			handlers[SMART_COMPONENTS] = &EDecoder::processSmartComponentsMsg;
+			handlers[TICK_REQ_PARAMS] = &EDecoder::processTickReqParamsMsg;
+			handlers[SYMBOL_SAMPLES] = &EDecoder::processSymbolSamplesMsg;
+			handlers[MKT_DEPTH_EXCHANGES] = &EDecoder::processMktDepthExchangesMsg;
+			handlers[TICK_NEWS] = &EDecoder::processTickNewsMsg;
+			handlers[NEWS_PROVIDERS] = &EDecoder::processNewsProvidersMsg;
+			handlers[NEWS_ARTICLE] = &EDecoder::processNewsArticleMsg;
+			handlers[HISTORICAL_NEWS] = &EDecoder::processHistoricalNewsMsg;
+			handlers[HISTORICAL_NEWS_END] = &EDecoder::processHistoricalNewsEndMsg;
+			handlers[HEAD_TIMESTAMP] = &EDecoder::processHeadTimestampMsg;
+			handlers[HISTOGRAM_DATA] = &EDecoder::processHistogramDataMsg;
+			handlers[HISTORICAL_DATA_UPDATE] = &EDecoder::processHistoricalDataUpdateMsg;
+			handlers[REROUTE_MKT_DATA_REQ] = &EDecoder::processRerouteMktDataReqMsg;
+			handlers[REROUTE_MKT_DEPTH_REQ] = &EDecoder::processRerouteMktDepthReqMsg;
+			handlers[MARKET_RULE] = &EDecoder::processMarketRuleMsg;
+			handlers[PNL] = &EDecoder::processPnLMsg;
+			handlers[PNL_SINGLE] = &EDecoder::processPnLSingleMsg;
+			handlers[HISTORICAL_TICKS] = &EDecoder::processHistoricalTicks;
+			handlers[HISTORICAL_TICKS_BID_ASK] = &EDecoder::processHistoricalTicksBidAsk;
+			handlers[HISTORICAL_TICKS_LAST] = &EDecoder::processHistoricalTicksLast;
+			handlers[TICK_BY_TICK] = &EDecoder::processTickByTickDataMsg;
+			handlers[ORDER_BOUND] = &EDecoder::processOrderBoundMsg;
+			handlers[COMPLETED_ORDER] = &EDecoder::processCompletedOrderMsg;
+			handlers[COMPLETED_ORDERS_END] = &EDecoder::processCompletedOrdersEndMsg;
+			handlers[REPLACE_FA_END] = &EDecoder::processReplaceFAEndMsg;
+		}
+	};
+
+	static const HandlerTable table;
+
+	return table.handlers;
+}
+
+void EDecoder::skipMsg(int msgId, bool skip) {
+	if (msgId >= 0 && msgId <= MAX_MSG_ID)
+		m_skipMsgs[msgId] = skip;
+}
+
+bool EDecoder::isMsgSkipped(int msgId) const {
+	return msgId >= 0 && msgId <= MAX_MSG_ID && m_skipMsgs[msgId];
+}
+
+int EDecoder::incompleteFields(size_t &offset) const {
+	offset = m_restOffset;
+	return m_restFields;
+}
+
+// the list of a message starts at ptr and takes this many fields
+void EDecoder::expectFields(const char* ptr, long long fields) {
+	if (!m_msgBegin || fields <= 0)
+		return;
+	m_restOffset = ptr - m_msgBegin;
+	m_restFields = fields < INT_MAX ? (int)fields : INT_MAX;
+}
+
 int EDecoder::parseAndProcessMsg(const char*& beginPtr, const char* endPtr) {
 	// process a single message from the buffer;
 	// return number of bytes consumed
 
 	assert( beginPtr && beginPtr < endPtr);
 
+	m_msgBegin = beginPtr;
+	m_restFields = 0;
+
 	if (m_serverVersion == 0)
 		return processConnectAck(beginPtr, endPtr);
 
+	// find every field separator of the frame up front
+	m_fieldIndex.index(beginPtr, endPtr);
+	EFieldIndex::Scope fieldIndexScope(&m_fieldIndex);
+
 	try {
 
 		const char* ptr = beginPtr;
@@ -2215,7 +2430,12 @@ int EDecoder::parseAndProcessMsg(const char*& beginPtr, const char* endPtr) {
 		int msgId;
 		DECODE_FIELD( msgId);
 
-		switch( msgId) {
+		if ((unsigned)msgId <= (unsigned)MAX_MSG_ID && m_skipMsgs[msgId]) {
+			// nobody listens to it, drop the framed message undecoded
+			ptr = endPtr;
+		}
+		else switch( msgId) {
+		// hot market data messages are called directly, the rest go through the table
 		case TICK_PRICE:
 			ptr = processTickPriceMsg(ptr, endPtr);
 			break;
@@ -2224,312 +2444,23 @@ int EDecoder::parseAndProcessMsg(const char*& beginPtr, const char* endPtr) {
 			ptr = processTickSizeMsg(ptr, endPtr);
 			break;
 
-		case TICK_OPTION_COMPUTATION:
-			ptr = processTickOptionComputationMsg(ptr, endPtr);
-			break;
-
-		case TICK_GENERIC:
-			ptr = processTickGenericMsg(ptr, endPtr);
-			break;
-
-		case TICK_STRING:
-			ptr = processTickStringMsg(ptr, endPtr);
-			break;
-
-		case TICK_EFP:
-			ptr = processTickEfpMsg(ptr, endPtr);
-			break;
-
-		case ORDER_STATUS:
-			ptr = processOrderStatusMsg(ptr, endPtr);
-			break;
-
-		case ERR_MSG:
-			ptr = processErrMsgMsg(ptr, endPtr);
-			break;
-
-		case OPEN_ORDER:
-			ptr = processOpenOrderMsg(ptr, endPtr);
-			break;
-
-		case ACCT_VALUE:
-			ptr = processAcctValueMsg(ptr, endPtr);
-			break;
-
-		case PORTFOLIO_VALUE:
-			ptr = processPortfolioValueMsg(ptr, endPtr);
-			break;
-
-		case ACCT_UPDATE_TIME:
-			ptr = processAcctUpdateTimeMsg(ptr, endPtr);
-			break;
-
-		case NEXT_VALID_ID:
-			ptr = processNextValidIdMsg(ptr, endPtr);
-			break;
-
-		case CONTRACT_DATA:
-			ptr = processContractDataMsg(ptr, endPtr);
-			break;
-
-		case BOND_CONTRACT_DATA:
-			ptr = processBondContractDataMsg(ptr, endPtr);
-			break;
-
-		case EXECUTION_DATA:
-			ptr = processExecutionDetailsMsg(ptr, endPtr);
-			break;
-
 		case MARKET_DEPTH:
 			ptr = processMarketDepthMsg(ptr, endPtr);
 			break;
 
-		case MARKET_DEPTH_L2:
-			ptr = processMarketDepthL2Msg(ptr, endPtr);
-			break;
-
-		case NEWS_BULLETINS:
-			ptr = processNewsBulletinsMsg(ptr, endPtr);
-			break;
-
-		case MANAGED_ACCTS:
-			ptr = processManagedAcctsMsg(ptr, endPtr);
-			break;
-
-		case RECEIVE_FA:
-			ptr = processReceiveFaMsg(ptr, endPtr);
-			break;
-
-		case HISTORICAL_DATA:
-			ptr = processHistoricalDataMsg(ptr, endPtr);
-			break;
-
-		case SCANNER_DATA:
-			ptr = processScannerDataMsg(ptr, endPtr);
-			break;
-
-		case SCANNER_PARAMETERS:
-			ptr = processScannerParametersMsg(ptr, endPtr);
-			break;
-
-		case CURRENT_TIME:
-			ptr = processCurrentTimeMsg(ptr, endPtr);
-			break;
-
 		case REAL_TIME_BARS:
 			ptr = processRealTimeBarsMsg(ptr, endPtr);
 			break;
 
-		case FUNDAMENTAL_DATA:
-			ptr = processFundamentalDataMsg(ptr, endPtr);
-			break;
-
-		case CONTRACT_DATA_END:
-			ptr = processContractDataEndMsg(ptr, endPtr);
-			break;
-
-		case OPEN_ORDER_END:
-			ptr = processOpenOrderEndMsg(ptr, endPtr);
-			break;
-
-		case ACCT_DOWNLOAD_END:
-			ptr = processAcctDownloadEndMsg(ptr, endPtr);
-			break;
-
-		case EXECUTION_DATA_END:
-			ptr = processExecutionDetailsEndMsg(ptr, endPtr);
-			break;
-
-		case DELTA_NEUTRAL_VALIDATION:
-			ptr = processDeltaNeutralValidationMsg(ptr, endPtr);
-			break;
-
-		case TICK_SNAPSHOT_END:
-			ptr = processTickSnapshotEndMsg(ptr, endPtr);
-			break;
-
-		case MARKET_DATA_TYPE:
-			ptr = processMarketDataTypeMsg(ptr, endPtr);
-			break;
-
-		case COMMISSION_REPORT:
-			ptr = processCommissionReportMsg(ptr, endPtr);
-			break;
-
-		case POSITION_DATA:
-			ptr = processPositionDataMsg(ptr, endPtr);
-			break;
-
-		case POSITION_END:
-			ptr = processPositionEndMsg(ptr, endPtr);
-			break;
-
-		case ACCOUNT_SUMMARY:
-			ptr = processAccountSummaryMsg(ptr, endPtr);
-			break;
-
-		case ACCOUNT_SUMMARY_END:
-			ptr = processAccountSummaryEndMsg(ptr, endPtr);
-			break;
-
-		case VERIFY_MESSAGE_API:
-			ptr = processVerifyMessageApiMsg(ptr, endPtr);
-			break;
-
-		case VERIFY_COMPLETED:
-			ptr = processVerifyCompletedMsg(ptr, endPtr);
-			break;
-
-		case DISPLAY_GROUP_LIST:
-			ptr = processDisplayGroupListMsg(ptr, endPtr);
-			break;
-
-		case DISPLAY_GROUP_UPDATED:
-			ptr = processDisplayGroupUpdatedMsg(ptr, endPtr);
-			break;
-
-		case VERIFY_AND_AUTH_MESSAGE_API:
-			ptr = processVerifyAndAuthMessageApiMsg(ptr, endPtr);
-			break;
-
-		case VERIFY_AND_AUTH_COMPLETED:
-			ptr = processVerifyAndAuthCompletedMsg(ptr, endPtr);
-			break;
-
-		case POSITION_MULTI:
-			ptr = processPositionMultiMsg(ptr, endPtr);
-			break;
-
-		case POSITION_MULTI_END:
-			ptr = processPositionMultiEndMsg(ptr, endPtr);
-			break;
-
-		case ACCOUNT_UPDATE_MULTI:
-			ptr = processAccountUpdateMultiMsg(ptr, endPtr);
-			break;
-
-		case ACCOUNT_UPDATE_MULTI_END:
-			ptr = processAccountUpdateMultiEndMsg(ptr, endPtr);
-			break;
-
-		case SECURITY_DEFINITION_OPTION_PARAMETER:
-			ptr = processSecurityDefinitionOptionalParameterMsg(ptr, endPtr);
-			break;
-
-		case SECURITY_DEFINITION_OPTION_PARAMETER_END:
-			ptr = processSecurityDefinitionOptionalParameterEndMsg(ptr, endPtr);
-			break;
-
-		case SOFT_DOLLAR_TIERS:
-			ptr = processSoftDollarTiersMsg(ptr, endPtr);
-			break;
-
-		case FAMILY_CODES:
-			ptr = processFamilyCodesMsg(ptr, endPtr);
-			break;
-
-		case SMART_COMPONENTS:
-			ptr = processSmartComponentsMsg(ptr, endPtr);
-			break;
-
-		case TICK_REQ_PARAMS:
-			ptr = processTickReqParamsMsg(ptr, endPtr);
-			break;
-
-		case SYMBOL_SAMPLES:
-			ptr = processSymbolSamplesMsg(ptr, endPtr);
-			break;
-
-		case MKT_DEPTH_EXCHANGES:
-			ptr = processMktDepthExchangesMsg(ptr, endPtr);
-			break;			
-
-		case TICK_NEWS:
-			ptr = processTickNewsMsg(ptr, endPtr);
-			break;
-
-		case NEWS_PROVIDERS:
-			ptr = processNewsProvidersMsg(ptr, endPtr);
-			break;
-
-		case NEWS_ARTICLE:
-			ptr = processNewsArticleMsg(ptr, endPtr);
-			break;
-
-		case HISTORICAL_NEWS:
-			ptr = processHistoricalNewsMsg(ptr, endPtr);
-			break;
-
-		case HISTORICAL_NEWS_END:
-			ptr = processHistoricalNewsEndMsg(ptr, endPtr);
-			break;
-
-		case HEAD_TIMESTAMP:
-			ptr = processHeadTimestampMsg(ptr, endPtr);
-			break;
-
-		case HISTOGRAM_DATA:
-			ptr = processHistogramDataMsg(ptr, endPtr);
-			break;
-
-		case HISTORICAL_DATA_UPDATE:
-			ptr = processHistoricalDataUpdateMsg(ptr, endPtr);
-			break;
-
-		case REROUTE_MKT_DATA_REQ:
-			ptr = processRerouteMktDataReqMsg(ptr, endPtr);
-			break;
-
-		case REROUTE_MKT_DEPTH_REQ:
-			ptr = processRerouteMktDepthReqMsg(ptr, endPtr);
-			break;
-
-		case MARKET_RULE:
-			ptr = processMarketRuleMsg(ptr, endPtr);
-			break;
-
-        case PNL:
-            ptr = processPnLMsg(ptr, endPtr);
-            break;
-
-        case PNL_SINGLE:
-            ptr = processPnLSingleMsg(ptr, endPtr);
-            break;
-
-		case HISTORICAL_TICKS:
-			ptr = processHistoricalTicks(ptr, endPtr);
-			break;
-
-        case HISTORICAL_TICKS_BID_ASK:
-            ptr = processHistoricalTicksBidAsk(ptr, endPtr);
-            break;
-
-        case HISTORICAL_TICKS_LAST:
-            ptr = processHistoricalTicksLast(ptr, endPtr);
-            break;
-
-        case TICK_BY_TICK:
-            ptr = processTickByTickDataMsg(ptr, endPtr);
-            break;
-
-        case ORDER_BOUND:
-            ptr = processOrderBoundMsg(ptr, endPtr);
-            break;
-
-        case COMPLETED_ORDER:
-            ptr = processCompletedOrderMsg(ptr, endPtr);
-            break;
-
-        case COMPLETED_ORDERS_END:
-            ptr = processCompletedOrdersEndMsg(ptr, endPtr);
-            break;
-
-		case REPLACE_FA_END:
-			ptr = processReplaceFAEndMsg(ptr, endPtr);
-			break;
-
 		default:
 			{
+				MsgHandler handler = (unsigned)msgId <= (unsigned)MAX_MSG_ID ? msgHandlers()[msgId] : 0;
+
+				if (handler) {
+					ptr = (this->*handler)(ptr, endPtr);
+					break;
+				}
+
 				m_pEWrapper->error( msgId, UNKNOWN_ID.code(), UNKNOWN_ID.msg());
 				m_pEWrapper->connectionClosed();
 				break;
@@ -2558,6 +2489,11 @@ bool EDecoder::CheckOffset(const char* ptr, const char* endPtr)
 
 const char* EDecoder::FindFieldEnd(const char* ptr, const char* endPtr)
 {
+	const EFieldIndex *fieldIndex = EFieldIndex::current();
+
+	if (fieldIndex)
+		return fieldIndex->findFieldEnd(ptr, endPtr);
+
 	return (const char*)memchr(ptr, 0, endPtr - ptr);
 }
 
@@ -2578,7 +2514,7 @@ bool EDecoder::DecodeField(int& intValue, const char*& ptr, const char* endPtr)
 	const char* fieldEnd = FindFieldEnd(fieldBeg, endPtr);
 	if( !fieldEnd)
 		return false;
-	intValue = atoi(fieldBeg);
+	intValue = parseInt(fieldBeg, fieldEnd);
 	ptr = ++fieldEnd;
 	return true;
 }
@@ -2591,7 +2527,7 @@ bool EDecoder::DecodeFieldTime(time_t& time_tValue, const char*& ptr, const char
 	const char* fieldEnd = FindFieldEnd(fieldBeg, endPtr);
 	if( !fieldEnd)
 		return false;
-	time_tValue = atoll(fieldBeg);
+	time_tValue = parseLongLong(fieldBeg, fieldEnd);
 	ptr = ++fieldEnd;
 	return true;
 }
@@ -2604,7 +2540,7 @@ bool EDecoder::DecodeField(long long& longLongValue, const char*& ptr, const cha
 	const char* fieldEnd = FindFieldEnd(fieldBeg, endPtr);
 	if( !fieldEnd)
 		return false;
-	longLongValue = atoll(fieldBeg);
+	longLongValue = parseLongLong(fieldBeg, fieldEnd);
 	ptr = ++fieldEnd;
 	return true;
 }
@@ -2617,7 +2553,7 @@ bool EDecoder::DecodeField(long& longValue, const char*& ptr, const char* endPtr
 	const char* fieldEnd = FindFieldEnd(fieldBeg, endPtr);
 	if( !fieldEnd)
 		return false;
-	longValue = atol(fieldBeg);
+	longValue = parseLong(fieldBeg, fieldEnd);
 	ptr = ++fieldEnd;
 	return true;
 }
@@ -2630,7 +2566,7 @@ bool EDecoder::DecodeField(double& doubleValue, const char*& ptr, const char* en
 	const char* fieldEnd = FindFieldEnd(fieldBeg, endPtr);
 	if( !fieldEnd)
 		return false;
-	doubleValue = atof(fieldBeg);
+	doubleValue = parseDouble(fieldBeg, fieldEnd);
 	ptr = ++fieldEnd;
 	return true;
 }
@@ -2644,7 +2580,21 @@ bool EDecoder::DecodeField(std::string& stringValue,
 	const char* fieldEnd = FindFieldEnd(ptr, endPtr);
 	if( !fieldEnd)
 		return false;
-	stringValue = fieldBeg; // better way?
+	stringValue.assign(fieldBeg, fieldEnd - fieldBeg);
+	ptr = ++fieldEnd;
+	return true;
+}
+
+bool EDecoder::DecodeField(std::string_view& stringValue,
+						   const char*& ptr, const char* endPtr)
+{
+	if( !CheckOffset(ptr, endPtr))
+		return false;
+	const char* fieldBeg = ptr;
+	const char* fieldEnd = FindFieldEnd(ptr, endPtr);
+	if( !fieldEnd)
+		return false;
+	stringValue = std::string_view(fieldBeg, fieldEnd - fieldBeg);
 	ptr = ++fieldEnd;
 	return true;
 }
@@ -2665,10 +2615,10 @@ bool EDecoder::DecodeField(char& charValue,
 
 bool EDecoder::DecodeFieldMax(int& intValue, const char*& ptr, const char* endPtr)
 {
-	std::string stringValue;
+	std::string_view stringValue;
 	if( !DecodeField(stringValue, ptr, endPtr))
 		return false;
-	intValue = stringValue.empty() ? UNSET_INTEGER : atoi(stringValue.c_str());
+	intValue = stringValue.empty() ? UNSET_INTEGER : parseInt(stringValue.data(), stringValue.data() + stringValue.size());
 	return true;
 }
 
@@ -2683,10 +2633,10 @@ bool EDecoder::DecodeFieldMax(long& longValue, const char*& ptr, const char* end
 
 bool EDecoder::DecodeFieldMax(double& doubleValue, const char*& ptr, const char* endPtr)
 {
-	std::string stringValue;
+	std::string_view stringValue;
 	if( !DecodeField(stringValue, ptr, endPtr))
 		return false;
-	doubleValue = stringValue.empty() ? UNSET_DOUBLE : atof(stringValue.c_str());
+	doubleValue = stringValue.empty() ? UNSET_DOUBLE : parseDouble(stringValue.data(), stringValue.data() + stringValue.size());
 	return true;
 }
 
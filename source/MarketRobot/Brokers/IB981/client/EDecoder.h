@@ -10,6 +10,10 @@
 #include "HistoricalTick.h"
 #include "HistoricalTickBidAsk.h"
 #include "HistoricalTickLast.h"
+#include "EFieldIndex.h"
+
+#include <string_view>
+#include <bitset>
 
 
 
@@ -201,6 +205,8 @@ const int COMPLETED_ORDER                           = 101;
 const int COMPLETED_ORDERS_END                      = 102;
 const int REPLACE_FA_END                            = 103;
 
+const int MAX_MSG_ID = REPLACE_FA_END;
+
 const int HEADER_LEN = 4; // 4 bytes for msg length
 const int MAX_MSG_LEN = 0xFFFFFF; // 16Mb - 1byte
 const char API_SIGN[4] = { 'A', 'P', 'I', '\0' }; // "API"
@@ -240,6 +246,14 @@ class TWSAPIDLLEXP EDecoder
     EWrapper *m_pEWrapper;
     int m_serverVersion;
     EClientMsgSink *m_pClientMsgSink;
+    EFieldIndex m_fieldIndex;
+    std::bitset<MAX_MSG_ID + 1> m_skipMsgs;
+    const char *m_msgBegin;     // message being decoded
+    size_t m_restOffset;        // where the fields counted by m_restFields start in it
+    int m_restFields;           // fields it has at least from there on, 0 when not known
+
+    typedef const char* (EDecoder::*MsgHandler)(const char* ptr, const char* endPtr);
+    static const MsgHandler* msgHandlers();
 
     const char* processTickPriceMsg(const char* ptr, const char* endPtr);
     const char* processTickSizeMsg(const char* ptr, const char* endPtr);
@@ -343,6 +357,7 @@ public:
     static bool DecodeField(long long&, const char*& ptr, const char* endPtr);
     static bool DecodeField(double&, const char*& ptr, const char* endPtr);
     static bool DecodeField(std::string&, const char*& ptr, const char* endPtr);
+    static bool DecodeField(std::string_view&, const char*& ptr, const char* endPtr);  // view into the frame
     static bool DecodeField(char&, const char*& ptr, const char* endPtr);
 
     static bool DecodeFieldTime(time_t&, const char*& ptr, const char* endPtr);
@@ -354,6 +369,20 @@ public:
     EDecoder(int serverVersion, EWrapper *callback, EClientMsgSink *clientMsgSink = 0);
 
     int parseAndProcessMsg(const char*& beginPtr, const char* endPtr);
+
+    // Drop messages of this type without decoding them. Only valid when every
+    // call is handed exactly one framed message, as EReader::processMsgs() does.
+    void skipMsg(int msgId, bool skip = true);
+    bool isMsgSkipped(int msgId) const;
+
+    // After parseAndProcessMsg() found a message incomplete: the number of
+    // fields the message has at least from offset bytes into it on, or 0 when
+    // the decoder cannot tell. Lets EFrameScanner wait for a long list instead
+    // of decoding it again on every read.
+    int incompleteFields(size_t &offset) const;
+
+private:
+    void expectFields(const char* ptr, long long fields);
 };
 
 #define DECODE_FIELD(x) if (!EDecoder::DecodeField(x, ptr, endPtr)) return 0;
@@ -0,0 +1,133 @@
+#include "StdAfx.h"
+#include "EEncodeBuffer.h"
+
+#include <charconv>
+#include <algorithm>
+#include <string.h>
+#include <stdio.h>
+
+#define FIELD_SIZE_MAX 32 // longest integer or %.10g double, terminator included
+
+
+EEncodeBuffer::EEncodeBuffer(size_t capacity)
+    : m_buf(capacity)
+    , m_size(0)
+{
+}
+
+char *EEncodeBuffer::reserve(size_t sz)
+{
+    if (m_size + sz > m_buf.size())
+        m_buf.resize((std::max)(m_buf.size() * 2, m_size + sz));
+
+    return m_buf.data() + m_size;
+}
+
+void EEncodeBuffer::clear()
+{
+    m_size = 0;
+}
+
+char *EEncodeBuffer::data()
+{
+    return m_buf.data();
+}
+
+const char *EEncodeBuffer::data() const
+{
+    return m_buf.data();
+}
+
+size_t EEncodeBuffer::size() const
+{
+    return m_size;
+}
+
+void EEncodeBuffer::append(const char *buf, size_t sz)
+{
+    memcpy(reserve(sz), buf, sz);
+    m_size += sz;
+}
+
+void EEncodeBuffer::encode(bool value)
+{
+    char *p = reserve(2);
+    p[0] = value ? '1' : '0';
+    p[1] = 0;
+    m_size += 2;
+}
+
+void EEncodeBuffer::encode(char value)
+{
+    char *p = reserve(2);
+    p[0] = value;
+    p[1] = 0;
+    m_size += 2;
+}
+
+namespace {
+    template<typename T>
+    inline size_t encodeInteger(char *p, T value) {
+        char *end = std::to_chars(p, p + FIELD_SIZE_MAX - 1, value).ptr;
+        *end = 0;
+        return end + 1 - p;
+    }
+}
+
+void EEncodeBuffer::encode(int value)
+{
+    m_size += encodeInteger(reserve(FIELD_SIZE_MAX), value);
+}
+
+void EEncodeBuffer::encode(long value)
+{
+    m_size += encodeInteger(reserve(FIELD_SIZE_MAX), value);
+}
+
+void EEncodeBuffer::encode(long long value)
+{
+    m_size += encodeInteger(reserve(FIELD_SIZE_MAX), value);
+}
+
+void EEncodeBuffer::encode(unsigned value)
+{
+    m_size += encodeInteger(reserve(FIELD_SIZE_MAX), value);
+}
+
+void EEncodeBuffer::encode(unsigned long value)
+{
+    m_size += encodeInteger(reserve(FIELD_SIZE_MAX), value);
+}
+
+void EEncodeBuffer::encode(unsigned long long value)
+{
+    m_size += encodeInteger(reserve(FIELD_SIZE_MAX), value);
+}
+
+void EEncodeBuffer::encode(double value)
+{
+    char *p = reserve(FIELD_SIZE_MAX);
+
+#if defined(__cpp_lib_to_chars) || defined(_MSC_VER)
+    // same digits as the "%.10g" of EClient::EncodeField<double>()
+    std::to_chars_result res = std::to_chars(p, p + FIELD_SIZE_MAX - 1, value, std::chars_format::general, 10);
+
+    if (res.ec == std::errc()) {
+        *res.ptr = 0;
+        m_size += res.ptr + 1 - p;
+        return;
+    }
+#endif
+
+    m_size += snprintf(p, FIELD_SIZE_MAX, "%.10g", value) + 1;
+}
+
+void EEncodeBuffer::encode(const char *value)
+{
+    append(value, strlen(value) + 1);
+}
+
+void EEncodeBuffer::encode(const std::string &value)
+{
+    append(value.c_str(), value.size() + 1);
+}
@@ -0,0 +1,50 @@
+#pragma once
+#ifndef TWS_API_CLIENT_EENCODEBUFFER_H
+#define TWS_API_CLIENT_EENCODEBUFFER_H
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include "platformspecific.h"
+
+#define OUT_MSG_SIZE_DEFAULT 4096
+
+// Reusable buffer for outgoing messages.
+//
+// Fields are formatted in place with std::to_chars and terminated by a NUL,
+// the same bytes EClient::EncodeField() writes to an ostream. The storage is
+// kept between messages, so once it has grown to the largest message sent
+// encoding a request does not allocate.
+class TWSAPIDLLEXP EEncodeBuffer
+{
+    std::vector<char> m_buf;
+    size_t m_size;
+
+    char *reserve(size_t sz);
+
+public:
+    explicit EEncodeBuffer(size_t capacity = OUT_MSG_SIZE_DEFAULT);
+
+    void clear();
+    char *data();
+    const char *data() const;
+    size_t size() const;
+
+    // raw bytes, no terminator
+    void append(const char *buf, size_t sz);
+
+    // one field each, NUL terminated
+    void encode(bool value);
+    void encode(char value);
+    void encode(int value);
+    void encode(long value);
+    void encode(long long value);
+    void encode(unsigned value);
+    void encode(unsigned long value);
+    void encode(unsigned long long value);
+    void encode(double value);
+    void encode(const char *value);
+    void encode(const std::string &value);
+};
+
+#endif
@@ -0,0 +1,133 @@
+#include "StdAfx.h"
+#include "EFieldIndex.h"
+
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FIELD_INDEX_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+    thread_local const EFieldIndex *t_current = 0;
+
+    inline unsigned lowestBit(uint64_t word) {
+#if defined(_MSC_VER)
+        unsigned long pos;
+        _BitScanForward64(&pos, word);
+        return (unsigned)pos;
+#else
+        return (unsigned)__builtin_ctzll(word);
+#endif
+    }
+
+    // bitmap of the NUL bytes of 64 bytes at p
+    inline uint64_t scanBlock(const char *p) {
+#if defined(__AVX2__)
+        const __m256i zero = _mm256_setzero_si256();
+        uint64_t lo = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)p), zero));
+        uint64_t hi = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + 32)), zero));
+        return lo | (hi << 32);
+#elif defined(FIELD_INDEX_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        uint64_t mask = 0;
+        for (int i = 0; i < 4; ++i) {
+            uint64_t m = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 16 * i)), zero));
+            mask |= m << (16 * i);
+        }
+        return mask;
+#else
+        uint64_t mask = 0;
+        for (int i = 0; i < 64; ++i)
+            mask |= (uint64_t)(p[i] == 0) << i;
+        return mask;
+#endif
+    }
+}
+
+
+EFieldIndex::EFieldIndex()
+    : m_begin(0)
+    , m_end(0)
+{
+}
+
+void EFieldIndex::index(const char *begin, const char *end)
+{
+    size_t len = end - begin;
+
+    if (len > FIELD_INDEX_MAX_BYTES)
+        len = FIELD_INDEX_MAX_BYTES;
+
+    m_begin = begin;
+    m_end = begin + len;
+
+    size_t full = len / 64;
+
+    for (size_t i = 0; i < full; ++i)
+        m_nulls[i] = scanBlock(begin + 64 * i);
+
+    size_t rest = len % 64;
+
+    if (rest) {
+        // never read past the frame, it may end at the end of the ring storage
+        char block[64];
+        memcpy(block, begin + 64 * full, rest);
+        memset(block + rest, 1, 64 - rest);
+        m_nulls[full] = scanBlock(block);
+    }
+}
+
+void EFieldIndex::clear()
+{
+    m_begin = m_end = 0;
+}
+
+const char *EFieldIndex::findFieldEnd(const char *ptr, const char *endPtr) const
+{
+    if (ptr < m_begin || ptr >= m_end)
+        return (const char *)memchr(ptr, 0, endPtr - ptr);
+
+    size_t pos = ptr - m_begin;
+    size_t last = m_end - m_begin;
+    size_t word = pos / 64;
+    uint64_t bits = m_nulls[word] & (~0ULL << (pos % 64));
+
+    for (;;) {
+        if (bits) {
+            const char *fieldEnd = m_begin + 64 * word + lowestBit(bits);
+            return fieldEnd < endPtr ? fieldEnd : 0;
+        }
+
+        if (64 * ++word >= last)
+            break;
+
+        bits = m_nulls[word];
+    }
+
+    // no separator among the indexed bytes
+    return m_end < endPtr ? (const char *)memchr(m_end, 0, endPtr - m_end) : 0;
+}
+
+const EFieldIndex *EFieldIndex::current()
+{
+    return t_current;
+}
+
+EFieldIndex::Scope::Scope(const EFieldIndex *index)
+    : m_prev(t_current)
+{
+    t_current = index;
+}
+
+EFieldIndex::Scope::~Scope()
+{
+    t_current = m_prev;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#ifndef TWS_API_CLIENT_EFIELDINDEX_H
+#define TWS_API_CLIENT_EFIELDINDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "platformspecific.h"
+
+// bytes of a frame covered by the index; tick messages are far shorter, bigger
+// frames fall back to memchr() for whatever lies past it
+#define FIELD_INDEX_MAX_BYTES 1024
+
+// Bitmap of the NUL separators of one frame.
+//
+// index() finds every field boundary of the frame in a single vectorized pass
+// (AVX2 when the compiler targets it, SSE2 otherwise, scalar elsewhere) so that
+// locating the end of each field afterwards is a bit scan instead of a memchr()
+// call per field. EDecoder::parseAndProcessMsg() installs the index of the
+// frame being decoded for the current thread with EFieldIndex::Scope and
+// EDecoder::FindFieldEnd() consults it.
+class TWSAPIDLLEXP EFieldIndex
+{
+    const char *m_begin;
+    const char *m_end;      // end of the indexed bytes
+    uint64_t m_nulls[FIELD_INDEX_MAX_BYTES / 64];
+
+public:
+    EFieldIndex();
+
+    void index(const char *begin, const char *end);
+    void clear();
+
+    // same contract as memchr(ptr, 0, endPtr - ptr)
+    const char *findFieldEnd(const char *ptr, const char *endPtr) const;
+
+    static const EFieldIndex *current();
+
+    // makes an index the current one for the calling thread until destroyed
+    class TWSAPIDLLEXP Scope
+    {
+        const EFieldIndex *m_prev;
+
+    public:
+        explicit Scope(const EFieldIndex *index);
+        ~Scope();
+
+    private:
+        Scope(const Scope&);
+        Scope& operator=(const Scope&);
+    };
+};
+
+#endif
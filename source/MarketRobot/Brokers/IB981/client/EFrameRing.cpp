@@ -0,0 +1,223 @@
+#include "StdAfx.h"
+#include "EFrameRing.h"
+#include "EDecoder.h"
+
+#include <string.h>
+#include <assert.h>
+#include <algorithm>
+
+
+EFrameRing::EFrameRing(size_t capacity)
+	: m_head(0)
+	, m_read(0)
+	, m_tailCache(0)
+	, m_frontSize(0)
+	, m_tail(0)
+	, m_recv(0)
+{
+	m_capacity = 1;
+	while (m_capacity < capacity)
+		m_capacity <<= 1;
+	m_mask = m_capacity - 1;
+
+	// left uninitialized on purpose, pages are only committed once touched
+	m_data = new char[m_capacity];
+}
+
+EFrameRing::~EFrameRing(void)
+{
+	delete[] m_data;
+}
+
+size_t EFrameRing::maxFrameSize() const
+{
+	return m_capacity / 2;
+}
+
+unsigned EFrameRing::readHeader(size_t pos) const
+{
+	unsigned netlen;
+	memcpy(&netlen, m_data + (pos & m_mask), HEADER_LEN);
+	return ntohl(netlen);
+}
+
+void EFrameRing::writeHeader(size_t pos, unsigned len)
+{
+	unsigned netlen = htonl(len);
+	memcpy(m_data + (pos & m_mask), &netlen, HEADER_LEN);
+}
+
+// Make sure the frame starting at the publish position has need contiguous
+// bytes in front of the end of the storage, moving what was already received
+// of it to the start otherwise. Returns false while the consumer still holds
+// the bytes that would be overwritten.
+bool EFrameRing::makeRoom(size_t need)
+{
+	size_t tail = m_tail.load(std::memory_order_relaxed);
+	size_t room = m_capacity - (tail & m_mask);
+
+	if (need <= room)
+		return true;
+
+	size_t start = tail + room;
+
+	if (start + need - m_head.load(std::memory_order_acquire) > m_capacity)
+		return false;
+
+	// need <= capacity / 2 < tail index, so source and destination never overlap
+	size_t pending = m_recv - tail;
+	memcpy(m_data, m_data + (tail & m_mask), pending);
+
+	if (room >= (size_t)HEADER_LEN)
+		writeHeader(tail, 0);
+
+	m_recv = start + pending;
+	m_tail.store(start, std::memory_order_release);
+	return true;
+}
+
+char *EFrameRing::receiveSpace(size_t &avail)
+{
+	size_t tail = m_tail.load(std::memory_order_relaxed);
+	size_t need = HEADER_LEN;
+
+	avail = 0;
+
+	if (m_recv - tail >= (size_t)HEADER_LEN)
+		need = (std::min)(need + readHeader(tail), maxFrameSize());
+
+	if (!makeRoom(need))
+		return 0;
+
+	size_t pos = m_recv & m_mask;
+
+	avail = (std::min)(m_capacity - pos, m_head.load(std::memory_order_acquire) + m_capacity - m_recv);
+
+	return avail > 0 ? m_data + pos : 0;
+}
+
+// Account for sz bytes written at receiveSpace() and publish every frame that
+// is now complete. Returns the number of frames published or -1 when a frame
+// header carries an invalid length.
+int EFrameRing::received(size_t sz)
+{
+	size_t tail = m_tail.load(std::memory_order_relaxed);
+	int nFrames = 0;
+
+	m_recv += sz;
+
+	while (m_recv - tail >= (size_t)HEADER_LEN) {
+		unsigned len = readHeader(tail);
+
+		if (len == 0 || len > (unsigned)MAX_MSG_LEN || HEADER_LEN + len > maxFrameSize())
+			return -1;
+
+		if (m_recv - tail < HEADER_LEN + len)
+			break;
+
+		tail += HEADER_LEN + len;
+		++nFrames;
+	}
+
+	if (nFrames > 0)
+		m_tail.store(tail, std::memory_order_release);
+
+	return nFrames;
+}
+
+// Copy a frame that was framed outside of the ring (pre-V100 protocol).
+bool EFrameRing::appendFrame(const char *buf, size_t sz)
+{
+	size_t need = HEADER_LEN + sz;
+
+	assert(sz > 0 && need <= maxFrameSize());
+
+	if (!makeRoom(need))
+		return false;
+
+	size_t tail = m_tail.load(std::memory_order_relaxed);
+
+	if (tail + need - m_head.load(std::memory_order_acquire) > m_capacity)
+		return false;
+
+	writeHeader(tail, (unsigned)sz);
+	memcpy(m_data + (tail & m_mask) + HEADER_LEN, buf, sz);
+
+	m_recv = tail + need;
+	m_tail.store(m_recv, std::memory_order_release);
+	return true;
+}
+
+// Producer side: walk the frames published since pos, e.g. to record them.
+// Only valid until the next receiveSpace() or appendFrame() call.
+bool EFrameRing::published(size_t &pos, const char *&beginPtr, const char *&endPtr) const
+{
+	size_t tail = m_tail.load(std::memory_order_relaxed);
+
+	while (pos != tail) {
+		size_t room = m_capacity - (pos & m_mask);
+		unsigned len = room < (size_t)HEADER_LEN ? 0 : readHeader(pos);
+
+		if (len == 0) {
+			pos += room;
+			continue;
+		}
+
+		beginPtr = m_data + (pos & m_mask) + HEADER_LEN;
+		endPtr = beginPtr + len;
+		pos += HEADER_LEN + len;
+		return true;
+	}
+
+	return false;
+}
+
+bool EFrameRing::front(const char *&beginPtr, const char *&endPtr)
+{
+	if (m_read == m_tailCache)
+		m_tailCache = m_tail.load(std::memory_order_acquire);
+
+	while (m_read != m_tailCache) {
+		size_t room = m_capacity - (m_read & m_mask);
+		unsigned len = room < (size_t)HEADER_LEN ? 0 : readHeader(m_read);
+
+		if (len == 0) {
+			// skip the padding in front of the end of the storage
+			m_read += room;
+			continue;
+		}
+
+		beginPtr = m_data + (m_read & m_mask) + HEADER_LEN;
+		endPtr = beginPtr + len;
+		m_frontSize = HEADER_LEN + len;
+		return true;
+	}
+
+	return false;
+}
+
+// Consume the frame returned by front(); its space is handed back to the
+// producer on the next release().
+void EFrameRing::pop()
+{
+	assert(m_frontSize > 0);
+
+	m_read += m_frontSize;
+	m_frontSize = 0;
+}
+
+void EFrameRing::release()
+{
+	if (m_head.load(std::memory_order_relaxed) != m_read)
+		m_head.store(m_read, std::memory_order_release);
+}
+
+// Consumer side only: padding in front of a frame still being received does
+// not count as a frame.
+bool EFrameRing::empty()
+{
+	const char *beginPtr;
+	const char *endPtr;
+
+	return !front(beginPtr, endPtr);
+}
@@ -0,0 +1,70 @@
+#pragma once
+#ifndef TWS_API_CLIENT_EFRAMERING_H
+#define TWS_API_CLIENT_EFRAMERING_H
+
+#include <atomic>
+#include <stddef.h>
+#include "platformspecific.h"
+
+#define IN_RING_SIZE_DEFAULT (16 * 1024 * 1024)
+#define RING_CACHE_LINE 64
+
+// Single-producer/single-consumer byte ring holding length-prefixed TWS frames.
+//
+// The reader thread receives socket bytes directly into the ring and publishes
+// every complete frame in place; the consumer decodes each frame from a view
+// into the ring and releases it afterwards. A frame never wraps around the end
+// of the storage: when the frame being received does not fit in front of the
+// end, the few bytes already received are moved to the start once and a zero
+// length header (or fewer than HEADER_LEN bytes of padding) marks the skip.
+//
+// Positions are monotonic byte counters, the capacity is a power of two and a
+// frame (header included) may be at most half of it. The consumer walks frames
+// on a private position and hands the space back in batches with release(),
+// so draining a burst touches the producer's cache line once.
+class TWSAPIDLLEXP EFrameRing
+{
+    char *m_data;
+    size_t m_capacity;
+    size_t m_mask;
+
+    // producer and consumer positions live on separate cache lines
+    alignas(RING_CACHE_LINE) std::atomic<size_t> m_head;   // first byte not yet released by the consumer
+    size_t m_read;                // first byte not yet consumed, consumer only
+    size_t m_tailCache;           // last m_tail seen by the consumer
+    size_t m_frontSize;           // size of the frame returned by front(), consumer only
+
+    alignas(RING_CACHE_LINE) std::atomic<size_t> m_tail;   // end of the last published frame
+    size_t m_recv;                // end of received bytes, producer only
+
+    unsigned readHeader(size_t pos) const;
+    void writeHeader(size_t pos, unsigned len);
+    bool makeRoom(size_t need);
+
+public:
+    explicit EFrameRing(size_t capacity = IN_RING_SIZE_DEFAULT);
+    ~EFrameRing(void);
+
+    size_t maxFrameSize() const;
+
+    // producer side
+    char *receiveSpace(size_t &avail);
+    int received(size_t sz);
+    bool appendFrame(const char *buf, size_t sz);
+    bool published(size_t &pos, const char *&beginPtr, const char *&endPtr) const;
+    size_t tailPosition() const { return m_tail.load(std::memory_order_relaxed); }
+
+    // consumer side
+    bool front(const char *&beginPtr, const char *&endPtr);
+    void pop();
+    size_t frontPosition() const { return m_read; }    // of the frame front() returned
+    void release();
+    bool empty();
+
+private:
+    // disable copy (compatible with pre C++11 compiler hence =delete not used)
+    EFrameRing(const EFrameRing&);
+    EFrameRing& operator=(const EFrameRing&);
+};
+
+#endif
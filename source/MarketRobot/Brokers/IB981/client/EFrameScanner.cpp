@@ -0,0 +1,135 @@
+#include "StdAfx.h"
+#include "EFrameScanner.h"
+#include "EDecoder.h"
+#include "DefaultEWrapper.h"
+
+#include <string.h>
+#include <assert.h>
+
+// a buffer grown by a burst of large messages is given back once idle
+#define IN_BUF_SIZE_IDLE_MAX (64 * IN_BUF_SIZE_DEFAULT)
+
+static DefaultEWrapper defaultWrapper;
+
+EFrameScanner::EFrameScanner()
+	: m_buf(IN_BUF_SIZE_DEFAULT)
+	, m_begin(0)
+	, m_end(0)
+	, m_scanned(0)
+	, m_fieldsLeft(0)
+	, m_serverVersion(0)
+	, m_pDecoder(0)
+{
+}
+
+EFrameScanner::~EFrameScanner(void)
+{
+	delete m_pDecoder;
+}
+
+// At least IN_BUF_SIZE_DEFAULT bytes behind the received ones, moving the
+// unframed bytes to the front or growing the buffer when there is less.
+char *EFrameScanner::receiveSpace(size_t &avail)
+{
+	if (m_buf.size() - m_end < IN_BUF_SIZE_DEFAULT) {
+		size_t pending = m_end - m_begin;
+
+		if (m_begin > 0) {
+			memmove(m_buf.data(), m_buf.data() + m_begin, pending);
+			m_begin = 0;
+			m_end = pending;
+		}
+
+		if (m_buf.size() - m_end < IN_BUF_SIZE_DEFAULT)
+			m_buf.resize(m_buf.size() * 2);
+	}
+
+	avail = m_buf.size() - m_end;
+	return m_buf.data() + m_end;
+}
+
+void EFrameScanner::received(size_t sz)
+{
+	assert(m_end + sz <= m_buf.size());
+	m_end += sz;
+}
+
+int EFrameScanner::next(const char *&msg, int serverVersion, bool drained)
+{
+	size_t pending = m_end - m_begin;
+
+	if (pending == 0)
+		return 0;
+
+	if (m_scanned > 0) {
+		countFields(pending);
+
+		// more of the message may be waiting on the socket, decode it once
+		if (m_fieldsLeft > 0 || !drained)
+			return 0;
+	}
+
+	if (!m_pDecoder || serverVersion != m_serverVersion) {
+		delete m_pDecoder;
+		m_pDecoder = new EDecoder(serverVersion, &defaultWrapper);
+		m_serverVersion = serverVersion;
+	}
+
+	const char *beginPtr = m_buf.data() + m_begin;
+	int msgSize = m_pDecoder->parseAndProcessMsg(beginPtr, beginPtr + pending);
+
+	if (msgSize == 0) {
+		size_t offset = 0;
+		int fields = m_pDecoder->incompleteFields(offset);
+
+		m_scanned = offset;
+		m_fieldsLeft = fields;
+		countFields(pending);
+
+		if (fields <= 0 || m_fieldsLeft <= 0) {
+			// no list, or more follows the one there: wait for the next field
+			m_scanned = pending;
+			m_fieldsLeft = 1;
+		}
+		return 0;
+	}
+
+	m_scanned = 0;
+	m_fieldsLeft = 0;
+	msg = m_buf.data() + m_begin;
+
+	return msgSize > 0 ? msgSize : -1;
+}
+
+// Counts the separators received since the last call, from where it stopped.
+void EFrameScanner::countFields(size_t pending)
+{
+	const char *p = m_buf.data() + m_begin + m_scanned;
+	const char *end = m_buf.data() + m_begin + pending;
+
+	while (m_fieldsLeft > 0 && p < end && (p = (const char *)memchr(p, 0, end - p)) != 0) {
+		--m_fieldsLeft;
+		++p;
+	}
+
+	m_scanned = pending;
+}
+
+void EFrameScanner::pop(size_t sz)
+{
+	assert(sz <= m_end - m_begin);
+
+	m_begin += sz;
+
+	if (m_begin == m_end) {
+		m_begin = m_end = 0;
+
+		if (m_buf.size() > IN_BUF_SIZE_IDLE_MAX)
+			std::vector<char>(IN_BUF_SIZE_DEFAULT).swap(m_buf);
+	}
+}
+
+bool EFrameScanner::empty() const
+{
+	return m_begin == m_end;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#ifndef TWS_API_CLIENT_EFRAMESCANNER_H
+#define TWS_API_CLIENT_EFRAMESCANNER_H
+
+#include <stddef.h>
+#include <vector>
+#include "platformspecific.h"
+
+#define IN_BUF_SIZE_DEFAULT 8192
+
+class EDecoder;
+
+// Splits the pre-V100 byte stream, whose messages carry no length prefix, into
+// messages.
+//
+// The length of such a message is only known once it has been decoded, so the
+// scanner runs a decoder without callbacks over the bytes not framed yet.
+// Received bytes are appended behind them and framed messages are handed out
+// in place; bytes only move when the buffer is compacted.
+//
+// A message found incomplete needs more fields: at least one, since it ran out
+// of bytes in a field without separator, or the rest of the list the decoder
+// read the length of (EDecoder::incompleteFields()). The scanner counts the
+// separators that arrive, keeping the offset up to which it counted so each
+// received byte is looked at once, and only decodes the message again when
+// they are all there and the socket is drained. A long historicalData list
+// trickling in over many reads is decoded once more instead of on every read,
+// and nothing waits on a timer.
+class TWSAPIDLLEXP EFrameScanner
+{
+    std::vector<char> m_buf;
+    size_t m_begin;             // first byte not framed yet
+    size_t m_end;               // end of received bytes
+    size_t m_scanned;           // unframed bytes counted, 0 without an incomplete message
+    long long m_fieldsLeft;     // separators the incomplete message still needs
+    int m_serverVersion;
+    EDecoder *m_pDecoder;
+
+public:
+    EFrameScanner();
+    ~EFrameScanner(void);
+
+    char *receiveSpace(size_t &avail);
+    void received(size_t sz);
+
+    // Frame the next message: returns its size with msg pointing at it, 0
+    // while it is incomplete or -1 on a stream that cannot be decoded. Pass
+    // drained when no more bytes are waiting on the socket.
+    int next(const char *&msg, int serverVersion, bool drained);
+    void pop(size_t sz);
+    bool empty() const;
+
+private:
+    void countFields(size_t pending);
+
+    // disable copy (compatible with pre C++11 compiler hence =delete not used)
+    EFrameScanner(const EFrameScanner&);
+    EFrameScanner& operator=(const EFrameScanner&);
+};
+
+#endif
@@ -35,11 +35,18 @@
 		return ( ioctlsocket( sockfd, FIONBIO, &mode) == 0);
 	}
 
+	inline bool SetSocketNoDelay(int sockfd) {
+		BOOL on = TRUE;
+		return ( setsockopt( sockfd, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on)) == 0);
+	}
+
 #else
 	// LINUX
 	// includes
 
 	#include <arpa/inet.h>
+	#include <netinet/in.h>
+	#include <netinet/tcp.h>
 	#include <netdb.h>
 	#include <errno.h>
 	#include <sys/select.h>
@@ -61,6 +68,11 @@
 		return ( fcntl(sockfd, F_SETFL, flags | O_NONBLOCK) == 0);
 	}
 
+	inline bool SetSocketNoDelay(int sockfd) {
+		int on = 1;
+		return ( setsockopt( sockfd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) == 0);
+	}
+
 #endif
 
 #endif
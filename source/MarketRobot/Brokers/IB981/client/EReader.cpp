@@ -4,17 +4,18 @@
 #include "StdAfx.h"
 #include "Contract.h"
 #include "EDecoder.h"
-#include "EMutex.h"
 #include "EReader.h"
 #include "EClientSocket.h"
 #include "EPosixClientSocketPlatform.h"
 #include "EReaderSignal.h"
-#include "EMessage.h"
-#include "DefaultEWrapper.h"
+#include "ECapture.h"
 
-#define IN_BUF_SIZE_DEFAULT 8192
+#include <thread>
 
-static DefaultEWrapper defaultWrapper;
+#if defined(IB_EPOLL)
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#endif
 
 EReader::EReader(EClientSocket *clientSocket, EReaderSignal *signal)
 	: processMsgsDecoder_(clientSocket->EClient::serverVersion(), clientSocket->getWrapper(), clientSocket)
@@ -27,8 +28,15 @@ EReader::EReader(EClientSocket *clientSocket, EReaderSignal *signal)
 		m_isAlive = true;
         m_pClientSocket = clientSocket;       
 		m_pEReaderSignal = signal;
-		m_nMaxBufSize = IN_BUF_SIZE_DEFAULT;
-		m_buf.reserve(IN_BUF_SIZE_DEFAULT);
+		m_nFrames = 0;
+		m_readPending = false;
+		m_busyPoll = false;
+		m_nCpu = -1;
+		m_capture = 0;
+		m_capturePos = 0;
+		m_frameRecvTime = 0;
+		m_frameDequeueTime = 0;
+		m_trace = false;
 }
 
 EReader::~EReader(void) {
@@ -45,11 +53,73 @@ EReader::~EReader(void) {
         WaitForSingleObject(m_hReadThread, INFINITE);
     }
 #endif
+
+	delete m_capture;
+}
+
+void EReader::setBusyPoll(bool busyPoll, int cpu) {
+	m_busyPoll = busyPoll;
+	m_nCpu = cpu;
+
+#if defined(IB_EPOLL) && defined(SO_BUSY_POLL)
+	if (m_busyPoll && m_pClientSocket->fd() >= 0) {
+		int usec = 50;
+		setsockopt(m_pClientSocket->fd(), SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec));
+	}
+#endif
+}
+
+bool EReader::startCapture(const char *path) {
+	delete m_capture;
+	m_capture = new ECaptureWriter();
+
+	if (!m_capture->open(path, m_pClientSocket->EClient::serverVersion(), m_pClientSocket->usingV100Plus(), m_pClientSocket->TwsConnectionTime())) {
+		delete m_capture;
+		m_capture = 0;
+		return false;
+	}
+
+	return true;
+}
+
+// Append the frames the reader thread just published, stamped with their
+// arrival time.
+void EReader::captureFrames() {
+	uint64_t now = ECaptureWriter::now();
+	const char *pBegin;
+	const char *pEnd;
+
+	while (m_frames.published(m_capturePos, pBegin, pEnd))
+		m_capture->append(now, pBegin, pEnd - pBegin);
+}
+
+void EReader::setTrace(bool trace) {
+	m_trace = trace;
+}
+
+// Reader side: frames published up to the ring's tail arrived now.
+void EReader::stampFrames(uint64_t now) {
+	m_recvStamps.stamp(m_frames.tailPosition(), now);
+}
+
+// processMsgs() side: a frame is published before the reader stamps it, one
+// dispatched in between arrived just now.
+void EReader::lookUpRecvTime() {
+	uint64_t time = m_recvStamps.lookUp(m_frames.frontPosition());
+	m_frameRecvTime = time ? time : ECaptureWriter::now();
 }
 
 void EReader::start() {
 #if defined(IB_POSIX)
     pthread_create( &m_hReadThread, NULL, readToQueueThread, this );
+#if defined(IB_EPOLL)
+	if (m_nCpu >= 0) {
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(m_nCpu, &cpus);
+		pthread_setaffinity_np(m_hReadThread, sizeof(cpus), &cpus);
+	}
+#endif
 #elif defined(IB_WIN32)
     m_hReadThread = CreateThread(0, 0, readToQueueThread, this, 0, 0);
 #else
@@ -72,10 +142,8 @@ DWORD WINAPI EReader::readToQueueThread(LPVOID lpParam)
 }
 
 void EReader::readToQueue() {
-	//EMessage *msg = 0;
-
 	while (m_isAlive) {
-		if (m_buf.size() == 0 && !processNonBlockingSelect() && m_pClientSocket->isSocketOK())
+		if (m_scanner.empty() && !processNonBlockingSelect() && m_pClientSocket->isSocketOK())
 			continue;
 
         if (!putMessageToQueue())
@@ -87,18 +155,11 @@ void EReader::readToQueue() {
 }
 
 bool EReader::putMessageToQueue() {
-	EMessage *msg = 0;
-
-	if (m_pClientSocket->isSocketOK())
-		msg = readSingleMsg();
-
-	if (msg == 0)
+	if (!m_pClientSocket->isSocketOK())
 		return false;
 
-	{
-		EMutexGuard lock(m_csMsgQueue);
-		m_msgQueue.push_back(std::shared_ptr<EMessage>(msg));
-	}
+	if (!(m_pClientSocket->usingV100Plus() ? readFrames() : readSingleMsg()))
+		return false;
 
 	m_pEReaderSignal->issueSignal();
 
@@ -106,6 +167,9 @@ bool EReader::putMessageToQueue() {
 }
 
 bool EReader::processNonBlockingSelect() {
+	if (m_pClientSocket->pollFd() >= 0)
+		return processEpollEvents();
+
 	fd_set readSet, writeSet, errorSet;
 	struct timeval tval;
 
@@ -164,127 +228,201 @@ bool EReader::processNonBlockingSelect() {
 	return false;
 }
 
-void EReader::onSend() {
-	m_pEReaderSignal->issueSignal();
-}
+// Waits without a timeout: EClientSocket::eDisconnect() signals the wake
+// eventfd registered next to the socket, so a closed connection still ends the
+// wait. In busy-poll mode epoll_wait() never sleeps.
+bool EReader::processEpollEvents() {
+#if defined(IB_EPOLL)
+	struct epoll_event events[2];
 
-void EReader::onReceive() {
-	int nOffset = m_buf.size();
+	if( m_pClientSocket->fd() < 0)
+		return false;
 
-	m_buf.resize(m_nMaxBufSize);
-	
-	int nRes = m_pClientSocket->receive(m_buf.data() + nOffset, m_buf.size() - nOffset);
+	int timeout = (m_busyPoll || m_readPending) ? 0 : -1;
+	int ret = epoll_wait( m_pClientSocket->pollFd(), events, 2, timeout);
 
-	if (nRes <= 0)
-		return;
+	if( ret < 0) {
+		if( errno != EINTR)
+			m_pClientSocket->eDisconnect();
+		return false;
+	}
 
- 	m_buf.resize(nRes + nOffset);	
-}
+	bool readable = m_readPending;
 
-bool EReader::bufferedRead(char *buf, unsigned int size) {
-	while (size > 0) {
-		while (m_buf.size() < size && m_buf.size() < m_nMaxBufSize) {
-			if (!processNonBlockingSelect() && !m_pClientSocket->isSocketOK())
-				return false;
+	for( int i = 0; i < ret; ++i) {
+		if( events[i].data.fd != m_pClientSocket->fd()) {
+			// wake-up from eDisconnect(), reset the counter
+			uint64_t value;
+			if( read( events[i].data.fd, &value, sizeof(value)) < 0) {
+				// already reset by another reader
+			}
+			continue;
 		}
 
-		int nBytes = (std::min<unsigned int>)(m_nMaxBufSize, size);
+		if( events[i].events & EPOLLERR)
+			m_pClientSocket->onError();
 
-		std::copy(m_buf.begin(), m_buf.begin() + nBytes, buf);
-		std::copy(m_buf.begin() + nBytes, m_buf.end(), m_buf.begin());
-		m_buf.resize(m_buf.size() - nBytes);
+		if( m_pClientSocket->fd() < 0)
+			return false;
+
+		// EPOLLOUT is reported along with every other event, only wake the
+		// consumer when there is something left to send
+		if( (events[i].events & EPOLLOUT) && !m_pClientSocket->getTransport()->isOutBufferEmpty())
+			onSend();
 
-		size -= nBytes;
-		buf += nBytes;
+		if( events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))
+			readable = true;
 	}
 
-	return true;
+	if( m_pClientSocket->fd() < 0)
+		return false;
+
+	if( readable)
+		onReceive();
+
+	return readable || ret > 0;
+#else
+	return false;
+#endif
 }
 
-EMessage * EReader::readSingleMsg() {
-	if (m_pClientSocket->usingV100Plus()) {
-		int msgSize;
+void EReader::onSend() {
+	m_pEReaderSignal->issueSignal();
+}
 
-		if (!bufferedRead((char *)&msgSize, sizeof(msgSize)))
-			return 0;
+void EReader::onReceive() {
+	if (m_pClientSocket->usingV100Plus()) {
+		onReceiveFrames();
+		return;
+	}
 
-		msgSize = ntohl(msgSize);
+	size_t avail = 0;
+	char *buf = m_scanner.receiveSpace(avail);
 
-		if (msgSize <= 0 || msgSize > MAX_MSG_LEN)
-			return 0;
+	int nRes = m_pClientSocket->receive(buf, avail);
 
-		std::vector<char> buf = std::vector<char>(msgSize);
+	// a full buffer means the socket may not be drained yet
+	m_readPending = nRes > 0 && (size_t)nRes == avail;
 
-		if (!bufferedRead(buf.data(), buf.size()))
-			return 0;
+	if (nRes > 0)
+		m_scanner.received(nRes);
+}
 
-		return new EMessage(buf);
-	}
-	else {
-		const char *pBegin = 0;
-		const char *pEnd = 0;
-		int msgSize = 0;
-
-		while (msgSize == 0)
-		{
-			if (m_buf.size() >= m_nMaxBufSize * 3/4) 
-				m_nMaxBufSize *= 2;
-
-			if (!processNonBlockingSelect() && !m_pClientSocket->isSocketOK())
-				return 0;
-		
-			pBegin = m_buf.data();
-			pEnd = pBegin + m_buf.size();
-			msgSize = EDecoder(m_pClientSocket->EClient::serverVersion(), &defaultWrapper).parseAndProcessMsg(pBegin, pEnd);
+// V100+ frames are length prefixed on the wire, so the socket is read straight
+// into the frame ring and complete frames are published without any copy.
+// Reads until the socket is drained (a short read) so a whole burst is
+// published on one wake-up.
+void EReader::onReceiveFrames() {
+	m_readPending = false;
+
+	for (;;) {
+		size_t avail = 0;
+		char *buf = m_frames.receiveSpace(avail);
+
+		if (!buf) {
+			// consumer is behind, wait for it to release ring space
+			m_readPending = true;
+			std::this_thread::yield();
+			return;
 		}
-	
-		std::vector<char> msgData(msgSize);
 
-		if (!bufferedRead(msgData.data(), msgSize))
-			return 0;
+		int nRes = m_pClientSocket->receive(buf, avail);
 
-		if (m_buf.size() < IN_BUF_SIZE_DEFAULT && m_buf.capacity() > IN_BUF_SIZE_DEFAULT)
-		{
-			m_buf.resize(m_nMaxBufSize = IN_BUF_SIZE_DEFAULT);
-			m_buf.shrink_to_fit();
-		}
+		if (nRes <= 0)
+			return;
 
-		EMessage * msg = new EMessage(msgData);
+		int nFrames = m_frames.received(nRes);
 
-		return msg;
+		if (nFrames > 0)
+			stampFrames(ECaptureWriter::now());
+
+		if (nFrames > 0 && m_capture)
+			captureFrames();
+
+		m_nFrames = (nFrames < 0 || m_nFrames < 0) ? -1 : m_nFrames + nFrames;
+
+		if (m_nFrames < 0 || (size_t)nRes < avail)
+			return;
 	}
 }
 
-std::shared_ptr<EMessage> EReader::getMsg(void) {
-	EMutexGuard lock(m_csMsgQueue);
-
-	if (m_msgQueue.size() == 0) {
-		return std::shared_ptr<EMessage>();
+bool EReader::readFrames() {
+	while (m_isAlive && m_nFrames == 0) {
+		if (!processNonBlockingSelect() && !m_pClientSocket->isSocketOK())
+			return false;
 	}
 
-	std::shared_ptr<EMessage> msg = m_msgQueue.front();
-	m_msgQueue.pop_front();
+	if (m_nFrames <= 0)
+		return false; // shut down or a frame with an invalid length
 
-	return msg;
+	m_nFrames = 0;
+
+	return true;
 }
 
+// Pre-V100 messages are framed by the scanner, which keeps its progress
+// between reads, then copied into the frame ring like V100 frames.
+bool EReader::readSingleMsg() {
+	const char *pMsg = 0;
+	int msgSize;
+
+	while ((msgSize = m_scanner.next(pMsg, m_pClientSocket->EClient::serverVersion(), !m_readPending)) == 0) {
+		if (!processNonBlockingSelect() && !m_pClientSocket->isSocketOK())
+			return false;
+	}
+
+	if (msgSize < 0 || (size_t)msgSize + HEADER_LEN > m_frames.maxFrameSize())
+		return false;
+
+	while (!m_frames.appendFrame(pMsg, msgSize)) {
+		if (!m_isAlive)
+			return false;
+		std::this_thread::yield();
+	}
+
+	stampFrames(ECaptureWriter::now());
+
+	if (m_capture)
+		captureFrames();
 
-void EReader::processMsgs(void) {
+	m_scanner.pop(msgSize);
+
+	return true;
+}
+
+// Decodes up to maxBatch frames (all available ones when maxBatch is 0) and
+// hands their ring space back to the reader thread at once. Returns the number
+// of frames decoded; hasMsgs() tells whether the batch limit left any behind.
+int EReader::processMsgs(int maxBatch) {
 	m_pClientSocket->onSend();
 
-	std::shared_ptr<EMessage> msg = getMsg();
+	const char *pBegin = 0;
+	const char *pEnd = 0;
+	int nMsgs = 0;
 
-	if (!msg.get())
-		return;
+	while ((maxBatch <= 0 || nMsgs < maxBatch) && m_frames.front(pBegin, pEnd)) {
+		lookUpRecvTime();
+		if (m_trace)
+			m_frameDequeueTime = ECaptureWriter::now();
 
-	const char *pBegin = msg->begin();
+		int processed = processMsgsDecoder_.parseAndProcessMsg(pBegin, pEnd);
 
-	while (processMsgsDecoder_.parseAndProcessMsg(pBegin, msg->end()) > 0) {
-		msg = getMsg();
+		m_frames.pop();
+		++nMsgs;
 
-		if (!msg.get())
+		if (processed <= 0)
 			break;
+	}
+
+	m_frames.release();
+
+	return nMsgs;
+}
+
+bool EReader::hasMsgs() {
+	return !m_frames.empty();
+}
 
-		pBegin = msg->begin();
-	} 
+void EReader::skipMsg(int msgId, bool skip) {
+	processMsgsDecoder_.skipMsg(msgId, skip);
 }
@@ -6,35 +6,52 @@
 #define TWS_API_CLIENT_EREADER_H
 
 #include <atomic>
-#include <deque>
+#include <vector>
 #include "platformspecific.h"
 #include "EDecoder.h"
-#include "EMutex.h"
+#include "EFrameRing.h"
+#include "EFrameScanner.h"
+#include "ERecvStamps.h"
 #include "EReaderOSSignal.h"
 
 class EClientSocket;
+class ECaptureWriter;
 struct EReaderSignal;
-class EMessage;
 
 class TWSAPIDLLEXP EReader
 {  
     EClientSocket *m_pClientSocket;
     EReaderSignal *m_pEReaderSignal;
     EDecoder processMsgsDecoder_;
-    std::deque<std::shared_ptr<EMessage>> m_msgQueue;
-    EMutex m_csMsgQueue;
-    std::vector<char> m_buf;
+    EFrameRing m_frames;
+    int m_nFrames;
+    EFrameScanner m_scanner;	// pre-V100 stream not framed yet
     std::atomic<bool> m_isAlive;
 #if defined(IB_POSIX)
     pthread_t m_hReadThread;
 #elif defined(IB_WIN32)
     HANDLE m_hReadThread;
 #endif
-	unsigned int m_nMaxBufSize;
+	bool m_readPending;	// socket not drained yet, edge-triggered polling won't report it again
+	bool m_busyPoll;
+	int m_nCpu;
+	ECaptureWriter *m_capture;
+	size_t m_capturePos;	// ring position behind the last captured frame
+
+	// socket receive time of the frames: the reader stamps the ring position
+	// behind every batch of frames it publishes, processMsgs() looks the
+	// frame it dispatches up
+	ERecvStamps m_recvStamps;
+	uint64_t m_frameRecvTime;
+	uint64_t m_frameDequeueTime;
+	bool m_trace;
+	void stampFrames(uint64_t now);
+	void lookUpRecvTime();
 
 	void onReceive();
+	void onReceiveFrames();
 	void onSend();
-	bool bufferedRead(char *buf, unsigned int size);
+	void captureFrames();
 
 public:
     EReader(EClientSocket *clientSocket, EReaderSignal *signal);
@@ -42,7 +59,7 @@ public:
 
 protected:
 	bool processNonBlockingSelect();
-    std::shared_ptr<EMessage> getMsg(void);
+	bool processEpollEvents();
     void readToQueue();
 #if defined(IB_POSIX)
     static void * readToQueueThread(void * lpParam);
@@ -52,12 +69,28 @@ protected:
 #   error "Not implemented on this platform"
 #endif
     
-    EMessage * readSingleMsg();
+    bool readFrames();
+    bool readSingleMsg();
 
 public:
-    void processMsgs(void);
+    int processMsgs(int maxBatch = 0);
+	bool hasMsgs();
+	// drop messages of this type in processMsgs() without decoding them
+	void skipMsg(int msgId, bool skip = true);
 	bool putMessageToQueue();
 	void start();
+	// spin on the socket instead of sleeping in the kernel, optionally pinning
+	// the read thread to a cpu; call before start()
+	void setBusyPoll(bool busyPoll, int cpu = -1);
+	// record every inbound frame to a capture file ECaptureServer can replay;
+	// call before start()
+	bool startCapture(const char *path);
+	// steady clock nanoseconds (ECaptureWriter::now()) of the frame processMsgs()
+	// is dispatching: when its bytes came off the socket, and with setTrace()
+	// when processMsgs() took it off the queue
+	uint64_t frameRecvTime() const { return m_frameRecvTime; }
+	uint64_t frameDequeueTime() const { return m_frameDequeueTime; }
+	void setTrace(bool trace);
 };
 
 #endif
\ No newline at end of file
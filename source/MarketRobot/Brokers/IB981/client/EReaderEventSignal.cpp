@@ -0,0 +1,79 @@
+#include "StdAfx.h"
+#include "EReaderEventSignal.h"
+
+#if defined(IB_EPOLL)
+
+#include <stdexcept>
+#include <stdint.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/eventfd.h>
+
+
+EReaderEventSignal::EReaderEventSignal(unsigned long waitTimeout, bool busyPoll)
+{
+    m_waitTimeout = waitTimeout;
+    m_busyPoll = busyPoll;
+    m_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if (m_fd < 0)
+		throw std::runtime_error("Failed to create event");
+}
+
+
+EReaderEventSignal::~EReaderEventSignal(void)
+{
+    close(m_fd);
+}
+
+
+void EReaderEventSignal::issueSignal() {
+    uint64_t one = 1;
+
+    if (write(m_fd, &one, sizeof(one)) < 0) {
+        // counter saturated, the consumer has a wake-up pending already
+    }
+}
+
+void EReaderEventSignal::waitForSignal() {
+    uint64_t value;
+
+    if (m_busyPoll) {
+        // spin until signalled or timed out, never give up the cpu
+        struct timespec now, deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += m_waitTimeout / 1000;
+        deadline.tv_nsec += 1000 * 1000 * (m_waitTimeout % 1000);
+        deadline.tv_sec += deadline.tv_nsec / (1000 * 1000 * 1000);
+        deadline.tv_nsec %= (1000 * 1000 * 1000);
+
+        while (read(m_fd, &value, sizeof(value)) < 0) {
+            if (m_waitTimeout == INFINITE)
+                continue;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if (now.tv_sec > deadline.tv_sec || (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec))
+                return;
+        }
+        return;
+    }
+
+    if (read(m_fd, &value, sizeof(value)) == sizeof(value))
+        return;
+
+    struct pollfd pfd;
+    pfd.fd = m_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    if (poll(&pfd, 1, m_waitTimeout == INFINITE ? -1 : (int)m_waitTimeout) > 0) {
+        if (read(m_fd, &value, sizeof(value)) < 0) {
+            // consumed concurrently
+        }
+    }
+}
+
+int EReaderEventSignal::fd() const {
+    return m_fd;
+}
+
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+#ifndef TWS_API_CLIENT_EREADEREVENTSIGNAL_H
+#define TWS_API_CLIENT_EREADEREVENTSIGNAL_H
+
+#include "EReaderSignal.h"
+#include "platformspecific.h"
+
+#if defined(IB_EPOLL)
+
+#if !defined(INFINITE)
+#define INFINITE ((unsigned long)-1)
+#endif
+
+// EReaderSignal backed by an eventfd: issueSignal() is a single write() with
+// no mutex or condition variable, and the descriptor can be added to the
+// consumer's own poll set through fd().
+class TWSAPIDLLEXP EReaderEventSignal :
+	public EReaderSignal
+{
+    int m_fd;
+    bool m_busyPoll;
+    unsigned long m_waitTimeout; // in milliseconds
+
+public:
+	EReaderEventSignal(unsigned long waitTimeout = INFINITE, bool busyPoll = false);
+	virtual ~EReaderEventSignal(void);
+
+	virtual void issueSignal();
+	virtual void waitForSignal();
+
+	int fd() const;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,125 @@
+#include "StdAfx.h"
+#include "EReaderFutexSignal.h"
+
+#if defined(IB_FUTEX)
+
+#include <time.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#define NSEC_PER_MSEC (1000ULL * 1000)
+#define NSEC_PER_SEC (1000ULL * 1000 * 1000)
+
+namespace {
+
+    unsigned long long monotonicNow() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+    }
+
+    inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        __asm__ __volatile__("yield");
+#endif
+    }
+
+    int futexWait(std::atomic<int> *addr, int expected, const struct timespec *timeout) {
+        return syscall(SYS_futex, reinterpret_cast<int *>(addr), FUTEX_WAIT_PRIVATE, expected, timeout, 0, 0);
+    }
+
+    int futexWake(std::atomic<int> *addr, int count) {
+        return syscall(SYS_futex, reinterpret_cast<int *>(addr), FUTEX_WAKE_PRIVATE, count, 0, 0, 0);
+    }
+}
+
+
+EReaderFutexSignal::EReaderFutexSignal(unsigned long waitTimeout, WaitStrategy strategy, unsigned spinCount)
+    : m_seq(0)
+    , m_waiters(0)
+    , m_seen(0)
+    , m_strategy(strategy)
+    , m_spinCount(spinCount)
+    , m_waitTimeout(waitTimeout)
+{
+}
+
+
+EReaderFutexSignal::~EReaderFutexSignal(void)
+{
+}
+
+
+void EReaderFutexSignal::issueSignal() {
+    m_seq.fetch_add(1, std::memory_order_seq_cst);
+
+    // pairs with the waiter count raised before the consumer re-checks m_seq
+    if (m_waiters.load(std::memory_order_seq_cst) > 0)
+        futexWake(&m_seq, 1);
+}
+
+void EReaderFutexSignal::waitForSignal() {
+    unsigned long long deadline = m_waitTimeout == INFINITE ? ULLONG_MAX : monotonicNow() + m_waitTimeout * NSEC_PER_MSEC;
+
+    if (m_strategy == WAIT_BLOCK || !spin(deadline))
+        block(deadline);
+
+    m_seen = m_seq.load(std::memory_order_acquire);
+}
+
+EReaderFutexSignal::WaitStrategy EReaderFutexSignal::strategy() const {
+    return m_strategy;
+}
+
+// Returns true when signalled (or timed out in WAIT_SPIN mode), false when the
+// spin budget ran out and the caller should block.
+bool EReaderFutexSignal::spin(unsigned long long deadline) {
+    for (unsigned i = 1; ; ++i) {
+        if (m_seq.load(std::memory_order_acquire) != m_seen)
+            return true;
+
+        if (m_strategy != WAIT_SPIN && i >= m_spinCount)
+            return false;
+
+        // reading the clock costs more than a pause, check it now and then
+        if ((i & 1023) == 0 && deadline != ULLONG_MAX && monotonicNow() >= deadline)
+            return true;
+
+        cpuRelax();
+    }
+}
+
+void EReaderFutexSignal::block(unsigned long long deadline) {
+    m_waiters.fetch_add(1, std::memory_order_seq_cst);
+
+    for (;;) {
+        int seq = m_seq.load(std::memory_order_seq_cst);
+
+        if (seq != m_seen)
+            break;
+
+        struct timespec ts;
+        struct timespec *timeout = 0;
+
+        if (deadline != ULLONG_MAX) {
+            unsigned long long now = monotonicNow();
+
+            if (now >= deadline)
+                break;
+
+            ts.tv_sec = (deadline - now) / NSEC_PER_SEC;
+            ts.tv_nsec = (deadline - now) % NSEC_PER_SEC;
+            timeout = &ts;
+        }
+
+        // returns at once when m_seq moved on since it was read
+        futexWait(&m_seq, seq, timeout);
+    }
+
+    m_waiters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+#ifndef TWS_API_CLIENT_EREADERFUTEXSIGNAL_H
+#define TWS_API_CLIENT_EREADERFUTEXSIGNAL_H
+
+#include <atomic>
+#include "EReaderSignal.h"
+#include "platformspecific.h"
+
+#if defined(IB_FUTEX)
+
+#if !defined(INFINITE)
+#define INFINITE ((unsigned long)-1)
+#endif
+
+#define SIGNAL_SPIN_COUNT_DEFAULT 20000
+
+// EReaderSignal for a single consumer built on a sequence counter.
+//
+// issueSignal() bumps the counter and only enters the kernel when the consumer
+// is actually asleep on it, so the reader thread pays a single atomic add per
+// burst while the consumer is spinning. The consumer picks how to wait:
+//   WAIT_BLOCK            sleep on the futex right away
+//   WAIT_SPIN_THEN_BLOCK  spin for a while first, then sleep on the futex
+//   WAIT_SPIN             never sleep, spin until signalled or timed out
+class TWSAPIDLLEXP EReaderFutexSignal :
+	public EReaderSignal
+{
+public:
+    enum WaitStrategy {
+        WAIT_BLOCK,
+        WAIT_SPIN_THEN_BLOCK,
+        WAIT_SPIN
+    };
+
+private:
+    std::atomic<int> m_seq;       // futex word, bumped by every signal
+    std::atomic<int> m_waiters;   // consumer asleep in the kernel
+    int m_seen;                   // last sequence handled, consumer only
+    WaitStrategy m_strategy;
+    unsigned m_spinCount;
+    unsigned long m_waitTimeout;  // in milliseconds
+
+    bool spin(unsigned long long deadline);
+    void block(unsigned long long deadline);
+
+public:
+	EReaderFutexSignal(unsigned long waitTimeout = INFINITE, WaitStrategy strategy = WAIT_BLOCK,
+        unsigned spinCount = SIGNAL_SPIN_COUNT_DEFAULT);
+	virtual ~EReaderFutexSignal(void);
+
+	virtual void issueSignal();
+	virtual void waitForSignal();
+
+    WaitStrategy strategy() const;
+
+private:
+    // disable copy (compatible with pre C++11 compiler hence =delete not used)
+    EReaderFutexSignal(const EReaderFutexSignal&);
+    EReaderFutexSignal& operator=(const EReaderFutexSignal&);
+};
+
+#endif
+
+#endif
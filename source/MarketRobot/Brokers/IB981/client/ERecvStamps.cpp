@@ -0,0 +1,44 @@
+#include "StdAfx.h"
+#include "ERecvStamps.h"
+
+
+ERecvStamps::ERecvStamps()
+	: m_tail(0)
+	, m_head(0)
+{
+	for (size_t i = 0; i < RECV_STAMPS_DEFAULT; ++i) {
+		m_stamps[i].end.store(0, std::memory_order_relaxed);
+		m_stamps[i].time.store(0, std::memory_order_relaxed);
+	}
+}
+
+void ERecvStamps::stamp(size_t end, uint64_t time) {
+	size_t tail = m_tail.load(std::memory_order_relaxed);
+
+	if (tail - m_head.load(std::memory_order_acquire) == RECV_STAMPS_DEFAULT) {
+		// the consumer may drop this stamp meanwhile, its frames then look
+		// unstamped and lookUp() leaves them to the caller
+		Stamp &newest = m_stamps[(tail - 1) % RECV_STAMPS_DEFAULT];
+		newest.time.store(time, std::memory_order_relaxed);
+		newest.end.store(end, std::memory_order_release);
+		return;
+	}
+
+	Stamp &stamp = m_stamps[tail % RECV_STAMPS_DEFAULT];
+	stamp.end.store(end, std::memory_order_relaxed);
+	stamp.time.store(time, std::memory_order_relaxed);
+	m_tail.store(tail + 1, std::memory_order_release);
+}
+
+uint64_t ERecvStamps::lookUp(size_t pos) {
+	size_t head = m_head.load(std::memory_order_relaxed);
+	size_t tail = m_tail.load(std::memory_order_acquire);
+
+	// the frame belongs to the first batch ending behind it
+	while (head != tail && m_stamps[head % RECV_STAMPS_DEFAULT].end.load(std::memory_order_acquire) <= pos)
+		++head;
+
+	m_head.store(head, std::memory_order_release);
+
+	return head != tail ? m_stamps[head % RECV_STAMPS_DEFAULT].time.load(std::memory_order_relaxed) : 0;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#ifndef TWS_API_CLIENT_ERECVSTAMPS_H
+#define TWS_API_CLIENT_ERECVSTAMPS_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include "platformspecific.h"
+
+#define RECV_STAMPS_DEFAULT 256
+
+// Socket receive time of the frames in an EFrameRing, a single-producer/
+// single-consumer queue of stamps.
+//
+// The reader thread stamps the ring position behind every batch of frames it
+// publishes with the time the batch arrived; the consumer looks up the frame
+// it dispatches and drops the stamps of batches dispatched completely. When
+// the consumer is that far behind that the queue is full, the newest stamp is
+// moved up to cover the new batch too, so the frames behind take a fresh time
+// and not one of a batch long gone.
+class TWSAPIDLLEXP ERecvStamps
+{
+    struct Stamp {
+        std::atomic<size_t> end;        // ring position behind the batch
+        std::atomic<uint64_t> time;
+    };
+    Stamp m_stamps[RECV_STAMPS_DEFAULT];
+    std::atomic<size_t> m_tail;         // producer
+    std::atomic<size_t> m_head;         // consumer
+
+public:
+    ERecvStamps();
+
+    // producer side: the frames published up to ring position end arrived at time
+    void stamp(size_t end, uint64_t time);
+
+    // consumer side: arrival time of the frame at ring position pos, 0 while
+    // the producer has published it but not stamped it yet
+    uint64_t lookUp(size_t pos);
+
+private:
+    // disable copy (compatible with pre C++11 compiler hence =delete not used)
+    ERecvStamps(const ERecvStamps&);
+    ERecvStamps& operator=(const ERecvStamps&);
+};
+
+#endif
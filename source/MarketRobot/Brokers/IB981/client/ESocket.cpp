@@ -6,13 +6,25 @@
 #include "ESocket.h"
 
 #include <assert.h>
+#include <string.h>
+#include <algorithm>
 
 #if defined(IB_POSIX)
 #include <sys/socket.h>
+#include <sys/uio.h>
 #endif
 
 
-ESocket::ESocket() {
+static const size_t BufferSizeHighMark = 1 * 1024 * 1024; // 1Mb
+
+ESocket::ESocket()
+	: m_fd(-1)
+	, m_outCapacity(OUT_RING_SIZE_DEFAULT)
+	, m_outHead(0)
+	, m_outTail(0)
+	, m_corkDepth(0)
+{
+	m_outRing = new char[m_outCapacity];
 }
 
 void ESocket::fd(int fd) {
@@ -20,6 +32,7 @@ void ESocket::fd(int fd) {
 }
 
 ESocket::~ESocket(void) {
+	delete[] m_outRing;
 }
 
 int ESocket::send(EMessage *pMsg) {
@@ -31,16 +44,25 @@ int ESocket::bufferedSend(const char* buf, size_t sz)
 	if( sz <= 0)
 		return 0;
 
-	if( !m_outBuffer.empty()) {
-		m_outBuffer.insert( m_outBuffer.end(), buf, buf + sz);
-		return sendBufferedData();
+	EMutexGuard lock( m_outMutex);
+
+	if( corkedByCaller()) {
+		enqueue( buf, sz);
+		return (int)sz;
+	}
+
+	// keep the order of the stream: whatever is queued goes out first, in
+	// the same write as this message
+	if( m_outTail != m_outHead) {
+		enqueue( buf, sz);
+		return sendQueued();
 	}
 
 	int nResult = send(buf, sz);
 
 	if( nResult < (int)sz) {
 		int sent = (std::max)( nResult, 0);
-		m_outBuffer.insert( m_outBuffer.end(), buf + sent, buf + sz);
+		enqueue( buf + sent, sz - sent);
 	}
 
 	return nResult;
@@ -48,15 +70,43 @@ int ESocket::bufferedSend(const char* buf, size_t sz)
 
 int ESocket::sendBufferedData()
 {
-	if( m_outBuffer.empty())
+	EMutexGuard lock( m_outMutex);
+
+	// a corked batch is sent by its flush()
+	if( m_corkDepth > 0)
 		return 0;
 
-	int nResult = send( &m_outBuffer[0], m_outBuffer.size());
-	if( nResult <= 0) {
-		return nResult;
+	return sendQueued();
+}
+
+void ESocket::cork()
+{
+	EMutexGuard lock( m_outMutex);
+
+	if( m_corkDepth == 0)
+		m_corkOwner = std::this_thread::get_id();
+	else if( !corkedByCaller())
+		return;	// corked by another thread, requests of this one are sent right away
+
+	++m_corkDepth;
+}
+
+int ESocket::flush()
+{
+	EMutexGuard lock( m_outMutex);
+
+	if( m_corkDepth > 0) {
+		if( !corkedByCaller() || --m_corkDepth > 0)
+			return 0;
+		m_corkOwner = std::thread::id();
 	}
-	CleanupBuffer( m_outBuffer, nResult);
-	return nResult;
+
+	return sendQueued();
+}
+
+bool ESocket::corkedByCaller() const
+{
+	return m_corkDepth > 0 && m_corkOwner == std::this_thread::get_id();
 }
 
 int ESocket::send(const char* buf, size_t sz)
@@ -75,32 +125,100 @@ int ESocket::send(const char* buf, size_t sz)
 	return nResult;
 }
 
-static const size_t BufferSizeHighMark = 1 * 1024 * 1024; // 1Mb
-
-void ESocket::CleanupBuffer(std::vector<char>& buffer, int processed)
+// Write the queued bytes with one gathering write, two segments when they
+// wrap around the end of the ring.
+int ESocket::sendQueued()
 {
-	assert( buffer.empty() || processed <= (int)buffer.size());
+	size_t pending = m_outTail - m_outHead;
+
+	if( pending == 0)
+		return 0;
 
-	if( buffer.empty())
-		return;
+	size_t pos = m_outHead & (m_outCapacity - 1);
+	size_t first = (std::min)( pending, m_outCapacity - pos);
 
-	if( processed <= 0)
-		return;
+#if defined(IB_POSIX)
+	struct iovec iov[2];
+	iov[0].iov_base = m_outRing + pos;
+	iov[0].iov_len = first;
+	iov[1].iov_base = m_outRing;
+	iov[1].iov_len = pending - first;
+
+	int nResult = (int)::writev( m_fd, iov, first < pending ? 2 : 1);
+#else
+	WSABUF bufs[2];
+	bufs[0].buf = m_outRing + pos;
+	bufs[0].len = (ULONG)first;
+	bufs[1].buf = m_outRing;
+	bufs[1].len = (ULONG)(pending - first);
+
+	DWORD sent = 0;
+	int nResult = WSASend( m_fd, bufs, first < pending ? 2 : 1, &sent, 0, 0, 0) == 0 ? (int)sent : -1;
+#endif
 
-	if( (size_t)processed == buffer.size()) {
-		if( buffer.capacity() >= BufferSizeHighMark) {
-			std::vector<char>().swap(buffer);
-		}
-		else {
-			buffer.clear();
-		}
+	if( nResult == -1) {
+		return -1;
+	}
+	if( nResult <= 0) {
+		return 0;
 	}
-	else {
-		buffer.erase( buffer.begin(), buffer.begin() + processed);
+
+	m_outHead += nResult;
+
+	if( m_outHead == m_outTail) {
+		m_outHead = m_outTail = 0;
+		if( m_outCapacity >= BufferSizeHighMark)
+			resizeRing( OUT_RING_SIZE_DEFAULT);
+	}
+
+	return nResult;
+}
+
+void ESocket::enqueue(const char* buf, size_t sz)
+{
+	size_t need = m_outTail - m_outHead + sz;
+
+	if( need > m_outCapacity) {
+		size_t capacity = m_outCapacity;
+		while( capacity < need)
+			capacity <<= 1;
+		resizeRing( capacity);
 	}
+
+	size_t pos = m_outTail & (m_outCapacity - 1);
+	size_t first = (std::min)( sz, m_outCapacity - pos);
+
+	memcpy( m_outRing + pos, buf, first);
+	memcpy( m_outRing, buf + first, sz - first);
+
+	m_outTail += sz;
 }
 
-bool ESocket::isOutBufferEmpty() const
+// Move the queued bytes to the start of a ring of the given power of two size.
+void ESocket::resizeRing(size_t capacity)
 {
-	return m_outBuffer.empty();
+	size_t pending = m_outTail - m_outHead;
+	size_t pos = m_outHead & (m_outCapacity - 1);
+	size_t first = (std::min)( pending, m_outCapacity - pos);
+
+	assert( pending <= capacity);
+
+	char *ring = new char[capacity];
+	memcpy( ring, m_outRing + pos, first);
+	memcpy( ring + first, m_outRing, pending - first);
+
+	delete[] m_outRing;
+	m_outRing = ring;
+	m_outCapacity = capacity;
+	m_outHead = 0;
+	m_outTail = pending;
+}
+
+// True while there is nothing the reader should send on a writable socket;
+// corked bytes wait for their flush().
+bool ESocket::isOutBufferEmpty()
+{
+	EMutexGuard lock( m_outMutex);
+
+	return m_corkDepth > 0 || m_outTail == m_outHead;
 }
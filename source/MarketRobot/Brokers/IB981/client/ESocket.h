@@ -6,26 +6,54 @@
 #define TWS_API_CLIENT_ESOCKET_H
 
 #include "ETransport.h"
-#include <vector>
+#include "EMutex.h"
+#include <thread>
 
+#define OUT_RING_SIZE_DEFAULT (64 * 1024)
+
+// Outbound bytes that could not be written right away are kept in a ring and
+// sent with a single gathering write once the socket is writable again.
+//
+// A thread can cork the socket around a burst of requests (subscribing every
+// security, a cancel storm): its requests are only queued and go out together
+// on the matching flush(). Requests of other threads are never held back, they
+// send whatever is queued, corked or not.
 class ESocket :
     public ETransport
 {
     int m_fd;
-	std::vector<char> m_outBuffer;
 
-    int bufferedSend(const char* buf, size_t sz);
+    EMutex m_outMutex;
+    char *m_outRing;
+    size_t m_outCapacity;
+    size_t m_outHead;             // first byte not yet sent
+    size_t m_outTail;             // end of queued bytes
+    int m_corkDepth;
+    std::thread::id m_corkOwner;
+
     int send(const char* buf, size_t sz);
-    void CleanupBuffer(std::vector<char>& buffer, int processed);
+    int sendQueued();
+    void enqueue(const char* buf, size_t sz);
+    void resizeRing(size_t capacity);
+    bool corkedByCaller() const;
 
 public:
     ESocket();
     virtual ~ESocket(void);
 
     int send(EMessage *pMsg);
-    bool isOutBufferEmpty() const;
+    int bufferedSend(const char* buf, size_t sz);
+    bool isOutBufferEmpty();
     int sendBufferedData();
     void fd(int fd);
+
+    void cork();
+    int flush();
+
+private:
+    // disable copy (compatible with pre C++11 compiler hence =delete not used)
+    ESocket(const ESocket&);
+    ESocket& operator=(const ESocket&);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -2,7 +2,6 @@
  * and conditions of the IB API Non-Commercial License or the IB API Commercial License, as applicable. */
 
 #pragma once
-#ifdef _MSC_VER
 #ifndef TWS_API_CLIENT_STDAFX_H
 #define TWS_API_CLIENT_STDAFX_H
 
@@ -33,4 +32,3 @@
 #include <float.h>
 
 #endif
-#endif
@@ -47,6 +47,11 @@
 #error "Not supported on this platform"
 #endif
 
+#if defined(__linux__)
+#define IB_EPOLL // edge-triggered epoll reactor in EReader, eventfd reader signal
+#define IB_FUTEX // futex based reader signal with spin wait strategies
+#endif
+
 #endif // #ifdef _MSC_VER
 
 #ifndef TWSAPIDLLEXP
@@ -7,6 +7,8 @@
 #include "Common/Util/util.h"
 #include "Common/Security/portfoliomanager.h"
 #include "Common/Logger/spdlogger.h"
+#include "Components/latencytrace.h"
+#include "Brokers/IB981/client/ECapture.h"
 
 #include <mutex>
 #include <algorithm>
@@ -21,17 +23,98 @@ namespace MarketRobot
 {
 	
 	extern std::atomic<bool> gShutdown;
+	extern atomic<uint64_t> MICRO_SERVICE_NUMBER;
+
+	static const size_t COMMANDQUEUESIZE = 1024;		// commands posted to the reactor
+
+	// set on the client request thread of a reactor
+	static thread_local bool onClientThread = false;
+
+	// the market data connections of a sharded stage fill in contract details at the same time
+	static std::mutex securityDetailsMutex;
+
+	// message types whose callbacks are left to DefaultEWrapper; the reader
+	// drops them without decoding
+	static const int skippedMsgs_[] = {
+		TICK_OPTION_COMPUTATION, TICK_GENERIC, TICK_STRING, TICK_EFP,
+		NEWS_BULLETINS, TICK_NEWS, NEWS_PROVIDERS, NEWS_ARTICLE, HISTORICAL_NEWS, HISTORICAL_NEWS_END,
+		TICK_REQ_PARAMS, SMART_COMPONENTS, MKT_DEPTH_EXCHANGES, MARKET_RULE,
+		DISPLAY_GROUP_LIST, DISPLAY_GROUP_UPDATED, SOFT_DOLLAR_TIERS, FAMILY_CODES, HISTOGRAM_DATA
+	};
+
+	// 2-seconds timeout whichever signal it is
+	static ::EReaderSignal* readerSignalFromConfig() {
+		const unsigned long timeout = 2000;
+		const string& s = CConfig::instance().ib_wait_strategy;
+#if defined(IB_EPOLL)
+		if (s == "eventfd")
+			return new ::EReaderEventSignal(timeout, CConfig::instance().ib_busy_poll);
+#endif
+#if defined(IB_FUTEX)
+		if (s == "spin")
+			return new ::EReaderFutexSignal(timeout, ::EReaderFutexSignal::WAIT_SPIN);
+		else if (s == "spin_futex")
+			return new ::EReaderFutexSignal(timeout, ::EReaderFutexSignal::WAIT_SPIN_THEN_BLOCK);
+		return new ::EReaderFutexSignal(timeout, ::EReaderFutexSignal::WAIT_BLOCK);
+#else
+		if (s != "blocking")
+			LOG_ERROR("wait_strategy {} is not built on this platform, blocking", s);
+		return new ::EReaderOSSignal(timeout);
+#endif
+	}
 	
-	IBBrokerage::IBBrokerage() :
-		m_osSignal(2000)//2-seconds timeout
-		, m_pClient(new ::EClientSocket(this, &m_osSignal))
+	IBBrokerage::IBBrokerage() : IBBrokerage(IBRole::All, 0)
+	{
+	}
+
+	IBBrokerage::IBBrokerage(IBRole role, int clientId, int shard, std::vector<int> tickers, IBBrokerage* publisher) :
+		role_(role)
+		, clientId_(clientId)
+		, shard_(shard)
+		, tickers_(std::move(tickers))
+		, publisher_(publisher ? publisher : this)
+		, m_osSignal(readerSignalFromConfig())
+		, m_pClient(new ::EClientSocket(this, m_osSignal.get()))
 		, m_sleepDeadline(0)
 		, m_pReader(0)
 		, m_extraAuth(false)
 		, lastPriceCache_(CConfig::instance().securities.size(), 0.0)
 		, bidPriceCache_(CConfig::instance().securities.size(), 0.0)
 		, askPriceCache_(CConfig::instance().securities.size(), 0.0)
+		, commands_(COMMANDQUEUESIZE)
+		, histDownloader_(m_pClient, HISTREQUESTSTARTINGPOINT)
+	{
+		IBHistoricalDownloader::Pacing pacing;
+		pacing.maxInFlight = CConfig::instance().ib_hist_inflight;
+		histDownloader_.setPacing(pacing);
+
+		if (publisher_ == this) {
+			lastTickTime_.reset(new std::atomic<uint64_t>[CConfig::instance().securities.size()]);
+			for (size_t i = 0; i < CConfig::instance().securities.size(); ++i)
+				lastTickTime_[i].store(0, std::memory_order_relaxed);
+		}
+
+		if (role_ == IBRole::All) {
+			for (int i = 0; i < (int)CConfig::instance().securities.size(); ++i)
+				tickers_.push_back(i);
+		}
+		else if (role_ == IBRole::Orders) {
+			tickers_.clear();
+		}
+	}
+
+	int IBBrokerage::shardCpu(int cpu) const
 	{
+		// market data connection n takes the n+1-th cpu after the configured one
+		return cpu < 0 || shard_ < 0 ? cpu : cpu + shard_ + 1;
+	}
+
+	// every connection writes its own, they are saved concurrently
+	string IBBrokerage::contractCachePath() const
+	{
+		if (shard_ < 0)
+			return CConfig::instance().dataDir() + "/ib_contract_details.tsv";
+		return CConfig::instance().dataDir() + "/ib_contract_details_" + to_string(shard_) + ".tsv";
 	}
 
 	//! [socket_init]
@@ -47,19 +130,24 @@ namespace MarketRobot
 	// Brokerage part
 	void IBBrokerage::processBrokerageMessages()
 	{
-		fd_set readSet, writeSet, errorSet;
-
-		struct timeval tval;
-		tval.tv_usec = 0;
-		tval.tv_sec = 0;
+		if (!stepBrokerage())
+			return;
 
-		time_t now = std::time(NULL);
+		// a bounded batch keeps the heartbeat and state machine above running
+		// under load; frames left behind are handled without waiting again
+		if (!m_pReader->hasMsgs())
+			m_osSignal->waitForSignal();
+		dispatchMessages();
+	}
 
+	bool IBBrokerage::stepBrokerage()
+	{
 		if (!brokerage::heatbeat(5)) {
 			disconnectFromBrokerage();
-			return;
+			return false;
 		}
 
+		readyToOrder_.store(bkstate_ == BK_READYTOORDER, std::memory_order_release);
 		switch (bkstate_) {
 		case BK_ACCOUNT:		// not used
 			requestBrokerageAccountInformation(CConfig::instance().account);
@@ -72,7 +160,8 @@ namespace MarketRobot
 		case BK_GETORDERIDACK:
 			break;
 		case BK_READYTOORDER:
-			monitorClientRequest();
+			if (!clientThread_)
+				monitorClientRequest();
 			break;
 		case BK_PLACEORDER_ACK:
 			break;
@@ -82,19 +171,114 @@ namespace MarketRobot
 		case BK_CANCELORDER_ACK:
 			break;
 		}
+		return true;
+	}
+
+	void IBBrokerage::dispatchMessages()
+	{
+		m_pReader->processMsgs(CConfig::instance().ib_msg_batch);
+		histDownloader_.pump();
+	}
+
+	void IBBrokerage::runReactor()
+	{
+		MICRO_SERVICE_NUMBER++;
+
+		int cpu = shardCpu(CConfig::instance().ib_reactor_cpu);
+		if (cpu >= 0) {
+#if defined(IB_POSIX)
+			cpu_set_t cpus;
+			CPU_ZERO(&cpus);
+			CPU_SET(cpu, &cpus);
+			pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#elif defined(IB_WIN32)
+			SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu);
+#endif
+		}
+		LOG_INFO("IB reactor of client {} running, cpu {}", clientId_, cpu);
+
+		// client requests would otherwise be read only when the signal times out
+		// on a quiet feed; their thread posts them and post() wakes the reactor
+		std::thread clientRequests;
+		if (role_ != IBRole::MarketData) {
+			clientThread_ = true;
+			clientRequests = std::thread(&IBBrokerage::runClientRequests, this);
+		}
 
-		if (m_sleepDeadline > 0) {
-			// initialize timeout with m_sleepDeadline - now
-			tval.tv_sec = m_sleepDeadline - now;
+		std::function<void()> cmd;
+		while (!gShutdown) {
+			if (!isConnectedToBrokerage()) {
+				if (!connectToBrokerage()) {
+					std::this_thread::sleep_for(std::chrono::seconds(1));
+					continue;
+				}
+			}
+			if (!isConnectedToMarketDataFeed())
+				connectToMarketDataFeed();
+
+			while (commands_.try_pop(cmd))
+				cmd();
+
+			// a market data connection does not take orders and an order
+			// connection subscribes nothing
+			if (role_ != IBRole::MarketData && !stepBrokerage())
+				continue;
+			if (role_ != IBRole::Orders)
+				processMarketMessages();
+
+			// post() raises the same signal as the reader, a command never
+			// waits out the signal timeout
+			if (!m_pReader->hasMsgs() && commands_.empty())
+				m_osSignal->waitForSignal();
+			dispatchMessages();
 		}
-		m_osSignal.waitForSignal();
-		m_pReader->processMsgs();
+
+		if (clientRequests.joinable())
+			clientRequests.join();
+		disconnectFromMarketDataFeed();
+		disconnectFromBrokerage();
+		LOG_INFO("IB reactor of client {} stopped", clientId_);
+		MICRO_SERVICE_NUMBER--;
+	}
+
+	bool IBBrokerage::post(std::function<void()> cmd)
+	{
+		if (!commands_.try_push(std::move(cmd)))
+			return false;
+		m_osSignal->issueSignal();
+		return true;
+	}
+
+	// the base class reads and parses the requests and calls placeOrder() and
+	// the others, which post themselves from this thread
+	void IBBrokerage::runClientRequests()
+	{
+		onClientThread = true;
+		const auto idle = std::chrono::microseconds(std::max(CConfig::instance().ib_client_poll_us, 1));
+		while (!gShutdown) {
+			clientRequested_ = false;
+			if (readyToOrder_.load(std::memory_order_acquire))
+				monitorClientRequest();
+			// more may be queued behind a request, only an empty poll sleeps
+			if (!clientRequested_)
+				std::this_thread::sleep_for(idle);
+		}
+	}
+
+	bool IBBrokerage::forwardToReactor(std::function<void()> cmd)
+	{
+		if (!onClientThread)
+			return false;
+		clientRequested_ = true;
+		if (!post(std::move(cmd)))
+			LOG_ERROR("IB reactor command queue full, client request dropped");
+		return true;
 	}
 
 	bool IBBrokerage::connectToBrokerage() {
 		const char* host = CConfig::instance().ib_host.c_str();
 		auto port = CConfig::instance().ib_port;
-		int clientId = 0;
+		int clientId = clientId_;
 
 		LOG("Connecting to {}:{} clientId:{}.", host, port, clientId);
 		//! [connect]
@@ -108,9 +292,22 @@ namespace MarketRobot
 		if (bRes) {
 			LOG("Connected to ib brokerage {}:{} clientId:{}", host, port, clientId);
 			//! [ereader]
-			m_pReader = new ::EReader(m_pClient, &m_osSignal);
+			m_pReader = new ::EReader(m_pClient, m_osSignal.get());
+			m_pReader->setBusyPoll(CConfig::instance().ib_busy_poll, shardCpu(CConfig::instance().ib_reader_cpu));
+			m_pReader->setTrace(CConfig::instance().latency_trace);
+			for (int msgId : skippedMsgs_)
+				m_pReader->skipMsg(msgId);
+			if (!CConfig::instance().ib_capture_file.empty()
+				&& !m_pReader->startCapture(CConfig::instance().ib_capture_file.c_str()))
+				LOG_ERROR("Cannot open capture file {}", CConfig::instance().ib_capture_file);
 			m_pReader->start();
 			//! [ereader]
+			// encodings depend on the server version, redo them on every connection
+			orderContracts_.clear();
+			if (role_ != IBRole::MarketData) {
+				for (auto& sym : CConfig::instance().securities)
+					orderContract(sym);
+			}
 			bkstate_ = BK_CONNECTED;
 			//m_pClient->setServerLogLevel(5);			// can not work on m_pClient before a loop process
 			if (clientId == 0) {
@@ -128,15 +325,25 @@ namespace MarketRobot
 
 	void IBBrokerage::disconnectFromBrokerage() {
 		// CancelMarketData
-		int i = 0;
-		for (auto it = CConfig::instance().securities.begin(); it != CConfig::instance().securities.end(); ++it)
 		{
-			m_pClient->cancelMktData(i);
-			i++;
+			ESendBatch batch(*m_pClient);
+			for (int i : tickers_)
+			{
+				if (CConfig::instance().ib_tick_by_tick) {
+					m_pClient->cancelTickByTickData(TICKBYTICKLASTSTARTINGPOINT + i);
+					m_pClient->cancelTickByTickData(TICKBYTICKBIDASKSTARTINGPOINT + i);
+				}
+				else {
+					m_pClient->cancelMktData(i);
+				}
+			}
 		}
 
 		m_pClient->eDisconnect();
+		histDownloader_.reset();
+		reportOrderLatency();
 		bkstate_ = BK_DISCONNECTED;
+		readyToOrder_.store(false, std::memory_order_release);
 		LOG_INFO("TWS connection disconnected!");
 	}
 
@@ -150,10 +357,9 @@ namespace MarketRobot
 
 	void IBBrokerage::placeOrder(std::shared_ptr<MarketRobot::Order> o)
 	{
-		LOG_INFO("Place order, id = {}",(long)o->serverOrderId);
-
-		::Order oib;			// local stack
-		Contract contract;				// local stack
+		if (forwardToReactor([this, o] { placeOrder(o); }))
+			return;
+		uint64_t start = time::now_in_nano();
 
 		if (o->fullSymbol.empty())
 		{
@@ -173,15 +379,90 @@ namespace MarketRobot
 			return;
 		}
 
-		SecurityFullNameToContract(o->fullSymbol, contract);
-		OrderToIBOfficialOrder(o, oib);
+		const OrderContract* oc = orderContract(o->fullSymbol);
+		if (!oc) {
+			ERROR("Cannot encode contract {} of order {}", o->fullSymbol, (long)o->serverOrderId);
+			return;
+		}
 
 		lock_guard<mutex> g(orderStatus_mtx);
+		// only the fields that differ between the orders of a strategy are set here
+		::Order& oib = orderTemplate(*o);
+		oib.orderId = o->brokerOrderId;
+		oib.action = o->orderSize > 0 ? "BUY" : "SELL";         // SSHORT not supported here
+		oib.totalQuantity = std::abs(o->orderSize);
+		oib.lmtPrice = (double)o->limitPrice;
+		oib.auxPrice = o->trailPrice != 0 ? (double)o->trailPrice : (double)o->stopPrice;
+
 		o->api = "IB";
 		o->orderStatus = OrderStatus::OS_Submitted;
-		m_pClient->placeOrder(o->brokerOrderId, contract, oib);
+		m_pClient->placeOrder(o->brokerOrderId, oc->contract, oib, oc->encoded);
+		trackIBOrder(o, oc->sid);
 
+		uint64_t wire = time::now_in_nano();
+		orderToWire_.record(wire - start);
+		uint64_t tick = oc->ticker >= 0 ? lastTickTime(oc->ticker).load(std::memory_order_relaxed) : 0;
+		if (tick != 0)
+			tickToWire_.record(wire - tick);
+
+		LOG_INFO("Place order, id = {}",(long)o->serverOrderId);
 		sendOrderStatus(o->serverOrderId);
+
+		if (orderToWire_.count() % LATENCY_REPORT_ORDERS == 0)
+			reportOrderLatency();
+	}
+
+	const IBBrokerage::OrderContract* IBBrokerage::orderContract(const std::string& fullSymbol)
+	{
+		auto it = orderContracts_.find(fullSymbol);
+		if (it != orderContracts_.end())
+			return &it->second;
+
+		OrderContract oc;
+		SecurityFullNameToContract(fullSymbol, oc.contract);
+		if (!m_pClient->encodeOrderContract(oc.contract, oc.encoded))
+			return nullptr;
+		oc.sid = MR::DC::SymbolRegistry::instance().intern(fullSymbol);
+		// tickerIds are the positions of the symbols in the config
+		const vector<string>& securities = CConfig::instance().securities;
+		for (size_t i = 0; i < securities.size(); ++i) {
+			if (securities[i] == fullSymbol) {
+				oc.ticker = (int)i;
+				break;
+			}
+		}
+
+		return &orderContracts_.emplace(fullSymbol, std::move(oc)).first->second;
+	}
+
+	::Order& IBBrokerage::orderTemplate(const MarketRobot::Order& o)
+	{
+		// a handful of strategies, a scan beats hashing three strings
+		for (auto& t : orderTemplates_) {
+			if (t->orderType == o.orderType && t->timeInForce == o.timeInForce && t->account == o.account)
+				return t->order;
+		}
+
+		std::unique_ptr<OrderTemplate> t(new OrderTemplate);
+		t->account = o.account;
+		t->orderType = o.orderType;
+		t->timeInForce = o.timeInForce;
+		// Only MKT, LMT, STP, and STP LMT, TRAIL, TRAIL LIMIT are supported
+		t->order.orderType = o.orderType;
+		t->order.tif = o.timeInForce;
+		t->order.outsideRth = true;
+		t->order.transmit = true;
+		t->order.account = o.account.empty() ? CConfig::instance().account : o.account;
+		orderTemplates_.push_back(std::move(t));
+		return orderTemplates_.back()->order;
+	}
+
+	void IBBrokerage::reportOrderLatency()
+	{
+		if (orderToWire_.count() == 0)
+			return;
+		LOG_INFO("placeOrder to wire: {}", orderToWire_.summary());
+		LOG_INFO("tick to wire: {}", tickToWire_.summary());
 	}
 
 	void IBBrokerage::requestNextValidOrderID()
@@ -197,8 +478,10 @@ namespace MarketRobot
 	//1.from web/distance too long/tws cancel?
 	void IBBrokerage::cancelOrder(int oid)
 	{
+		if (forwardToReactor([this, oid] { cancelOrder(oid); }))
+			return;
 		INFO("Cancel Order {}",(long)oid);
-		auto o = OrderManager::instance().retrieveOrderFromServerOrderId(oid);
+		auto o = orderFromServerOrderId(oid);
 
 		if (o != nullptr) {
 			m_pClient->cancelOrder(o->brokerOrderId);
@@ -211,12 +494,22 @@ namespace MarketRobot
 	// cancel all orders for this symbol
 	void IBBrokerage::cancelOrders(const string& symbol)
 	{
-		auto v = OrderManager::instance().retrieveNonFilledOrderPtr(symbol);
+		if (forwardToReactor([this, symbol] { cancelOrders(symbol); }))
+			return;
+		ESendBatch batch(*m_pClient);
+		if (orderTableOverflow_) {
+			auto v = OrderManager::instance().retrieveNonFilledOrderPtr(symbol);
+			for (std::shared_ptr<MarketRobot::Order> o : v) {
+				m_pClient->cancelOrder(o->brokerOrderId);
+				INFO("Cancel Order {}",(long)o->serverOrderId);
+			}
+			return;
+		}
 
-		for (std::shared_ptr<MarketRobot::Order> o : v) {
+		orderTable_.forEachLive(MR::DC::SymbolRegistry::instance().id(symbol), [this](const IBOrderTable::OrderPtr& o) {
 			m_pClient->cancelOrder(o->brokerOrderId);
 			INFO("Cancel Order {}",(long)o->serverOrderId);
-		}
+		});
 	}
 
 	void IBBrokerage::cancelAllOrders() {}
@@ -230,6 +523,8 @@ namespace MarketRobot
 	}
 
 	void IBBrokerage::requestOpenOrders(const string& account_) {
+		if (forwardToReactor([this, account_] { requestOpenOrders(account_); }))
+			return;
 		LOG_INFO("Requesting open orders.");
 		m_pClient->reqAllOpenOrders();
 	}
@@ -256,13 +551,35 @@ namespace MarketRobot
 	}
 
 	void IBBrokerage::modifyOrder_SameT(uint64_t oid, double price, int quantity) {
-		auto po = OrderManager::instance().retrieveOrderFromServerOrderId(oid);
+		auto po = orderFromServerOrderId(oid);
 		po->orderSize = quantity;
 		po->limitPrice = price;
 
 		placeOrder(po);
 	}
 
+	void IBBrokerage::trackIBOrder(const std::shared_ptr<MarketRobot::Order>& o, uint32_t sid)
+	{
+		if (!orderTable_.add(o, sid) && !orderTableOverflow_) {
+			LOG_ERROR("Order table full at {} orders, looking orders up in OrderManager", orderTable_.size());
+			orderTableOverflow_ = true;
+		}
+	}
+
+	std::shared_ptr<MarketRobot::Order> IBBrokerage::orderFromBrokerOrderId(long oid)
+	{
+		if (const IBOrderTable::OrderPtr* o = orderTable_.byBrokerOrderId(oid))
+			return *o;
+		return OrderManager::instance().retrieveOrderFromBrokerOrderIdAndApi(oid, "IB");
+	}
+
+	std::shared_ptr<MarketRobot::Order> IBBrokerage::orderFromServerOrderId(long oid)
+	{
+		if (const IBOrderTable::OrderPtr* o = orderTable_.byServerOrderId(oid))
+			return *o;
+		return OrderManager::instance().retrieveOrderFromServerOrderId(oid);
+	}
+
 	/*void IBBrokerage::exerciseOptions(TickerId id, const Contract &contract,
 	int exerciseAction, int exerciseQuantity, const std::string &account,
 	int override) {}*/
@@ -273,7 +590,8 @@ namespace MarketRobot
 	//********************************************************************************************//
 	// Market data part
 	bool IBBrokerage::connectToMarketDataFeed() {
-		mkstate_ = MK_CONNECTED;
+		// a market data connection has no account to wait for
+		mkstate_ = role_ == IBRole::MarketData ? MK_REQCONTRACT : MK_CONNECTED;
 		return true;
 	}
 
@@ -307,12 +625,7 @@ namespace MarketRobot
 			//  requestHistData();
 			//  break;
 		case MK_REQREALTIMEDATA:
-			if (_mode == TICKBAR) {
-				subscribeMarketData();
-			}
-			else if (_mode == DEPTH) {
-				subscribeMarketDepth();
-			}
+			requestRealTimeData();
 			break;
 		case MK_REQREALTIMEDATAACK:
 			break;
@@ -322,6 +635,17 @@ namespace MarketRobot
 		}
 	}
 
+	void IBBrokerage::requestRealTimeData() {
+		if (_mode == TICKBAR) {
+			subscribeMarketData();
+		}
+		else if (_mode == DEPTH) {
+			subscribeMarketDepth();
+		}
+		if (CConfig::instance().ib_backfill_days > 0)
+			startBackfill();
+	}
+
 	void IBBrokerage::subscribeMarketData() {
 		LOG_INFO("Subscribing to market data.");
 		// 236 - shortable; 256 - inventory[error(x)]
@@ -330,17 +654,34 @@ namespace MarketRobot
 			"100,101,104,105,106,107,165,221,225,233,236,258,293,294,295,318,411";
 		TagValueListSPtr mktDataOptions;
 
-		int i = 0;
-		for (auto it = CConfig::instance().securities.begin(); it != CConfig::instance().securities.end(); ++it)
+		ESendBatch batch(*m_pClient);
+		const vector<string>& securities = CConfig::instance().securities;
+		tickerSids_.assign(securities.size(), MR::DC::SymbolRegistry::INVALID_ID);
+		// tickerIds stay the positions in the config on every connection, so
+		// the callbacks of all of them index the same tables
+		for (int i : tickers_)
 		{
+			tickerSids_[i] = MR::DC::SymbolRegistry::instance().intern(securities[i]);
 			Contract c;
-			SecurityFullNameToContract(*it, c);
+			SecurityFullNameToContract(securities[i], c);
+			{
+				std::lock_guard<std::mutex> cache(contractCacheMutex_);
+				if (const IBContractCache::Entry* e = contractCache_.find(securities[i]))
+					c.conId = e->conId;
+			}
 			LOG_INFO("subscribe to {}({})",c.localSymbol, c.conId);
-			//m_pClient->reqMktData(i, c, gt, false, mktDataOptions); // v976 changed
-			m_pClient->reqMktData(i, c, "", false, false,mktDataOptions);
-			// whatToShow=TRADES useRTH=false
-			m_pClient->reqRealTimeBars(BARREQUESTSTARTINGPOINT + i, c, 5, "TRADES", false, mktDataOptions);
-			i++;
+			if (CConfig::instance().ib_tick_by_tick) {
+				// every print and quote change with its exchange time; bars are
+				// built from the prints, so no 5s bars on top of them
+				m_pClient->reqTickByTickData(TICKBYTICKLASTSTARTINGPOINT + i, c, "AllLast", 0, false);
+				m_pClient->reqTickByTickData(TICKBYTICKBIDASKSTARTINGPOINT + i, c, "BidAsk", 0, false);
+			}
+			else {
+				//m_pClient->reqMktData(i, c, gt, false, mktDataOptions); // v976 changed
+				m_pClient->reqMktData(i, c, "", false, false,mktDataOptions);
+				// whatToShow=TRADES useRTH=false
+				m_pClient->reqRealTimeBars(BARREQUESTSTARTINGPOINT + i, c, 5, "TRADES", false, mktDataOptions);
+			}
 		}
 
 		mkstate_ = MK_REQREALTIMEDATAACK;
@@ -362,18 +703,21 @@ namespace MarketRobot
 		static const int IBLIMITMKDEPTHNUM = 3;
 		TagValueListSPtr mktDataOptions;
 
-		int i = 0;
-		for (auto it = CConfig::instance().securities.begin(); it != CConfig::instance().securities.end(); ++it) {
+		ESendBatch batch(*m_pClient);
+		const vector<string>& securities = CConfig::instance().securities;
+		tickerSids_.assign(securities.size(), MR::DC::SymbolRegistry::INVALID_ID);
+		// the limit is per account: the first securities of the config, on whichever connection has them
+		for (int i : tickers_) {
+			if (i >= IBLIMITMKDEPTHNUM)
+				continue;
+
 			Contract c;
-			SecurityFullNameToContract(*it, c);
-			c.exchange = "ISLAND";
+			SecurityFullNameToContract(securities[i], c);
+			tickerSids_[i] = MR::DC::SymbolRegistry::instance().intern(securities[i]);
 
 			LOG_INFO("Market depth subscribed to contract {}, {}.",c.symbol, c.exchange);
 			//m_pClient->reqMktDepth(i + 2000, c, 10, mktDataOptions); v976 changed
-			m_pClient->reqMktDepth(i + 2000, c, 10, false, mktDataOptions);
-
-			if (i >= IBLIMITMKDEPTHNUM)
-				break;
+			m_pClient->reqMktDepth(DEPTHREQUESTSTARTINGPOINT + i, c, MR::DC::BOOK_DEPTH, false, mktDataOptions);
 		}
 		mkstate_ = MK_REQREALTIMEDATAACK;
 	}
@@ -386,6 +730,8 @@ namespace MarketRobot
 
 	void IBBrokerage::subscribeRealTimeBars(TickerId id, const Security& security, int barSize, const string& whatToShow, bool useRTH) {}
 	void IBBrokerage::unsubscribeRealTimeBars(TickerId tickerId) {}
+	// With the details of every security cached, market data is subscribed
+	// right away and the requests below only refresh the cache.
 	void IBBrokerage::requestContractDetails()
 	{
 		LOG_INFO("Requesting contract details.");
@@ -394,13 +740,21 @@ namespace MarketRobot
 		//SecurityFullNameToContract("SPY_STK_SMART_USD", c);
 		//m_pClient->reqContractDetails(4000, c);
 
-		int i = 1;
-		for (auto it = CConfig::instance().securities.begin(); it != CConfig::instance().securities.end(); ++it)
+		bool cached = loadContractCache();
+		if (cached) {
+			LOG_INFO("Contract details of {} securities from cache, subscribing market data.", tickers_.size());
+			mkstate_ = MK_REQREALTIMEDATA;
+			requestRealTimeData();
+		}
+
+		ESendBatch batch(*m_pClient);
+		contractDetailsPending_ = 0;
+		for (int i : tickers_)
 		{
 			Contract c;
-			SecurityFullNameToContract(*it, c);
-			m_pClient->reqContractDetails(4000 + i, c);
-			i++;
+			SecurityFullNameToContract(CConfig::instance().securities[i], c);
+			m_pClient->reqContractDetails(CONTRACTREQUESTSTARTINGPOINT + i + 1, c);
+			contractDetailsPending_++;
 		}
 
 		if (mkstate_ < MK_REQCONTRACT_ACK) {
@@ -408,74 +762,73 @@ namespace MarketRobot
 		}
 	}
 
+	// true when the cache holds every security of the connection; what it holds goes
+	// to DataManager and the clients as if TWS had sent it
+	bool IBBrokerage::loadContractCache()
+	{
+		int hours = CConfig::instance().ib_contract_cache_hours;
+		if (hours <= 0)
+			return false;
+
+		std::lock_guard<std::mutex> cache(contractCacheMutex_);
+		contractCache_.load(contractCachePath(), (time_t)hours * 3600, ::time(nullptr));
+
+		bool complete = true;
+		for (int i : tickers_) {
+			const IBContractCache::Entry* e = contractCache_.find(CConfig::instance().securities[i]);
+			if (!e) {
+				complete = false;
+				continue;
+			}
+
+			std::unique_lock<std::mutex> details(securityDetailsMutex);
+			if (DataManager::instance().securityDetails_.find(e->detailsSymbol) == DataManager::instance().securityDetails_.end()) {
+				Security s;
+				s.symbol = e->localSymbol;
+				s.exchange = e->exchange;
+				s.securityType = e->secType;
+				s.multiplier = e->multiplier;
+				s.localName = e->longName;
+				s.ticksize = std::to_string(e->minTick);
+
+				DataManager::instance().securityDetails_[e->detailsSymbol] = s;
+			}
+			details.unlock();
+			sendContractMessage(e->detailsSymbol, e->longName, std::to_string(e->minTick));
+		}
+		return complete;
+	}
+
 	// enddate in "yyyyMMdd HH:mm:ss"
 	// duration in seconds
 	// barsize in seconds
 	// useRTH = "0" or "1"
-	std::vector<string> histreqeuests_;				// store symbol
+	// bars are sent with their time in seconds since epoch
 	void IBBrokerage::requestHistoricalData(string fullsymbol, string enddate, string duration, string barsize, string useRTH) {
-		int date_format = 1;	// 1: yyyymmdd{space}{space}hh:mm:dd  // 2 long integer specifying the number of seconds since 1/1/1970 GM	
 		::Contract contract;
 		SecurityFullNameToContract(fullsymbol, contract);
 
-		if (fullsymbol.find("STK") != string::npos)
-			contract.includeExpired = false;
-		else
-			contract.includeExpired = true;
-
-		int useRegularTradingHour = useRTH == "1" ? 1 : 0;
+		histDownloader_.request(fullsymbol, contract, enddate, std::stoi(duration), std::stoi(barsize), useRTH == "1",
+			[this](const string& symbol, const ::Bar& bar) {
+				sendHistoricalBarMessage(symbol, bar.time, bar.open, bar.high, bar.low, bar.close, (int)bar.volume, bar.count, bar.wap);
+			});
+	}
 
-		int interval = std::stoi(barsize);
-		string barSize_;
-		switch (interval)
-		{
-		case 1:
-			barSize_ = "1 secs";		// not 1 sec
-			break;
-		case 5:
-			barSize_ = "5 secs";
-			break;
-		case 15:
-			barSize_ = "15 secs";
-			break;
-		case 30:
-			barSize_ = "30 secs";
-			break;
-		case 60:
-			barSize_ = "1 min";
-			break;
-		case 120:
-			barSize_ = "2 mins";
-			break;
-		case 180:
-			barSize_ = "3 mins";
-			break;
-		case 300:
-			barSize_ = "5 mins";
-			break;
-		case 900:
-			barSize_ = "15 mins";
-			break;
-		case 1800:
-			barSize_ = "30 mins";
-			break;
-		case 3600:
-			barSize_ = "1 hour";
-			break;
-		case 86400:
-			barSize_ = "1 day";
-			break;
-		default:
-			barSize_ = "1 secs";
-			break;
+	// ib_backfill_days of bars for every security into data_dir/hist/<symbol>_<barsize>s,
+	// resuming behind what is there from an earlier run
+	void IBBrokerage::startBackfill() {
+		int barSize = CConfig::instance().ib_backfill_bar_size;
+		time_t end = ::time(nullptr);
+		end -= end % barSize;
+		time_t start = end - (time_t)CConfig::instance().ib_backfill_days * 86400;
+
+		for (int i : tickers_) {
+			const string& s = CConfig::instance().securities[i];
+			::Contract contract;
+			SecurityFullNameToContract(s, contract);
+			string dir = CConfig::instance().dataDir() + "/hist/" + s + "_" + to_string(barSize) + "s";
+			histDownloader_.backfill(s, contract, barSize, false, start, end, dir);
 		}
-
-		string durationString_ = duration + " S";			// currently only consider intraday bar, so duration <= 1day
-		histreqeuests_.push_back(fullsymbol);
-		::TagValueListSPtr charOptions_;
-		m_pClient->reqHistoricalData(6000 + histreqeuests_.size() - 1, contract, enddate, durationString_, barSize_,
-			"TRADES", useRegularTradingHour, date_format, false, charOptions_);
-
 	}
 
 	// See requestBrokerageAccountInformation()
@@ -514,26 +867,30 @@ namespace MarketRobot
 	}
 
 	void IBBrokerage::tickSize(TickerId tickerId, TickType field, int size) {
-		Tick k;
-		k.fullsymbol_ = CConfig::instance().securities[tickerId];
-		k.size_ = size;
-		k.time_ = hmsf();
-		k.data_time_ = time::now_in_nano();
+		if (tickerId < 0 || (size_t)tickerId >= tickerSids_.size() || tickerSids_[tickerId] == MR::DC::SymbolRegistry::INVALID_ID)
+			return;
 
+		MR::DC::BinaryTick k;
+		k.recv_time_ = tickRecvTime();
+		k.exchange_time_ = 0;			// tickSize carries no exchange time
+		k.size_ = size;
+		k.sid_ = tickerSids_[tickerId];
+		k.reserved_ = 0;
+		lastTickTime(tickerId).store(k.recv_time_, std::memory_order_relaxed);
 
 		if (field == TickType::LAST_SIZE)
 		{
-			k.datatype_ = DataType::DT_Trade;
+			k.datatype_ = (int32_t)DataType::DT_Trade;
 			k.price_ = lastPriceCache_[tickerId];
 		}
 		else if (field == TickType::BID_SIZE)
 		{
-			k.datatype_ = DataType::DT_Bid;
+			k.datatype_ = (int32_t)DataType::DT_Bid;
 			k.price_ = bidPriceCache_[tickerId];
 		}
 		else if (field == TickType::ASK_SIZE)
 		{
-			k.datatype_ = DataType::DT_Ask;
+			k.datatype_ = (int32_t)DataType::DT_Ask;
 			k.price_ = askPriceCache_[tickerId];
 		}
 		else
@@ -541,8 +898,93 @@ namespace MarketRobot
 			return;
 		}
 
-		msgq_pub_->sendmsg(k.serialize());
+		publishTick(k);
+	}
+
+	// AllLast: every trade print, also the ones reqMktData conflates away
+	void IBBrokerage::tickByTickAllLast(int reqId, int tickType, time_t time, double price, int size,
+		const TickAttribLast& tickAttribLast, const std::string& exchange, const std::string& specialConditions) {
+		size_t index = reqId - TICKBYTICKLASTSTARTINGPOINT;
+		if (reqId < TICKBYTICKLASTSTARTINGPOINT || index >= tickerSids_.size() || tickerSids_[index] == MR::DC::SymbolRegistry::INVALID_ID)
+			return;
+
+		MR::DC::BinaryTick k;
+		k.recv_time_ = tickRecvTime();
+		k.exchange_time_ = (uint64_t)time * time_unit::NANOSECONDS_PER_SECOND;
+		k.price_ = price;
+		k.size_ = size;
+		k.sid_ = tickerSids_[index];
+		k.datatype_ = (int32_t)DataType::DT_Trade;
+		k.reserved_ = 0;
+		lastPriceCache_[index] = price;
+		lastTickTime(index).store(k.recv_time_, std::memory_order_relaxed);
 
+		publishTick(k);
+	}
+
+	void IBBrokerage::tickByTickBidAsk(int reqId, time_t time, double bidPrice, double askPrice, int bidSize, int askSize,
+		const TickAttribBidAsk& tickAttribBidAsk) {
+		size_t index = reqId - TICKBYTICKBIDASKSTARTINGPOINT;
+		if (reqId < TICKBYTICKBIDASKSTARTINGPOINT || index >= tickerSids_.size() || tickerSids_[index] == MR::DC::SymbolRegistry::INVALID_ID)
+			return;
+
+		MR::DC::BinaryTick k;
+		k.recv_time_ = tickRecvTime();
+		k.exchange_time_ = (uint64_t)time * time_unit::NANOSECONDS_PER_SECOND;
+		k.sid_ = tickerSids_[index];
+		k.reserved_ = 0;
+		lastTickTime(index).store(k.recv_time_, std::memory_order_relaxed);
+		bidPriceCache_[index] = bidPrice;
+		askPriceCache_[index] = askPrice;
+
+		k.datatype_ = (int32_t)DataType::DT_Bid;
+		k.price_ = bidPrice;
+		k.size_ = bidSize;
+		publishTick(k);
+
+		k.datatype_ = (int32_t)DataType::DT_Ask;
+		k.price_ = askPrice;
+		k.size_ = askSize;
+		publishTick(k);
+	}
+
+	void IBBrokerage::publishTick(const MR::DC::BinaryTick& k) {
+		if (CConfig::instance().binary_tick) {
+			MR::DC::serializeBinaryTick(k, CConfig::instance().binary_tick_msg, tickMsg_);
+			publisher_->msgq_pub_->sendmsg(tickMsg_);
+			// the msgq consumer that feeds the DataCenter reads text only, it
+			// takes the struct from here
+			MR::DC::DataCenter::instance().onTick(k);
+		}
+		else {
+			Tick t;
+			t.fullsymbol_ = MR::DC::SymbolRegistry::instance().symbol(k.sid_);
+			t.size_ = k.size_;
+			t.time_ = hmsf();
+			t.data_time_ = k.recv_time_;
+			t.datatype_ = k.datatype();
+			t.price_ = k.price_;
+			publisher_->msgq_pub_->sendmsg(t.serialize());
+		}
+
+		if (CConfig::instance().latency_trace)
+			MR::Component::LatencyTrace::record(MR::Component::TraceStage::Publish, time::now_in_nano() - k.recv_time_);
+	}
+
+	// the time the frame being dispatched came off the socket, on the clock of
+	// time::now_in_nano(); the reader stamps it on its own steady clock
+	uint64_t IBBrokerage::tickRecvTime() {
+		uint64_t now = time::now_in_nano();
+		uint64_t recv = m_pReader->frameRecvTime();
+		if (recv == 0)
+			return now;
+
+		uint64_t age = ::ECaptureWriter::now() - recv;
+		if (CConfig::instance().latency_trace) {
+			MR::Component::LatencyTrace::record(MR::Component::TraceStage::Dequeue, m_pReader->frameDequeueTime() - recv);
+			MR::Component::LatencyTrace::record(MR::Component::TraceStage::Dispatch, age);
+		}
+		return now - age;
 	}
 
 	///https://www.interactivebrokers.com/en/software/api/apiguide/java/orderstatus.htm
@@ -554,16 +996,21 @@ namespace MarketRobot
 		LOG_INFO("Order status, oid = {}.", orderId);
 
 		if (status == "Cancelled") {
-			std::shared_ptr<MarketRobot::Order> o = OrderManager::instance().retrieveOrderFromBrokerOrderIdAndApi(orderId, "IB");
+			std::shared_ptr<MarketRobot::Order> o = orderFromBrokerOrderId(orderId);
 
 			if (o != nullptr) {
+				orderTable_.remove(orderId);
 				OrderManager::instance().gotCancel(o->serverOrderId);
 				sendOrderStatus(o->serverOrderId);
 			}
 			else {
-				INFO("canceled order not found, oid = {}", o->serverOrderId);
+				INFO("canceled order not found, oid = {}", orderId);
 			}
 		}
+		else if (status == "Filled" && remaining == 0) {
+			// execDetails of the last fill may still come, it finds the order in OrderManager
+			orderTable_.remove(orderId);
+		}
 	}
 
 	void IBBrokerage::openOrder(OrderId oid, const Contract& contract,
@@ -587,7 +1034,7 @@ namespace MarketRobot
 		}
 		else
 		{
-			std::shared_ptr<MarketRobot::Order> o = OrderManager::instance().retrieveOrderFromBrokerOrderIdAndApi(oid, "IB");
+			std::shared_ptr<MarketRobot::Order> o = orderFromBrokerOrderId(oid);
 
 			// not found, or found but permId not equal (given permId not default -1) --> existing open order
 			if ((o == nullptr) || ((o->permId != order.permId) && (o->permId != -1))) {
@@ -624,6 +1071,7 @@ namespace MarketRobot
 					m_brokerOrderId = oid + 1;
 
 				OrderManager::instance().trackOrder(o2);
+				trackIBOrder(o2, MR::DC::SymbolRegistry::instance().intern(fullSymbol));
 				sendOrderStatus(o2->serverOrderId);
 			}
 			else {
@@ -632,6 +1080,8 @@ namespace MarketRobot
 				}
 
 				OrderManager::instance().gotOrder(o->serverOrderId);
+				if (!orderTable_.byBrokerOrderId(oid))
+					trackIBOrder(o, MR::DC::SymbolRegistry::instance().intern(o->fullSymbol));
 				sendOrderStatus(o->serverOrderId);			// acknowledged
 			}
 		}
@@ -707,6 +1157,7 @@ namespace MarketRobot
 		string symbol;		// full symbol
 		ContractToSecurityFullName(symbol, contractDetails.contract);
 
+		std::unique_lock<std::mutex> details(securityDetailsMutex);
 		auto it = DataManager::instance().securityDetails_.find(symbol);
 		if (it == DataManager::instance().securityDetails_.end()) {
 			Security s;
@@ -719,13 +1170,39 @@ namespace MarketRobot
 
 			DataManager::instance().securityDetails_[symbol] = s;
 		}
+		details.unlock();
 
 		sendContractMessage(symbol, contractDetails.longName, std::to_string(contractDetails.minTick));
+
+		size_t index = reqId - CONTRACTREQUESTSTARTINGPOINT - 1;
+		if (reqId > CONTRACTREQUESTSTARTINGPOINT && index < CConfig::instance().securities.size()) {
+			IBContractCache::Entry e;
+			e.fullSymbol = CConfig::instance().securities[index];
+			e.conId = contractDetails.contract.conId;
+			e.updated = ::time(nullptr);
+			e.detailsSymbol = symbol;
+			e.localSymbol = contractDetails.contract.localSymbol;
+			e.exchange = contractDetails.contract.exchange;
+			e.secType = contractDetails.contract.secType;
+			e.multiplier = contractDetails.contract.multiplier;
+			e.lastTradeDate = contractDetails.contract.lastTradeDateOrContractMonth;
+			e.longName = contractDetails.longName;
+			e.minTick = contractDetails.minTick;
+			std::lock_guard<std::mutex> cache(contractCacheMutex_);
+			contractCache_.update(e);
+		}
 	}
 
 	void IBBrokerage::contractDetailsEnd(int reqId)
 	{
 		LOG_INFO("Contract details end. reqid={}", reqId);
+
+		if (contractDetailsPending_ > 0 && --contractDetailsPending_ == 0 && CConfig::instance().ib_contract_cache_hours > 0) {
+			string path = contractCachePath();
+			std::lock_guard<std::mutex> cache(contractCacheMutex_);
+			if (!contractCache_.save(path))
+				LOG_ERROR("Cannot write contract details cache {}", path);
+		}
 	}
 
 	void IBBrokerage::execDetails(int reqId, const Contract& contract, const Execution& execution)
@@ -740,7 +1217,7 @@ namespace MarketRobot
 		t.tradePrice = execution.price;
 		t.tradeSize = (execution.side == "BOT" ? 1 : -1)*execution.shares;
 
-		auto o = OrderManager::instance().retrieveOrderFromBrokerOrderIdAndApi(execution.orderId, "IB");
+		auto o = orderFromBrokerOrderId(execution.orderId);
 
 		if (o != nullptr) {
 			t.serverOrderId = o->serverOrderId;
@@ -769,6 +1246,10 @@ namespace MarketRobot
 	void IBBrokerage::error(const int id, const int errorCode, const std::string errorString) {
 		LOG_ERROR("id={},eCode={},msg:{}.", id, errorCode, errorString);
 		sendGeneralMessage(to_string(id) + SERIALIZATION_SEPARATOR + to_string(errorCode) + SERIALIZATION_SEPARATOR + errorString);
+		histDownloader_.error(id, errorCode, errorString);
+		// a security TWS cannot resolve gets no contractDetailsEnd
+		if (id > CONTRACTREQUESTSTARTINGPOINT && id <= CONTRACTREQUESTSTARTINGPOINT + (int)CConfig::instance().securities.size())
+			contractDetailsEnd(id);
 
 		/*if (errorCode == 202)			// order cancelled, moved to order status callback
 		{
@@ -791,19 +1272,17 @@ namespace MarketRobot
 
 	// postion = depth
 	void IBBrokerage::updateMktDepth(TickerId id, int position, int operation, int side, double price, int size) {
-		const char* sidestr = (side == 1) ? "BID_PRICE" : "ASK_PRICE";	 // side 0 for ask, 1 for bid
-		INFO("Update market depth: {} {} {} {} {:.3f} {%d}",
-			CConfig::instance().securities[id - 1000], operation, sidestr, position, price, size);
+		size_t index = id - DEPTHREQUESTSTARTINGPOINT;
+		if (id < DEPTHREQUESTSTARTINGPOINT || index >= tickerSids_.size())
+			return;
+		// side 0 for ask, 1 for bid; operation 0 insert, 1 update, 2 delete
+		MR::DC::DataCenter::instance().onMarketDepth(tickerSids_[index], position, operation, side, price, size);
 	}
 
-	// postion = depth
+	// postion = depth; rows of all market makers form one book
 	void IBBrokerage::updateMktDepthL2(TickerId id, int position, std::string marketMaker, int operation,
 		int side, double price, int size) {
-		LOG_INFO("Update market depth L2.");
-		const char* sidestr = (side == 1) ? "BID_PRICE" : "ASK_PRICE";	 // side 0 for ask, 1 for bid
-		cout << CConfig::instance().securities[id - 1000] << " " \
-			<< operation << " " << sidestr << " " \
-			<< position << " " << price << " " << size << "\n";
+		updateMktDepth(id, position, operation, side, price, size);
 	}
 
 	// triggered by EClientSocket::reqManagedAccts
@@ -820,16 +1299,12 @@ namespace MarketRobot
 		}
 	}
 
-	// Intra-day bar sizes are relayed back in Local Time Zone, daily bar sizes and greater are relayed back in Exchange Time Zone.
-	void IBBrokerage::historicalData(TickerId reqId, const std::string& date, double open, double high,
-		double low, double close, int volume, int barCount, double WAP, int hasGaps) {
-		try {
-			string symbol = histreqeuests_[reqId];
-			sendHistoricalBarMessage(symbol, date, open, high, low, close, volume, barCount, WAP);
-		}
-		catch (...) {
-			sendGeneralMessage("Historical Data Error");
-		}
+	void IBBrokerage::historicalData(TickerId reqId, const ::Bar& bar) {
+		histDownloader_.historicalData((int)reqId, bar);
+	}
+
+	void IBBrokerage::historicalDataEnd(int reqId, const std::string& startDateStr, const std::string& endDateStr) {
+		histDownloader_.historicalDataEnd(reqId);
 	}
 
 	void IBBrokerage::realtimeBar(TickerId reqId, long time, double open, double high, double low, double close,
@@ -897,26 +1372,6 @@ namespace MarketRobot
 		symbol = sym;
 	}
 
-	void IBBrokerage::OrderToIBOfficialOrder(std::shared_ptr<MarketRobot::Order> o, ::Order& oib)
-	{
-		oib.auxPrice = o->trailPrice != 0 ? (double)o->trailPrice : (double)o->stopPrice;
-		oib.lmtPrice = (double)o->limitPrice;
-
-		// Only MKT, LMT, STP, and STP LMT, TRAIL, TRAIL LIMIT are supported
-		oib.orderType = o->orderType;
-
-		oib.totalQuantity = std::abs(o->orderSize);
-		oib.action = o->orderSize > 0 ? "BUY" : "SELL";         // SSHORT not supported here
-
-		oib.tif = o->timeInForce;
-		oib.outsideRth = true;
-		//order.OrderId = (int)o.id;
-		oib.transmit = true;
-
-		oib.account = o->account.empty() ? CConfig::instance().account : o->account;
-		// Set up IB order Id
-		oib.orderId = o->brokerOrderId;
-	}
 	// end of auxilliary functions
 	//********************************************************************************************//
 }
\ No newline at end of file
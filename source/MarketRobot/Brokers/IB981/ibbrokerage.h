@@ -2,6 +2,8 @@
 #define _MarketRobot_Brokers_IBBrokerage_H_
 #include "Brokers/IB981/client/EWrapper.h"
 #include "Brokers/IB981/client/EReaderOSSignal.h"
+#include "Brokers/IB981/client/EReaderEventSignal.h"
+#include "Brokers/IB981/client/EReaderFutexSignal.h"
 #include "Brokers/IB981/client/EClientSocket.h"
 #include "Brokers/IB981/client/EReader.h"
 #include "Brokers/IB981/client/Contract.h"
@@ -9,13 +11,22 @@
 #include "Brokers/IB981/client/Execution.h"
 #include "Brokers/IB981/client/OrderState.h"
 #include "Brokers/IB981/client/DefaultEWrapper.h"
+#include "Brokers/IB981/ibhistorical.h"
+#include "Brokers/IB981/ibcontractcache.h"
+#include "Brokers/IB981/ibordertable.h"
 
 #include "Common/config.h"
 #include "Common/Brokerage/brokerage.h"
 #include "Common/Data/marketdatafeed.h"
+#include "DataCenter/binarytick.h"
+#include "Components/latencyhistogram.h"
+#include "Components/mpscqueue.h"
+#include <atomic>
+#include <functional>
 #include <mutex>
 #include <string>
 #include <memory>
+#include <unordered_map>
 #include <time.h>
 
 using std::mutex;
@@ -32,13 +43,29 @@ namespace MarketRobot
 	class MarketRobot::brokerage;
 	class MarketRobot::marketdatafeed;
 
+	// what a TWS connection carries: with ib_md_connections = 0 one connection
+	// carries both, otherwise one carries the orders and the securities are
+	// split over ib_md_connections market data ones, each with its own client id
+	enum class IBRole { All, Orders, MarketData };
+
 	class IBBrokerage : public DefaultEWrapper, public MarketRobot::brokerage, public MarketRobot::marketdatafeed
 	{
 	public:
 		IBBrokerage();
+		// tickers are the positions in CConfig::securities a MarketData connection
+		// subscribes; its ticks go out on the market data msgq of publisher
+		IBBrokerage(IBRole role, int clientId, int shard = -1, std::vector<int> tickers = {}, IBBrokerage* publisher = nullptr);
 		~IBBrokerage();
 		int _nServerVersion;
 
+		// reactor mode: the calling thread owns the TWS connection, every
+		// EWrapper callback and both state machines until shutdown; other
+		// threads hand it work through post() instead of calling in, client
+		// requests too. A MarketData connection always runs this way.
+		void runReactor();
+		// false when the command queue is full
+		bool post(std::function<void()> cmd);
+
 	public: 
 		// outgoing
 		//********************************************************************************//
@@ -157,8 +184,8 @@ namespace MarketRobot
 		//void updateNewsBulletin(int msgId, int msgType, const std::string& newsMessage, const std::string& originExch) {}
 		void managedAccounts(const std::string& accountsList);
 		//void receiveFA(faDataType pFaDataType, const std::string& cxml) {}
-		void historicalData(TickerId reqId, const std::string& date, double open, double high,
-			double low, double close, int volume, int barCount, double WAP, int hasGaps);
+		void historicalData(TickerId reqId, const ::Bar& bar);
+		void historicalDataEnd(int reqId, const std::string& startDateStr, const std::string& endDateStr);
 		//void scannerParameters(const std::string &xml) {}
 		//void scannerData(int reqId, int rank, const ContractDetails &contractDetails,
 		//	const std::string &distance, const std::string &benchmark, const std::string &projection,
@@ -213,16 +240,26 @@ namespace MarketRobot
 		//void historicalTicks(int reqId, const std::vector<HistoricalTick>& ticks, bool done) {};
 		//void historicalTicksBidAsk(int reqId, const std::vector<HistoricalTickBidAsk>& ticks, bool done) {};
 		//void historicalTicksLast(int reqId, const std::vector<HistoricalTickLast>& ticks, bool done) {};
-		//void tickByTickAllLast(int reqId, int tickType, time_t time, double price, int size, const TickAttribLast& tickAttribLast, const std::string& exchange, const std::string& specialConditions) {};
-		//void tickByTickBidAsk(int reqId, time_t time, double bidPrice, double askPrice, int bidSize, int askSize, const TickAttribBidAsk& tickAttribBidAsk) {};
+		void tickByTickAllLast(int reqId, int tickType, time_t time, double price, int size, const TickAttribLast& tickAttribLast, const std::string& exchange, const std::string& specialConditions);
+		void tickByTickBidAsk(int reqId, time_t time, double bidPrice, double askPrice, int bidSize, int askSize, const TickAttribBidAsk& tickAttribBidAsk);
 		//void tickByTickMidPoint(int reqId, time_t time, double midPoint) {};
 		//void orderBound(long long orderId, int apiClientId, int apiOrderId) {};
 		//void completedOrder(const Contract& contract, const Order& order, const OrderState& orderState) {};
 		//void completedOrdersEnd() {};
 
 	private:
+		const IBRole role_;
+		const int clientId_;
+		const int shard_;					// position among the market data connections, -1 for the others
+		std::vector<int> tickers_;			// positions in CConfig::securities subscribed on this connection
+		IBBrokerage* const publisher_;		// owner of the msgq the ticks are published on
+		int shardCpu(int cpu) const;		// the configured cpu, shifted for a market data connection
+		string contractCachePath() const;
+
 		//! [socket_declare]
-		::EReaderOSSignal m_osSignal;
+		// picked by ib_wait_strategy: futex with a spin phase, eventfd, or the
+		// mutex/condvar one where neither is built
+		std::unique_ptr<::EReaderSignal> m_osSignal;
 		::EClientSocket* const m_pClient;	// std::auto_ptr<EPosixClientSocket> m_pClient; or unique_ptr
 		//! [socket_declare]
 		time_t m_sleepDeadline;
@@ -231,14 +268,84 @@ namespace MarketRobot
 		std::vector<double> lastPriceCache_;
 		std::vector<double> bidPriceCache_;
 		std::vector<double> askPriceCache_;
+		std::vector<uint32_t> tickerSids_;		// SymbolRegistry id of every market data tickerId
+		// receive time of the last tick of every market data tickerId, held by the
+		// publisher: the market data connections stamp it, the order one reads it
+		std::unique_ptr<std::atomic<uint64_t>[]> lastTickTime_;
+		std::atomic<uint64_t>& lastTickTime(size_t ticker) { return publisher_->lastTickTime_[ticker]; }
+		std::string tickMsg_;					// reused for binary tick messages
+
+		MR::Component::MpscQueue<std::function<void()>> commands_;	// posted to the reactor
+		// reactor mode reads client requests on a thread of their own: it polls
+		// the brokerage msgq and what a request does on the connection is posted
+		bool clientThread_ = false;
+		std::atomic<bool> readyToOrder_{ false };	// bkstate_ is BK_READYTOORDER, for the client request thread
+		bool clientRequested_ = false;		// client request thread: the last poll found a request
+		void runClientRequests();
+		bool forwardToReactor(std::function<void()> cmd);	// true on the client request thread, cmd is posted
+		bool stepBrokerage();				// heartbeat and brokerage state machine, false when disconnected
+		void dispatchMessages();			// decode a batch of frames, then pace historical requests
 
 		const int BARREQUESTSTARTINGPOINT = 1000;			// reqRealTimeBars request id starting point
+		const int DEPTHREQUESTSTARTINGPOINT = 2000;			// reqMktDepth request id starting point
+		const int TICKBYTICKLASTSTARTINGPOINT = 3000;		// reqTickByTickData AllLast request id starting point
+		const int CONTRACTREQUESTSTARTINGPOINT = 4000;		// reqContractDetails request id starting point
+		const int TICKBYTICKBIDASKSTARTINGPOINT = 5000;		// reqTickByTickData BidAsk request id starting point
+		const int HISTREQUESTSTARTINGPOINT = 6000;			// reqHistoricalData request id starting point
+
+		// contract of every traded symbol with its placeOrder fields encoded for
+		// the connected server, so an order only formats its own fields
+		struct OrderContract {
+			Contract contract;
+			std::string encoded;
+			int ticker = -1;				// market data tickerId of the symbol, -1 if not subscribed
+			uint32_t sid;					// SymbolRegistry id of the symbol
+		};
+		std::unordered_map<std::string, OrderContract> orderContracts_;
+		const OrderContract* orderContract(const std::string& fullSymbol);
+
+		// ::Order with every field but side, quantity, prices and order id filled
+		// in, one per account, order type and time in force a strategy trades
+		struct OrderTemplate {
+			std::string account;			// as the order gives it, empty for the default account
+			std::string orderType;
+			std::string timeInForce;
+			::Order order;
+		};
+		std::vector<std::unique_ptr<OrderTemplate>> orderTemplates_;
+		::Order& orderTemplate(const MarketRobot::Order& o);
+
+		// tick of the symbol received -> order written to the socket
+		MR::Component::LatencyHistogram tickToWire_;
+		// placeOrder called -> order written to the socket
+		MR::Component::LatencyHistogram orderToWire_;
+		static const uint64_t LATENCY_REPORT_ORDERS = 1000;
+		void reportOrderLatency();
+
+		IBHistoricalDownloader histDownloader_;
+		void startBackfill();
+
+		// orders of this connection; lookups it misses go to OrderManager
+		IBOrderTable orderTable_;
+		bool orderTableOverflow_ = false;		// an order did not fit, the table is not complete
+		void trackIBOrder(const std::shared_ptr<MarketRobot::Order>& o, uint32_t sid);
+		std::shared_ptr<MarketRobot::Order> orderFromBrokerOrderId(long oid);
+		std::shared_ptr<MarketRobot::Order> orderFromServerOrderId(long oid);
+
+		// contractDetails() updates it while the market data thread subscribes from it
+		IBContractCache contractCache_;
+		std::mutex contractCacheMutex_;
+		int contractDetailsPending_ = 0;	// reqContractDetails not ended yet
+		bool loadContractCache();
+		void requestRealTimeData();
+
 		// ***********************************************************************************************
 		// auxiliary functions
 		// ***********************************************************************************************
 		void SecurityFullNameToContract(const std::string& symbol, Contract& c);
 		void ContractToSecurityFullName(std::string& symbol, const Contract& c);
-		void OrderToIBOfficialOrder(std::shared_ptr<MarketRobot::Order> o, ::Order& oib);
+		void publishTick(const MR::DC::BinaryTick& k);
+		uint64_t tickRecvTime();
 	};
 }
 
@@ -0,0 +1,119 @@
+#include "Brokers/IB981/ibcontractcache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace MarketRobot
+{
+	static const char CACHE_SEPARATOR = '\t';
+	static const size_t CACHE_FIELDS = 11;
+
+	// names from TWS could carry the separator
+	static std::string field(const std::string& s)
+	{
+		std::string f = s;
+		for (char& c : f) {
+			if (c == CACHE_SEPARATOR || c == '\n' || c == '\r')
+				c = ' ';
+		}
+		return f;
+	}
+
+	static std::string today(time_t now)
+	{
+		struct tm tm;
+#ifdef _WIN32
+		localtime_s(&tm, &now);
+#else
+		localtime_r(&now, &tm);
+#endif
+		char buf[16];
+		strftime(buf, sizeof(buf), "%Y%m%d", &tm);
+		return buf;
+	}
+
+	bool IBContractCache::load(const std::string& path, time_t maxAge, time_t now)
+	{
+		entries_.clear();
+
+		std::ifstream in(path);
+		if (!in)
+			return false;
+
+		std::string date = today(now);
+		std::string line;
+		while (std::getline(in, line)) {
+			std::vector<std::string> v;
+			std::istringstream ss(line);
+			std::string f;
+			while (std::getline(ss, f, CACHE_SEPARATOR))
+				v.push_back(f);
+			// getline drops an empty last field, longName may be one
+			if (!line.empty() && line.back() == CACHE_SEPARATOR)
+				v.push_back(std::string());
+			if (v.size() < CACHE_FIELDS)
+				continue;
+
+			Entry e;
+			e.fullSymbol = v[0];
+			e.conId = std::atol(v[1].c_str());
+			e.updated = (time_t)std::atoll(v[2].c_str());
+			e.detailsSymbol = v[3];
+			e.localSymbol = v[4];
+			e.exchange = v[5];
+			e.secType = v[6];
+			e.multiplier = v[7];
+			e.lastTradeDate = v[8];
+			e.minTick = std::atof(v[9].c_str());
+			e.longName = v[10];
+
+			if (now - e.updated > maxAge)
+				continue;
+			if (!e.lastTradeDate.empty() && e.lastTradeDate.substr(0, 8) < date)
+				continue;
+			entries_[e.fullSymbol] = e;
+		}
+		return true;
+	}
+
+	bool IBContractCache::save(const std::string& path) const
+	{
+		std::string tmp = path + ".tmp";
+		{
+			std::ofstream out(tmp, std::ios::trunc);
+			if (!out)
+				return false;
+
+			for (auto& it : entries_) {
+				const Entry& e = it.second;
+				char minTick[32];
+				snprintf(minTick, sizeof(minTick), "%.10g", e.minTick);
+				out << field(e.fullSymbol) << CACHE_SEPARATOR << e.conId << CACHE_SEPARATOR << (long long)e.updated << CACHE_SEPARATOR
+					<< field(e.detailsSymbol) << CACHE_SEPARATOR << field(e.localSymbol) << CACHE_SEPARATOR << field(e.exchange) << CACHE_SEPARATOR
+					<< field(e.secType) << CACHE_SEPARATOR << field(e.multiplier) << CACHE_SEPARATOR << field(e.lastTradeDate) << CACHE_SEPARATOR
+					<< minTick << CACHE_SEPARATOR << field(e.longName) << '\n';
+			}
+			if (!out.flush())
+				return false;
+		}
+
+		std::error_code ec;
+		std::filesystem::rename(tmp, path, ec);
+		return !ec;
+	}
+
+	const IBContractCache::Entry* IBContractCache::find(const std::string& fullSymbol) const
+	{
+		auto it = entries_.find(fullSymbol);
+		return it == entries_.end() ? nullptr : &it->second;
+	}
+
+	void IBContractCache::update(const Entry& e)
+	{
+		entries_[e.fullSymbol] = e;
+	}
+}
@@ -0,0 +1,45 @@
+#ifndef _MarketRobot_Brokers_IBContractCache_H_
+#define _MarketRobot_Brokers_IBContractCache_H_
+
+#include <string>
+#include <unordered_map>
+#include <time.h>
+
+namespace MarketRobot
+{
+	/// IBContractCache
+	/// contract details of the configured securities kept on disk between
+	/// runs, one tab separated line per security, so a restart can subscribe
+	/// market data before TWS has answered reqContractDetails again.
+	class IBContractCache
+	{
+	public:
+		struct Entry {
+			std::string fullSymbol;			// as configured
+			long conId = 0;
+			time_t updated = 0;				// when TWS sent the details
+			std::string detailsSymbol;		// DataManager::securityDetails_ key
+			std::string localSymbol;
+			std::string exchange;
+			std::string secType;
+			std::string multiplier;
+			std::string lastTradeDate;		// yyyymmdd, empty for contracts that do not expire
+			std::string longName;
+			double minTick = 0;
+		};
+
+		// entries updated more than maxAge seconds ago or of expired contracts are dropped
+		bool load(const std::string& path, time_t maxAge, time_t now);
+		// written next to path and renamed over it, a crash leaves the old file
+		bool save(const std::string& path) const;
+
+		const Entry* find(const std::string& fullSymbol) const;
+		void update(const Entry& e);
+		size_t size() const { return entries_.size(); }
+
+	private:
+		std::unordered_map<std::string, Entry> entries_;
+	};
+}
+
+#endif // _MarketRobot_Brokers_IBContractCache_H_
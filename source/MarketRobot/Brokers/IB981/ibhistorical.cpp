@@ -0,0 +1,344 @@
+#include "Brokers/IB981/ibhistorical.h"
+#include "Common/Logger/spdlogger.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace MarketRobot
+{
+	static const int HIST_DATE_FORMAT_EPOCH = 2;	// bar times in seconds since 1/1/1970 GMT
+
+	static const char* barSizeSetting(int barSize)
+	{
+		switch (barSize)
+		{
+		case 1: return "1 secs";		// not 1 sec
+		case 5: return "5 secs";
+		case 15: return "15 secs";
+		case 30: return "30 secs";
+		case 60: return "1 min";
+		case 120: return "2 mins";
+		case 180: return "3 mins";
+		case 300: return "5 mins";
+		case 900: return "15 mins";
+		case 1800: return "30 mins";
+		case 3600: return "1 hour";
+		case 86400: return "1 day";
+		default: return nullptr;		// IB has no such bar size
+		}
+	}
+
+	// longest duration IB serves in one request for the bar size
+	static int chunkSecs(int barSize)
+	{
+		if (barSize < 5)
+			return 1800;
+		if (barSize < 10)
+			return 3600;
+		if (barSize < 30)
+			return 14400;
+		if (barSize < 60)
+			return 28800;
+		return 86400;
+	}
+
+	static std::string endDateTime(time_t t)
+	{
+		struct tm tm;
+#ifdef _WIN32
+		gmtime_s(&tm, &t);
+#else
+		gmtime_r(&t, &tm);
+#endif
+		char buf[32];
+		strftime(buf, sizeof(buf), "%Y%m%d %H:%M:%S GMT", &tm);
+		return buf;
+	}
+
+	// epoch seconds, or yyyymmdd which IB sends for daily bars whatever the format
+	static int64_t barTime(const std::string& time)
+	{
+		if (time.size() != 8)
+			return std::strtoll(time.c_str(), nullptr, 10);
+
+		int y = std::atoi(time.substr(0, 4).c_str());
+		unsigned m = std::atoi(time.substr(4, 2).c_str());
+		unsigned d = std::atoi(time.substr(6, 2).c_str());
+		// days from civil, http://howardhinnant.github.io/date_algorithms.html
+		y -= m <= 2;
+		int era = (y >= 0 ? y : y - 399) / 400;
+		unsigned yoe = (unsigned)(y - era * 400);
+		unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+		unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+		return ((int64_t)era * 146097 + (int64_t)doe - 719468) * 86400;
+	}
+
+	IBHistoricalDownloader::IBHistoricalDownloader(::EClientSocket* client, int firstReqId)
+		: m_pClient(client)
+		, nextReqId_(firstReqId)
+	{
+	}
+
+	void IBHistoricalDownloader::setPacing(const Pacing& pacing)
+	{
+		std::lock_guard<std::mutex> g(mutex_);
+		pacing_ = pacing;
+	}
+
+	bool IBHistoricalDownloader::backfill(const std::string& fullsymbol, const ::Contract& contract, int barSize, bool useRTH,
+		time_t start, time_t end, const std::string& dir)
+	{
+		if (!barSizeSetting(barSize)) {
+			LOG_ERROR("No IB bar size of {}s, backfill of {} refused", barSize, fullsymbol);
+			return false;
+		}
+
+		std::lock_guard<std::mutex> g(mutex_);
+
+		for (const Job& j : jobs_) {
+			if (j.store && j.fullsymbol == fullsymbol && j.barSize == barSize)
+				return true;				// already downloading
+		}
+
+		Job job;
+		job.fullsymbol = fullsymbol;
+		job.contract = contract;
+		job.contract.includeExpired = contract.secType != "STK";
+		job.barSize = barSize;
+		job.useRTH = useRTH;
+		job.store.reset(new MR::DC::BarColumnStore());
+		job.durationSecs = 0;
+		job.reqId = -1;
+		job.chunkEnd = 0;
+		job.retries = 0;
+
+		if (!job.store->open(dir)) {
+			LOG_ERROR("Cannot open bar store {} for {}", dir, fullsymbol);
+			return false;
+		}
+
+		// resume behind the bars on disk
+		job.next = start;
+		if (job.store->lastTime() >= 0)
+			job.next = std::max<time_t>(start, (time_t)job.store->lastTime() + barSize);
+		job.end = end;
+		job.chunkSecs = chunkSecs(barSize);
+
+		if (job.next >= job.end) {
+			LOG_INFO("Bars of {} are up to date, {} on disk", fullsymbol, job.store->rows());
+			return true;
+		}
+
+		LOG_INFO("Backfill {} {}s bars of {} from {}, {} on disk", (job.end - job.next) / barSize, barSize,
+			fullsymbol, endDateTime(job.next), job.store->rows());
+		jobs_.push_back(std::move(job));
+		return true;
+	}
+
+	bool IBHistoricalDownloader::request(const std::string& fullsymbol, const ::Contract& contract, const std::string& endDateTime,
+		int durationSecs, int barSize, bool useRTH, BarHandler onBar)
+	{
+		if (!barSizeSetting(barSize)) {
+			LOG_ERROR("No IB bar size of {}s, historical request of {} refused", barSize, fullsymbol);
+			return false;
+		}
+
+		std::lock_guard<std::mutex> g(mutex_);
+
+		Job job;
+		job.fullsymbol = fullsymbol;
+		job.contract = contract;
+		job.contract.includeExpired = contract.secType != "STK";
+		job.barSize = barSize;
+		job.useRTH = useRTH;
+		job.next = job.end = 0;
+		job.chunkSecs = 0;
+		job.endDateTime = endDateTime;
+		job.durationSecs = durationSecs;
+		job.onBar = onBar;
+		job.reqId = -1;
+		job.chunkEnd = 0;
+		job.retries = 0;
+		jobs_.push_back(std::move(job));
+		return true;
+	}
+
+	void IBHistoricalDownloader::pump()
+	{
+		std::lock_guard<std::mutex> g(mutex_);
+
+		if (!m_pClient->isConnected())
+			return;
+
+		clock::time_point now = clock::now();
+		if (now < pausedUntil_)
+			return;
+
+		while (!sent_.empty() && now - sent_.front() >= std::chrono::seconds(pacing_.windowSecs))
+			sent_.pop_front();
+
+		for (auto it = jobs_.begin(); it != jobs_.end(); ++it) {
+			if ((int)inflight_.size() >= pacing_.maxInFlight || (int)sent_.size() >= pacing_.maxPerWindow)
+				break;
+
+			Job& job = *it;
+			if (job.reqId >= 0 || now < job.notBefore)
+				continue;
+
+			while (!job.sent.empty() && now - job.sent.front() >= std::chrono::seconds(pacing_.contractWindowSecs))
+				job.sent.pop_front();
+			if ((int)job.sent.size() >= pacing_.maxPerContract)
+				continue;
+
+			job.reqId = nextReqId_++;
+			inflight_[job.reqId] = it;
+			send(job, now);
+		}
+	}
+
+	void IBHistoricalDownloader::send(Job& job, clock::time_point now)
+	{
+		std::string end = job.endDateTime;
+		int duration = job.durationSecs;
+
+		if (job.store) {
+			job.chunkEnd = std::min<time_t>(job.next + job.chunkSecs, job.end);
+			end = endDateTime(job.chunkEnd);
+			duration = (int)(job.chunkEnd - job.next);
+		}
+
+		job.bars.clear();
+		job.sent.push_back(now);
+		sent_.push_back(now);
+
+		::TagValueListSPtr chartOptions;
+		m_pClient->reqHistoricalData(job.reqId, job.contract, end, std::to_string(duration) + " S",
+			barSizeSetting(job.barSize), "TRADES", job.useRTH ? 1 : 0, HIST_DATE_FORMAT_EPOCH, false, chartOptions);
+	}
+
+	void IBHistoricalDownloader::retry(Job& job, clock::time_point notBefore)
+	{
+		job.reqId = -1;
+		job.bars.clear();
+		job.notBefore = notBefore;
+	}
+
+	void IBHistoricalDownloader::reset()
+	{
+		std::lock_guard<std::mutex> g(mutex_);
+
+		for (auto& f : inflight_)
+			retry(*f.second, clock::time_point());
+		inflight_.clear();
+		sent_.clear();
+	}
+
+	size_t IBHistoricalDownloader::pending() const
+	{
+		std::lock_guard<std::mutex> g(mutex_);
+		return jobs_.size();
+	}
+
+	bool IBHistoricalDownloader::historicalData(int reqId, const ::Bar& bar)
+	{
+		std::lock_guard<std::mutex> g(mutex_);
+
+		auto f = inflight_.find(reqId);
+		if (f == inflight_.end())
+			return false;
+
+		Job& job = *f->second;
+		if (!job.store) {
+			job.onBar(job.fullsymbol, bar);
+			return true;
+		}
+
+		int64_t t = barTime(bar.time);
+		if (t < job.next || t >= job.chunkEnd || t <= job.store->lastTime())
+			return true;
+
+		MR::DC::BarRow row;
+		row.time_ = t;
+		row.open_ = bar.open;
+		row.high_ = bar.high;
+		row.low_ = bar.low;
+		row.close_ = bar.close;
+		row.wap_ = bar.wap;
+		row.volume_ = bar.volume;
+		row.count_ = bar.count;
+		job.bars.push_back(row);
+		return true;
+	}
+
+	bool IBHistoricalDownloader::historicalDataEnd(int reqId)
+	{
+		std::lock_guard<std::mutex> g(mutex_);
+
+		auto f = inflight_.find(reqId);
+		if (f == inflight_.end())
+			return false;
+
+		auto it = f->second;
+		inflight_.erase(f);
+		complete(it);
+		return true;
+	}
+
+	void IBHistoricalDownloader::complete(std::list<Job>::iterator it)
+	{
+		Job& job = *it;
+		job.reqId = -1;
+		job.retries = 0;
+
+		if (!job.store) {
+			jobs_.erase(it);
+			return;
+		}
+
+		if (!job.store->append(job.bars)) {
+			LOG_ERROR("Cannot write bars of {}, backfill stopped", job.fullsymbol);
+			jobs_.erase(it);
+			return;
+		}
+
+		job.next = job.chunkEnd;
+		job.bars.clear();
+
+		if (job.next >= job.end) {
+			LOG_INFO("Backfill of {} done, {} bars on disk", job.fullsymbol, job.store->rows());
+			jobs_.erase(it);
+		}
+	}
+
+	bool IBHistoricalDownloader::error(int reqId, int errorCode, const std::string& errorString)
+	{
+		std::lock_guard<std::mutex> g(mutex_);
+
+		auto f = inflight_.find(reqId);
+		if (f == inflight_.end())
+			return false;
+
+		auto it = f->second;
+		Job& job = *it;
+		inflight_.erase(f);
+		clock::time_point now = clock::now();
+
+		if (errorCode == 162 && errorString.find("pacing violation") != std::string::npos) {
+			LOG_ERROR("Historical data pacing violation, pausing {}s", pacing_.violationPauseSecs);
+			pausedUntil_ = now + std::chrono::seconds(pacing_.violationPauseSecs);
+			retry(job, pausedUntil_);
+		}
+		else if (errorCode == 162 && errorString.find("returned no data") != std::string::npos) {
+			// nothing traded in the chunk: weekend, holiday, outside trading hours
+			complete(it);
+		}
+		else if (errorCode == 200 || ++job.retries > pacing_.maxRetries) {
+			LOG_ERROR("Historical data of {} dropped: {}", job.fullsymbol, errorString);
+			jobs_.erase(it);
+		}
+		else {
+			retry(job, now + std::chrono::seconds(pacing_.retrySecs));
+		}
+		return true;
+	}
+}
@@ -0,0 +1,117 @@
+#ifndef _MarketRobot_Brokers_IBHistorical_H_
+#define _MarketRobot_Brokers_IBHistorical_H_
+#include "Brokers/IB981/client/EClientSocket.h"
+#include "Brokers/IB981/client/Contract.h"
+#include "Brokers/IB981/client/bar.h"
+
+#include "DataCenter/barcolumns.h"
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <time.h>
+
+namespace MarketRobot
+{
+	/// IBHistoricalDownloader
+	/// queue of historical bar requests, sent as soon as IB's pacing rules allow
+	/// and with as many in flight as IB accepts. Dates are epoch seconds.
+	///
+	/// A backfill cuts [start, end) of a symbol into the longest requests IB
+	/// serves for its bar size, one in flight per symbol, oldest first, and
+	/// appends every completed request to the symbol's BarColumnStore. A
+	/// backfill of a symbol with bars on disk resumes behind the last one.
+	///
+	/// Callbacks of the IB message thread and requests of other threads may
+	/// interleave; every call takes the downloader lock.
+	class IBHistoricalDownloader
+	{
+	public:
+		using BarHandler = std::function<void(const std::string& fullsymbol, const ::Bar& bar)>;
+
+		// https://interactivebrokers.github.io/tws-api/historical_limitations.html
+		struct Pacing {
+			int maxInFlight = 50;			// simultaneous open requests
+			int maxPerWindow = 60;			// requests within windowSecs
+			int windowSecs = 600;
+			int maxPerContract = 5;			// requests for one contract within contractWindowSecs
+			int contractWindowSecs = 2;
+			int retrySecs = 15;				// identical requests within 15s are a violation
+			int violationPauseSecs = 60;	// nothing is sent for this long after a violation
+			int maxRetries = 3;
+		};
+
+		IBHistoricalDownloader(::EClientSocket* client, int firstReqId);
+
+		void setPacing(const Pacing& pacing);
+
+		// bars of [start, end), seconds since epoch, into the store in dir;
+		// both refuse a bar size IB has no setting for (1, 5, 15, 30 secs,
+		// 1, 2, 3, 5, 15, 30 mins, 1 hour, 1 day)
+		bool backfill(const std::string& fullsymbol, const ::Contract& contract, int barSize, bool useRTH,
+			time_t start, time_t end, const std::string& dir);
+		// one request; endDateTime as TWS takes it, empty for now
+		bool request(const std::string& fullsymbol, const ::Contract& contract, const std::string& endDateTime,
+			int durationSecs, int barSize, bool useRTH, BarHandler onBar);
+
+		// send the requests pacing allows now
+		void pump();
+		// the connection dropped: requests in flight are sent again by pump()
+		void reset();
+		size_t pending() const;
+
+		// EWrapper events; false for a reqId the downloader does not own
+		bool historicalData(int reqId, const ::Bar& bar);
+		bool historicalDataEnd(int reqId);
+		bool error(int reqId, int errorCode, const std::string& errorString);
+
+	private:
+		typedef std::chrono::steady_clock clock;
+
+		struct Job {
+			std::string fullsymbol;
+			::Contract contract;
+			int barSize;
+			bool useRTH;
+
+			// backfill, store is null for a single request
+			std::unique_ptr<MR::DC::BarColumnStore> store;
+			time_t next;					// start of the next chunk
+			time_t end;
+			int chunkSecs;
+
+			// single request
+			std::string endDateTime;
+			int durationSecs;
+			BarHandler onBar;
+
+			int reqId;						// -1 when not in flight
+			time_t chunkEnd;
+			std::vector<MR::DC::BarRow> bars;
+			clock::time_point notBefore;
+			std::deque<clock::time_point> sent;		// recent requests for the contract
+			int retries;
+		};
+
+		::EClientSocket* const m_pClient;
+		Pacing pacing_;
+		int nextReqId_;
+		mutable std::mutex mutex_;
+		std::list<Job> jobs_;
+		std::unordered_map<int, std::list<Job>::iterator> inflight_;
+		std::deque<clock::time_point> sent_;			// requests within the pacing window
+		clock::time_point pausedUntil_;
+
+		void send(Job& job, clock::time_point now);
+		void retry(Job& job, clock::time_point notBefore);
+		// the request of the job, taken out of inflight_, is complete
+		void complete(std::list<Job>::iterator it);
+	};
+}
+
+#endif // _MarketRobot_Brokers_IBHistorical_H_
@@ -0,0 +1,146 @@
+#include "Brokers/IB981/ibordertable.h"
+
+namespace MarketRobot
+{
+	IBOrderTable::IBOrderTable(uint32_t capacity)
+		: slab_(capacity)
+	{
+		uint32_t buckets = 2;
+		while (buckets < 2 * capacity)
+			buckets <<= 1;
+		byBroker_.resize(buckets);
+		byServer_.resize(buckets);
+		mask_ = buckets - 1;
+		clear();
+	}
+
+	void IBOrderTable::clear()
+	{
+		for (uint32_t i = 0; i < slab_.size(); ++i) {
+			slab_[i].order.reset();
+			slab_[i].next = i + 1 < slab_.size() ? i + 1 : NONE;
+		}
+		free_ = slab_.empty() ? NONE : 0;
+		size_ = 0;
+		byBroker_.assign(byBroker_.size(), NONE);
+		byServer_.assign(byServer_.size(), NONE);
+		symbolHead_.assign(symbolHead_.size(), NONE);
+		symbolTail_.assign(symbolTail_.size(), NONE);
+	}
+
+	bool IBOrderTable::add(const OrderPtr& o, uint32_t sid)
+	{
+		remove(o->brokerOrderId);
+		if (free_ == NONE)
+			return false;
+
+		uint32_t i = free_;
+		Slot& s = slab_[i];
+		free_ = s.next;
+		s.order = o;
+		s.brokerOrderId = o->brokerOrderId;
+		s.serverOrderId = o->serverOrderId;
+		s.sid = sid;
+		insert(byBroker_, &Slot::brokerOrderId, i);
+		insert(byServer_, &Slot::serverOrderId, i);
+
+		// a symbol seen for the first time grows the list heads, nothing else allocates
+		if (sid >= symbolHead_.size()) {
+			symbolHead_.resize(sid + 1, NONE);
+			symbolTail_.resize(sid + 1, NONE);
+		}
+		s.next = NONE;
+		s.prev = symbolTail_[sid];
+		if (s.prev == NONE)
+			symbolHead_[sid] = i;
+		else
+			slab_[s.prev].next = i;
+		symbolTail_[sid] = i;
+
+		++size_;
+		return true;
+	}
+
+	void IBOrderTable::remove(int64_t brokerOrderId)
+	{
+		uint32_t i = find(byBroker_, &Slot::brokerOrderId, brokerOrderId);
+		if (i != NONE)
+			release(i);
+	}
+
+	const IBOrderTable::OrderPtr* IBOrderTable::byBrokerOrderId(int64_t id) const
+	{
+		uint32_t i = find(byBroker_, &Slot::brokerOrderId, id);
+		return i == NONE ? nullptr : &slab_[i].order;
+	}
+
+	const IBOrderTable::OrderPtr* IBOrderTable::byServerOrderId(int64_t id) const
+	{
+		uint32_t i = find(byServer_, &Slot::serverOrderId, id);
+		return i == NONE ? nullptr : &slab_[i].order;
+	}
+
+	// order ids are consecutive, a multiplicative hash spreads them over the table
+	uint32_t IBOrderTable::bucket(int64_t key) const
+	{
+		return (uint32_t)(((uint64_t)key * 0x9E3779B97F4A7C15ull) >> 32) & mask_;
+	}
+
+	uint32_t IBOrderTable::find(const std::vector<uint32_t>& table, int64_t Slot::* key, int64_t id) const
+	{
+		for (uint32_t b = bucket(id); table[b] != NONE; b = (b + 1) & mask_) {
+			if (slab_[table[b]].*key == id)
+				return table[b];
+		}
+		return NONE;
+	}
+
+	// the table is at most half full, a free bucket is always found
+	void IBOrderTable::insert(std::vector<uint32_t>& table, int64_t Slot::* key, uint32_t slot)
+	{
+		uint32_t b = bucket(slab_[slot].*key);
+		while (table[b] != NONE)
+			b = (b + 1) & mask_;
+		table[b] = slot;
+	}
+
+	// linear probing without tombstones: the entries behind the hole that
+	// cannot be reached from their home bucket any more are shifted back
+	void IBOrderTable::erase(std::vector<uint32_t>& table, int64_t Slot::* key, uint32_t slot)
+	{
+		uint32_t hole = bucket(slab_[slot].*key);
+		while (table[hole] != slot)
+			hole = (hole + 1) & mask_;
+
+		for (uint32_t b = (hole + 1) & mask_; table[b] != NONE; b = (b + 1) & mask_) {
+			uint32_t home = bucket(slab_[table[b]].*key);
+			// move the entry when its home is not in (hole, b]
+			if (((b - home) & mask_) >= ((b - hole) & mask_)) {
+				table[hole] = table[b];
+				hole = b;
+			}
+		}
+		table[hole] = NONE;
+	}
+
+	void IBOrderTable::release(uint32_t i)
+	{
+		Slot& s = slab_[i];
+		erase(byBroker_, &Slot::brokerOrderId, i);
+		erase(byServer_, &Slot::serverOrderId, i);
+
+		if (s.prev == NONE)
+			symbolHead_[s.sid] = s.next;
+		else
+			slab_[s.prev].next = s.next;
+		if (s.next == NONE)
+			symbolTail_[s.sid] = s.prev;
+		else
+			slab_[s.next].prev = s.prev;
+
+		s.order.reset();
+		s.next = free_;
+		free_ = i;
+		--size_;
+	}
+}
@@ -0,0 +1,81 @@
+#ifndef _MarketRobot_Brokers_IBOrderTable_H_
+#define _MarketRobot_Brokers_IBOrderTable_H_
+
+#include "Common/Order/order.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace MarketRobot
+{
+	/// IBOrderTable
+	/// orders of the IB connection indexed by IB order id and by server order
+	/// id in open addressing tables, with the live orders of every symbol on an
+	/// intrusive list. Slots come from a slab allocated up front, so adding,
+	/// finding and removing an order does not allocate.
+	///
+	/// OrderManager owns the orders and keeps every api's; the table is the
+	/// brokerage's index into the IB ones. It has no lock, it is used on the
+	/// brokerage thread only.
+	class IBOrderTable
+	{
+	public:
+		typedef std::shared_ptr<MarketRobot::Order> OrderPtr;
+		static constexpr uint32_t NONE = 0xffffffff;
+
+		explicit IBOrderTable(uint32_t capacity = 1 << 16);
+
+		// sid is the SymbolRegistry id of the order's symbol; an order with the
+		// same IB order id is replaced. False when the slab is full.
+		bool add(const OrderPtr& o, uint32_t sid);
+		// the order is done: filled or cancelled
+		void remove(int64_t brokerOrderId);
+		void clear();
+
+		// null when the order is not in the table
+		const OrderPtr* byBrokerOrderId(int64_t id) const;
+		const OrderPtr* byServerOrderId(int64_t id) const;
+
+		// f(const OrderPtr&) for every live order of the symbol, oldest first
+		template <typename F>
+		void forEachLive(uint32_t sid, F f) const
+		{
+			if (sid >= symbolHead_.size())
+				return;
+			for (uint32_t i = symbolHead_[sid]; i != NONE; i = slab_[i].next)
+				f(slab_[i].order);
+		}
+
+		size_t size() const { return size_; }
+		uint32_t capacity() const { return (uint32_t)slab_.size(); }
+
+	private:
+		struct Slot {
+			OrderPtr order;
+			int64_t brokerOrderId;
+			int64_t serverOrderId;
+			uint32_t sid;
+			uint32_t prev;				// symbol list; next also links the free slots
+			uint32_t next;
+		};
+
+		std::vector<Slot> slab_;
+		uint32_t free_;					// first free slot
+		size_t size_;
+		// slot of every bucket, NONE for an empty one; twice the capacity, a power of two
+		std::vector<uint32_t> byBroker_;
+		std::vector<uint32_t> byServer_;
+		uint32_t mask_;
+		std::vector<uint32_t> symbolHead_;	// oldest live order of every sid
+		std::vector<uint32_t> symbolTail_;
+
+		uint32_t bucket(int64_t key) const;
+		uint32_t find(const std::vector<uint32_t>& table, int64_t Slot::* key, int64_t id) const;
+		void insert(std::vector<uint32_t>& table, int64_t Slot::* key, uint32_t slot);
+		void erase(std::vector<uint32_t>& table, int64_t Slot::* key, uint32_t slot);
+		void release(uint32_t slot);
+	};
+}
+
+#endif // _MarketRobot_Brokers_IBOrderTable_H_
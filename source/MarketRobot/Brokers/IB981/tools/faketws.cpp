@@ -0,0 +1,60 @@
+// Fake TWS: serves a capture recorded by EReader::startCapture (ib
+// capture_file in the config) to every client connecting on the port, so the
+// robot can run against real session traffic without TWS.
+//
+//     faketws <capture file> [port] [--fast]
+//
+// Frames are sent at their recorded pace unless --fast is given.
+
+#include "StdAfx.h"
+#include "ECapture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <capture file> [port] [--fast]\n", argv[0]);
+		return 1;
+	}
+
+	int port = 7497;
+	bool paced = true;
+
+	for (int i = 2; i < argc; ++i) {
+		if (strcmp(argv[i], "--fast") == 0)
+			paced = false;
+		else
+			port = atoi(argv[i]);
+	}
+
+	ECaptureReader capture;
+	if (!capture.open(argv[1])) {
+		fprintf(stderr, "cannot read capture %s\n", argv[1]);
+		return 1;
+	}
+
+	ECaptureServer server(capture);
+	if (!server.listen(port)) {
+		fprintf(stderr, "cannot listen on port %d\n", port);
+		return 1;
+	}
+
+	printf("serving %s (server version %d) on port %d\n", argv[1], capture.serverVersion(), server.port());
+
+	for (;;) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		long nFrames = server.serve(paced);
+		double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		if (nFrames < 0)
+			printf("client left before the end of the capture\n");
+		else
+			printf("sent %ld frames, session of %.3fs\n", nFrames, secs);
+	}
+
+	return 0;
+}
@@ -0,0 +1,92 @@
+/******************************************************************************/
+/*!
+\file   adaptivewaiter.h
+\par    Market Robot Engine
+
+Consumer wait that spins before it parks, woken by its producers
+*/
+/******************************************************************************/
+#ifndef _MarketRobot_AdaptiveWaiter_H
+#define _MarketRobot_AdaptiveWaiter_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace MR::Component{
+
+	/******************************************************************************/
+	/*!
+	The consumer polls for up to the spin budget, then parks on a condition
+	variable. The budget adapts: it doubles, up to the configured one, when a
+	spin found data and halves when it ran out, so a busy stream is picked up
+	by a spinning consumer and a quiet one costs no cpu. notify() is a load on
+	the producer's side unless the consumer is parked.
+	*/
+	/******************************************************************************/
+	class AdaptiveWaiter
+	{
+	public:
+		//! spinNs 0 always parks
+		explicit AdaptiveWaiter(uint64_t spinNs = 0)
+			: maxSpin_(spinNs), spin_(spinNs) {}
+
+		void setSpin(uint64_t spinNs) { maxSpin_ = spinNs; spin_ = spinNs; }
+
+		//! consumer thread: returns when ready() holds or after timeout
+		template<typename Ready, typename Rep, typename Period>
+		void wait(Ready ready, std::chrono::duration<Rep, Period> timeout)
+		{
+			if (ready())
+				return;
+
+			if (spin_ > 0) {
+				auto until = std::chrono::steady_clock::now() + std::chrono::nanoseconds(spin_);
+				do {
+					if (ready()) {
+						spin_ = spin_ * 2 < maxSpin_ ? spin_ * 2 : maxSpin_;
+						return;
+					}
+					std::this_thread::yield();
+				} while (std::chrono::steady_clock::now() < until);
+				spin_ /= 2;
+			}
+			else if (maxSpin_ > 0) {
+				spin_ = maxSpin_ < 1000 ? maxSpin_ : 1000;		// probe again after a park
+			}
+
+			std::unique_lock<std::mutex> lock(mutex_);
+			parked_.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			// a push before parked_ was set did not notify
+			if (!ready())
+				cv_.wait_for(lock, timeout, [this] { return !parked_.load(std::memory_order_relaxed); });
+			parked_.store(false, std::memory_order_relaxed);
+		}
+
+		//! any thread, after publishing data ready() will see
+		void notify()
+		{
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (!parked_.load(std::memory_order_relaxed))
+				return;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				parked_.store(false, std::memory_order_relaxed);
+			}
+			cv_.notify_one();
+		}
+
+	private:
+		uint64_t maxSpin_;
+		uint64_t spin_;						// current budget, consumer only
+		std::atomic<bool> parked_{ false };
+		std::mutex mutex_;
+		std::condition_variable cv_;
+	};
+}
+
+#endif // _MarketRobot_AdaptiveWaiter_H
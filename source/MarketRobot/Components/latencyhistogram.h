@@ -0,0 +1,140 @@
+/******************************************************************************/
+/*!
+\file   latencyhistogram.h
+\par    Market Robot Engine
+
+Log-linear histogram of latencies in nanoseconds
+*/
+/******************************************************************************/
+#ifndef _MarketRobot_LatencyHistogram_H
+#define _MarketRobot_LatencyHistogram_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace MR::Component{
+
+	/******************************************************************************/
+	/*!
+	Every power of two is cut into SUBBUCKETS linear buckets, so a percentile
+	is off by at most 1/SUBBUCKETS of its value over the whole uint64_t range.
+	Recording is an index computation and an increment. The histogram has one
+	writer; the counters are relaxed atomics so other threads may read it.
+	*/
+	/******************************************************************************/
+	class LatencyHistogram
+	{
+	public:
+		static const int SUBBUCKET_BITS = 4;
+		static const int SUBBUCKETS = 1 << SUBBUCKET_BITS;
+		static const int BUCKETS = (64 - SUBBUCKET_BITS + 1) * SUBBUCKETS;
+
+		LatencyHistogram() { reset(); }
+
+		void record(uint64_t ns)
+		{
+			bump(buckets_[index(ns)], 1);
+			bump(count_, 1);
+			if (ns > max_.load(std::memory_order_relaxed))
+				max_.store(ns, std::memory_order_relaxed);
+		}
+
+		//! adds the counts of another histogram, e.g. to merge those of several threads
+		void add(const LatencyHistogram& other)
+		{
+			for (int i = 0; i < BUCKETS; ++i) {
+				uint64_t n = other.buckets_[i].load(std::memory_order_relaxed);
+				if (n)
+					bump(buckets_[i], n);
+			}
+			bump(count_, other.count());
+			if (other.max() > max())
+				max_.store(other.max(), std::memory_order_relaxed);
+		}
+
+		uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+		uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+		//! upper bound of the bucket holding the p-th percentile, p in [0, 100]
+		uint64_t percentile(double p) const
+		{
+			uint64_t n = count();
+			if (n == 0)
+				return 0;
+			uint64_t rank = (uint64_t)(p / 100.0 * n + 0.5);
+			if (rank == 0)
+				rank = 1;
+			uint64_t seen = 0;
+			for (int i = 0; i < BUCKETS; ++i) {
+				seen += buckets_[i].load(std::memory_order_relaxed);
+				if (seen >= rank)
+					return upper(i) < max() ? upper(i) : max();
+			}
+			return max();
+		}
+
+		void reset()
+		{
+			for (int i = 0; i < BUCKETS; ++i)
+				buckets_[i].store(0, std::memory_order_relaxed);
+			count_.store(0, std::memory_order_relaxed);
+			max_.store(0, std::memory_order_relaxed);
+		}
+
+		//! "n=1000 p50=12.3us p90=... p99=... p99.9=... max=..."
+		std::string summary() const
+		{
+			char buf[160];
+			snprintf(buf, sizeof(buf), "n=%llu p50=%.1fus p90=%.1fus p99=%.1fus p99.9=%.1fus max=%.1fus",
+				(unsigned long long)count(), percentile(50) / 1e3, percentile(90) / 1e3,
+				percentile(99) / 1e3, percentile(99.9) / 1e3, max() / 1e3);
+			return buf;
+		}
+
+	private:
+		std::atomic<uint64_t> buckets_[BUCKETS];
+		std::atomic<uint64_t> count_;
+		std::atomic<uint64_t> max_;
+
+		// single writer: a load and a store, no locked read-modify-write
+		static void bump(std::atomic<uint64_t>& c, uint64_t n)
+		{
+			c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+		}
+
+		static int msb(uint64_t v)
+		{
+#if defined(_MSC_VER)
+			unsigned long i;
+			_BitScanReverse64(&i, v);
+			return (int)i;
+#else
+			return 63 - __builtin_clzll(v);
+#endif
+		}
+
+		static int index(uint64_t ns)
+		{
+			if (ns < (uint64_t)SUBBUCKETS)
+				return (int)ns;
+			int shift = msb(ns) - SUBBUCKET_BITS;
+			return (shift + 1) * SUBBUCKETS + (int)((ns >> shift) & (SUBBUCKETS - 1));
+		}
+
+		static uint64_t upper(int i)
+		{
+			if (i < SUBBUCKETS)
+				return (uint64_t)i;
+			int shift = i / SUBBUCKETS - 1;
+			uint64_t lower = (uint64_t)(SUBBUCKETS + i % SUBBUCKETS) << shift;
+			return lower + (((uint64_t)1 << shift) - 1);
+		}
+	};
+}
+
+#endif // _MarketRobot_LatencyHistogram_H
@@ -0,0 +1,103 @@
+/******************************************************************************/
+/*!
+\file   latencytrace.h
+\par    Market Robot Engine
+
+Per-stage latency histograms of the tick path
+*/
+/******************************************************************************/
+#ifndef _MarketRobot_LatencyTrace_H
+#define _MarketRobot_LatencyTrace_H
+
+#include "Components/latencyhistogram.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace MR::Component{
+
+	//! where a tick is on its way from the socket to the strategies; every
+	//! stage is timed from the moment its bytes came off the socket
+	enum class TraceStage : uint8_t {
+		Dequeue = 0,		// frame taken off the reader queue
+		Dispatch,			// EWrapper tick callback entered, frame decoded
+		Publish,			// tick sent on the market data msgq
+		DataCenter,			// tick applied to the quotes and queued for the bars
+		Bar,				// tick applied to the bars
+		COUNT
+	};
+
+	/******************************************************************************/
+	/*!
+	Every thread records into its own set of histograms, registered on its
+	first record() and kept for the life of the process; report() merges them.
+	Recording takes no lock and does not allocate.
+	*/
+	/******************************************************************************/
+	class LatencyTrace
+	{
+	public:
+		static const char* name(TraceStage s)
+		{
+			static const char* names[] = { "dequeue", "dispatch", "publish", "datacenter", "bar" };
+			return names[(int)s];
+		}
+
+		static void record(TraceStage s, uint64_t ns)
+		{
+			local().stages[(int)s].record(ns);
+		}
+
+		//! one line per stage that saw a tick, all threads merged
+		static std::string report()
+		{
+			std::string r;
+			std::unique_ptr<LatencyHistogram> merged(new LatencyHistogram);
+			std::lock_guard<std::mutex> g(registryMutex());
+			for (int s = 0; s < (int)TraceStage::COUNT; ++s) {
+				merged->reset();
+				for (ThreadStages* t : registry())
+					merged->add(t->stages[s]);
+				if (merged->count() > 0) {
+					r += r.empty() ? "" : "\n";
+					r += std::string("wire->") + name((TraceStage)s) + ": " + merged->summary();
+				}
+			}
+			return r;
+		}
+
+	private:
+		struct ThreadStages {
+			LatencyHistogram stages[(int)TraceStage::COUNT];
+		};
+
+		static ThreadStages& local()
+		{
+			thread_local ThreadStages* stages = nullptr;
+			if (!stages) {
+				stages = new ThreadStages;		// outlives the thread, report() may still read it
+				std::lock_guard<std::mutex> g(registryMutex());
+				registry().push_back(stages);
+			}
+			return *stages;
+		}
+
+		static std::mutex& registryMutex()
+		{
+			static std::mutex m;
+			return m;
+		}
+
+		static std::vector<ThreadStages*>& registry()
+		{
+			static std::vector<ThreadStages*> r;
+			return r;
+		}
+	};
+}
+
+#endif // _MarketRobot_LatencyTrace_H
@@ -0,0 +1,124 @@
+/******************************************************************************/
+/*!
+\file   mpscqueue.h
+\par    Market Robot Engine
+
+Bounded lock-free queue, many producers and one consumer
+*/
+/******************************************************************************/
+#ifndef _MarketRobot_MpscQueue_H
+#define _MarketRobot_MpscQueue_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace MR::Component{
+
+	/******************************************************************************/
+	/*!
+	Ring of cells with a sequence number each (D. Vyukov's bounded queue).
+	Producers claim a cell with a CAS on the tail and publish it by bumping its
+	sequence; the consumer owns the head and needs no atomic read-modify-write.
+	Neither side takes a lock or allocates after construction.
+	*/
+	/******************************************************************************/
+	template<typename T>
+	class MpscQueue
+	{
+	public:
+		//! capacity is rounded up to a power of two
+		explicit MpscQueue(size_t capacity)
+		{
+			size_t n = 2;
+			while (n < capacity)
+				n <<= 1;
+			mask_ = n - 1;
+			cells_.reset(new Cell[n]);
+			for (size_t i = 0; i < n; ++i)
+				cells_[i].seq.store(i, std::memory_order_relaxed);
+			tail_.store(0, std::memory_order_relaxed);
+			head_ = 0;
+		}
+
+		MpscQueue(const MpscQueue&) = delete;
+		MpscQueue& operator=(const MpscQueue&) = delete;
+
+		//! any thread; false when the queue is full
+		template<typename U>
+		bool try_push(U&& v)
+		{
+			size_t pos = tail_.load(std::memory_order_relaxed);
+			for (;;) {
+				Cell& c = cells_[pos & mask_];
+				size_t seq = c.seq.load(std::memory_order_acquire);
+				std::ptrdiff_t dif = (std::ptrdiff_t)seq - (std::ptrdiff_t)pos;
+				if (dif == 0) {
+					if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						c.value = std::forward<U>(v);
+						c.seq.store(pos + 1, std::memory_order_release);
+						return true;
+					}
+				}
+				else if (dif < 0) {
+					return false;
+				}
+				else {
+					pos = tail_.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		//! consumer thread only; false when the queue is empty
+		bool try_pop(T& v)
+		{
+			Cell& c = cells_[head_ & mask_];
+			if (c.seq.load(std::memory_order_acquire) != head_ + 1)
+				return false;
+			v = std::move(c.value);
+			c.seq.store(head_ + mask_ + 1, std::memory_order_release);
+			++head_;
+			return true;
+		}
+
+		//! consumer thread only; f(T&) on up to max values in push order, each
+		//! handled in its cell and released after; returns how many there were
+		template<typename F>
+		size_t drain(F&& f, size_t max = (size_t)-1)
+		{
+			size_t n = 0;
+			while (n < max) {
+				Cell& c = cells_[head_ & mask_];
+				if (c.seq.load(std::memory_order_acquire) != head_ + 1)
+					break;
+				f(c.value);
+				c.seq.store(head_ + mask_ + 1, std::memory_order_release);
+				++head_;
+				++n;
+			}
+			return n;
+		}
+
+		//! consumer thread only
+		bool empty() const
+		{
+			return cells_[head_ & mask_].seq.load(std::memory_order_acquire) != head_ + 1;
+		}
+
+		size_t capacity() const { return mask_ + 1; }
+
+	private:
+		struct Cell {
+			std::atomic<size_t> seq;
+			T value;
+		};
+
+		std::unique_ptr<Cell[]> cells_;
+		size_t mask_;
+		alignas(64) std::atomic<size_t> tail_;
+		alignas(64) size_t head_;
+	};
+}
+
+#endif // _MarketRobot_MpscQueue_H
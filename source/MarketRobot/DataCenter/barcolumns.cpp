@@ -0,0 +1,125 @@
+#include "DataCenter/barcolumns.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+namespace MR::DC {
+	namespace fs = std::filesystem;
+
+	const char* const BarColumnStore::names_[COL_NUM] = {
+		"time.i64", "open.f64", "high.f64", "low.f64", "close.f64", "wap.f64", "volume.i64", "count.i32"
+	};
+	const size_t BarColumnStore::widths_[COL_NUM] = {
+		sizeof(int64_t), sizeof(double), sizeof(double), sizeof(double), sizeof(double), sizeof(double), sizeof(int64_t), sizeof(int32_t)
+	};
+
+	BarColumnStore::BarColumnStore() : rows_(0), last_time_(-1) {
+		for (int c = 0; c < COL_NUM; ++c)
+			files_[c] = nullptr;
+	}
+
+	BarColumnStore::~BarColumnStore() {
+		close();
+	}
+
+	bool BarColumnStore::open(const std::string& dir) {
+		close();
+
+		std::error_code ec;
+		fs::create_directories(dir, ec);
+		if (ec)
+			return false;
+
+		// rows every column holds completely
+		int64_t rows = INT64_MAX;
+		for (int c = 0; c < COL_NUM; ++c) {
+			fs::path p = fs::path(dir) / names_[c];
+			uintmax_t size = fs::exists(p, ec) ? fs::file_size(p, ec) : 0;
+			if (ec)
+				return false;
+			rows = std::min<int64_t>(rows, size / widths_[c]);
+		}
+
+		for (int c = 0; c < COL_NUM; ++c) {
+			fs::path p = fs::path(dir) / names_[c];
+			if (fs::exists(p, ec))
+				fs::resize_file(p, rows * widths_[c], ec);
+			if (ec || (files_[c] = std::fopen(p.string().c_str(), "ab+")) == nullptr) {
+				close();
+				return false;
+			}
+		}
+
+		rows_ = rows;
+		last_time_ = -1;
+		if (rows_ > 0) {
+			int64_t t;
+			if (std::fseek(files_[COL_TIME], (long)((rows_ - 1) * sizeof(int64_t)), SEEK_SET) != 0
+				|| std::fread(&t, sizeof(t), 1, files_[COL_TIME]) != 1) {
+				close();
+				return false;
+			}
+			last_time_ = t;
+		}
+		return true;
+	}
+
+	bool BarColumnStore::isOpen() const {
+		return files_[COL_TIME] != nullptr;
+	}
+
+	int64_t BarColumnStore::rows() const {
+		return rows_;
+	}
+
+	int64_t BarColumnStore::lastTime() const {
+		return last_time_;
+	}
+
+	bool BarColumnStore::append(const std::vector<BarRow>& bars) {
+		if (!isOpen())
+			return false;
+		if (bars.empty())
+			return true;
+
+		for (int c = 0; c < COL_NUM; ++c) {
+			column_.resize(bars.size() * widths_[c]);
+			char* out = column_.data();
+			for (const BarRow& b : bars) {
+				switch (c) {
+				case COL_TIME: std::memcpy(out, &b.time_, sizeof(b.time_)); break;
+				case COL_OPEN: std::memcpy(out, &b.open_, sizeof(b.open_)); break;
+				case COL_HIGH: std::memcpy(out, &b.high_, sizeof(b.high_)); break;
+				case COL_LOW: std::memcpy(out, &b.low_, sizeof(b.low_)); break;
+				case COL_CLOSE: std::memcpy(out, &b.close_, sizeof(b.close_)); break;
+				case COL_WAP: std::memcpy(out, &b.wap_, sizeof(b.wap_)); break;
+				case COL_VOLUME: std::memcpy(out, &b.volume_, sizeof(b.volume_)); break;
+				case COL_COUNT: std::memcpy(out, &b.count_, sizeof(b.count_)); break;
+				}
+				out += widths_[c];
+			}
+			// "ab+" writes at the end anyway, but a write after open()'s read
+			// needs the stream repositioned first
+			if (std::fseek(files_[c], 0, SEEK_END) != 0
+				|| std::fwrite(column_.data(), 1, column_.size(), files_[c]) != column_.size()
+				|| std::fflush(files_[c]) != 0)
+				return false;
+		}
+
+		rows_ += bars.size();
+		last_time_ = bars.back().time_;
+		return true;
+	}
+
+	void BarColumnStore::close() {
+		for (int c = 0; c < COL_NUM; ++c) {
+			if (files_[c])
+				std::fclose(files_[c]);
+			files_[c] = nullptr;
+		}
+		rows_ = 0;
+		last_time_ = -1;
+	}
+}
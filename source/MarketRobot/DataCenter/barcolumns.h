@@ -0,0 +1,56 @@
+#ifndef _MarketRobot_DataCenter_BarColumns_H_
+#define _MarketRobot_DataCenter_BarColumns_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace MR::DC
+{
+	/// one bar as it is appended to a BarColumnStore
+	struct BarRow {
+		int64_t time_;			// bar start, seconds since epoch
+		double open_;
+		double high_;
+		double low_;
+		double close_;
+		double wap_;
+		int64_t volume_;
+		int32_t count_;
+	};
+
+	/// BarColumnStore
+	/// bars of one symbol and bar size on disk, one file per column in a
+	/// directory (time.i64, open.f64, ..., count.i32), appended in time order.
+	/// A column is a plain array a reader can mmap or load in one read.
+	/// open() cuts all columns to the length of the shortest one, so an append
+	/// torn by a crash is dropped and lastTime() tells where to resume.
+	class BarColumnStore {
+	public:
+		BarColumnStore();
+		~BarColumnStore();
+
+		bool open(const std::string& dir);
+		bool isOpen() const;
+		// bars and time of the last one, -1 when empty
+		int64_t rows() const;
+		int64_t lastTime() const;
+		bool append(const std::vector<BarRow>& bars);
+		void close();
+
+	private:
+		enum Column { COL_TIME, COL_OPEN, COL_HIGH, COL_LOW, COL_CLOSE, COL_WAP, COL_VOLUME, COL_COUNT, COL_NUM };
+		static const char* const names_[COL_NUM];
+		static const size_t widths_[COL_NUM];
+
+		FILE* files_[COL_NUM];
+		int64_t rows_;
+		int64_t last_time_;
+		std::vector<char> column_;			// one column of the bars being appended
+
+		BarColumnStore(const BarColumnStore&) = delete;
+		BarColumnStore& operator=(const BarColumnStore&) = delete;
+	};
+}
+#endif // _MarketRobot_DataCenter_BarColumns_H_
@@ -0,0 +1,216 @@
+#include "DataCenter/barmatrix.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+namespace MR::DC {
+	static const uint64_t NANOSECONDS_PER_SECOND = 1000000000ULL;
+
+	bool BarSpec::parse(const std::string& s, BarSpec& spec) {
+		const char* p = s.c_str();
+		char* unit = nullptr;
+		double size = strtod(p, &unit);
+		if (unit == p || size <= 0 || unit[0] == 0 || unit[1] != 0)
+			return false;
+
+		switch (unit[0]) {
+		case 's': spec.kind_ = TIME; spec.size_ = size; break;
+		case 'm': spec.kind_ = TIME; spec.size_ = size * 60; break;
+		case 'h': spec.kind_ = TIME; spec.size_ = size * 3600; break;
+		case 't': spec.kind_ = TICK; spec.size_ = size; break;
+		case 'v': spec.kind_ = VOLUME; spec.size_ = size; break;
+		case '$': spec.kind_ = DOLLAR; spec.size_ = size; break;
+		default: return false;
+		}
+		// whole seconds, the timer does not do better
+		return spec.kind_ != TIME || (spec.size_ >= 1 && spec.size_ == (double)(int64_t)spec.size_);
+	}
+
+	std::string BarSpec::str() const {
+		static const char units[KINDS] = { 's', 't', 'v', '$' };
+		char buf[32];
+		if (kind_ == TIME && (int64_t)size_ % 3600 == 0)
+			snprintf(buf, sizeof(buf), "%lldh", (long long)size_ / 3600);
+		else if (kind_ == TIME && (int64_t)size_ % 60 == 0)
+			snprintf(buf, sizeof(buf), "%lldm", (long long)size_ / 60);
+		else
+			snprintf(buf, sizeof(buf), "%.15g%c", size_, units[kind_]);
+		return buf;
+	}
+
+	void BarMatrix::reset(const std::vector<BarSpec>& specs) {
+		specs_ = specs;
+		for (int k = 0; k < BarSpec::KINDS; ++k) {
+			base_[k] = -1;
+			coarser_[k].clear();
+		}
+		for (size_t s = 0; s < specs_.size(); ++s) {
+			int& base = base_[specs_[s].kind_];
+			if (base < 0 || specs_[s].size_ < specs_[base].size_)
+				base = (int)s;
+		}
+		for (size_t s = 0; s < specs_.size(); ++s) {
+			if ((int)s != base_[specs_[s].kind_])
+				coarser_[specs_[s].kind_].push_back(s);
+		}
+
+		start_.clear();
+		end_.clear();
+		open_.clear();
+		high_.clear();
+		low_.clear();
+		close_.clear();
+		volume_.clear();
+		value_.clear();
+		count_.clear();
+	}
+
+	void BarMatrix::addSymbol(uint32_t sid, uint64_t now) {
+		size_t first = symbols();
+		if (slots() == 0 || sid < first)
+			return;
+
+		size_t rows = ((size_t)sid + 1) * slots();
+		start_.resize(rows);
+		end_.resize(rows);
+		open_.resize(rows);
+		high_.resize(rows);
+		low_.resize(rows);
+		close_.resize(rows);
+		volume_.resize(rows);
+		value_.resize(rows);
+		count_.resize(rows);
+		for (size_t r = first * slots(); r < rows; ++r) {
+			const BarSpec& spec = specs_[slotOf(r)];
+			if (spec.kind_ == BarSpec::TIME) {
+				uint64_t interval = (uint64_t)spec.size_ * NANOSECONDS_PER_SECOND;
+				roll(r, now - now % interval);
+			}
+			else {
+				roll(r, now);
+			}
+		}
+	}
+
+	int BarMatrix::finestInterval() const {
+		return base_[BarSpec::TIME] < 0 ? 0 : (int)specs_[base_[BarSpec::TIME]].size_;
+	}
+
+	void BarMatrix::onTrade(uint32_t sid, double price, double size, uint64_t now, std::vector<size_t>& done) {
+		size_t r0 = row(sid, 0);
+		for (int k = 0; k < BarSpec::KINDS; ++k) {
+			if (base_[k] < 0)
+				continue;
+			size_t r = r0 + base_[k];
+			trade(r, price, size);
+			if (k != BarSpec::TIME && full(r))
+				closeBase(sid, (BarSpec::Kind)k, now, done);
+		}
+	}
+
+	void BarMatrix::onBar(uint32_t sid, double open, double high, double low, double close, double volume, int64_t count) {
+		if (base_[BarSpec::TIME] < 0)
+			return;
+		size_t r = row(sid, base_[BarSpec::TIME]);
+		if (count_[r] == 0) {
+			open_[r] = open;
+			high_[r] = high;
+			low_[r] = low;
+		}
+		else {
+			high_[r] = std::max(high_[r], high);
+			low_[r] = std::min(low_[r], low);
+		}
+		close_[r] = close;
+		volume_[r] += volume;
+		value_[r] += close * volume;
+		count_[r] += std::max<int64_t>(count, 1);
+	}
+
+	void BarMatrix::onTime(uint32_t sid, uint64_t boundary, std::vector<size_t>& done) {
+		if (base_[BarSpec::TIME] >= 0)
+			closeBase(sid, BarSpec::TIME, boundary, done);
+	}
+
+	void BarMatrix::roll(size_t r, uint64_t start) {
+		const BarSpec& spec = specs_[slotOf(r)];
+		start_[r] = start;
+		// an information bar ends with the trade that fills it
+		end_[r] = spec.kind_ == BarSpec::TIME ? start + (uint64_t)spec.size_ * NANOSECONDS_PER_SECOND : start;
+		open_[r] = 0;
+		high_[r] = 0;
+		low_[r] = 0;
+		close_[r] = 0;
+		volume_[r] = 0;
+		value_[r] = 0;
+		count_[r] = 0;
+	}
+
+	void BarMatrix::trade(size_t r, double price, double size) {
+		if (count_[r] == 0) {
+			open_[r] = price;
+			high_[r] = price;
+			low_[r] = price;
+		}
+		else {
+			high_[r] = std::max(high_[r], price);
+			low_[r] = std::min(low_[r], price);
+		}
+		close_[r] = price;
+		volume_[r] += size;
+		value_[r] += price * size;
+		++count_[r];
+	}
+
+	void BarMatrix::merge(size_t from, size_t to) {
+		if (count_[from] == 0)
+			return;
+		if (count_[to] == 0) {
+			open_[to] = open_[from];
+			high_[to] = high_[from];
+			low_[to] = low_[from];
+		}
+		else {
+			high_[to] = std::max(high_[to], high_[from]);
+			low_[to] = std::min(low_[to], low_[from]);
+		}
+		close_[to] = close_[from];
+		volume_[to] += volume_[from];
+		value_[to] += value_[from];
+		count_[to] += count_[from];
+	}
+
+	bool BarMatrix::full(size_t r) const {
+		const BarSpec& spec = specs_[slotOf(r)];
+		switch (spec.kind_) {
+		case BarSpec::TICK: return count_[r] >= spec.size_;
+		case BarSpec::VOLUME: return volume_[r] >= spec.size_;
+		case BarSpec::DOLLAR: return value_[r] >= spec.size_;
+		default: return false;
+		}
+	}
+
+	// the finest bar of the kind is done at end; coarser bars take it in and
+	// are done on a boundary of their own, or once full
+	void BarMatrix::closeBase(uint32_t sid, BarSpec::Kind kind, uint64_t end, std::vector<size_t>& done) {
+		size_t r0 = row(sid, 0);
+		size_t base = r0 + base_[kind];
+		if (kind != BarSpec::TIME)
+			end_[base] = end;
+		done.push_back(base);
+
+		for (size_t s : coarser_[kind]) {
+			size_t r = r0 + s;
+			merge(base, r);
+			if (kind == BarSpec::TIME) {
+				if (end % ((uint64_t)specs_[s].size_ * NANOSECONDS_PER_SECOND) == 0)
+					done.push_back(r);
+			}
+			else if (full(r)) {
+				end_[r] = end;
+				done.push_back(r);
+			}
+		}
+	}
+}
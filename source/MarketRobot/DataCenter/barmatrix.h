@@ -0,0 +1,93 @@
+#ifndef _MarketRobot_DataCenter_BarMatrix_H_
+#define _MarketRobot_DataCenter_BarMatrix_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace MR::DC
+{
+	/// what closes a bar: the clock, or a number of trades, shares or dollars
+	struct BarSpec {
+		enum Kind { TIME = 0, TICK, VOLUME, DOLLAR, KINDS };
+		Kind kind_;
+		double size_;				// seconds, trades, shares or dollars
+
+		// "30s", "1m", "4h", "500t" trades, "10000v" shares, "1000000$" dollars; false for anything else
+		static bool parse(const std::string& s, BarSpec& spec);
+		std::string str() const;
+		bool operator<(const BarSpec& o) const { return kind_ != o.kind_ ? kind_ < o.kind_ : size_ < o.size_; }
+	};
+
+	/// BarMatrix
+	/// the bars being formed, one per symbol and bar spec, held as columns
+	/// (start, end, open, high, low, close, volume, dollar value, count). The
+	/// bar of symbol id sid and spec slot s is row sid * slots() + s, so the
+	/// bars of a symbol are adjacent in every column.
+	///
+	/// A trade only goes into the finest bar of every kind. When that one is
+	/// done it goes into the coarser bars of its kind, which are done on the
+	/// same boundary (time) or once they are over their own size (the others).
+	/// The work per trade does not grow with the number of specs or symbols.
+	///
+	/// Done bars are reported by row and keep their values until roll(). It
+	/// has no lock, it is used on the DataCenter thread only.
+	class BarMatrix {
+	public:
+		// a coarser time bar is a multiple of the finest one; drops every bar
+		void reset(const std::vector<BarSpec>& specs);
+		// rows for symbol ids up to sid; their bars start at now
+		void addSymbol(uint32_t sid, uint64_t now);
+
+		size_t slots() const { return specs_.size(); }
+		size_t symbols() const { return slots() ? open_.size() / slots() : 0; }
+		const BarSpec& spec(size_t slot) const { return specs_[slot]; }
+		// the finest time bar in seconds, 0 without time bars
+		int finestInterval() const;
+
+		// a trade at time now; the rows of the bars it completes are appended to done
+		void onTrade(uint32_t sid, double price, double size, uint64_t now, std::vector<size_t>& done);
+		// a bar of a shorter interval goes into the finest time bar
+		void onBar(uint32_t sid, double open, double high, double low, double close, double volume, int64_t count);
+		// the finest time bar ends at boundary; the rows of the bars done are appended to done
+		void onTime(uint32_t sid, uint64_t boundary, std::vector<size_t>& done);
+		// the bar of the row is replaced by an empty one starting at start
+		void roll(size_t r, uint64_t start);
+
+		size_t row(uint32_t sid, size_t slot) const { return sid * slots() + slot; }
+		size_t slotOf(size_t r) const { return r % slots(); }
+		bool has(uint32_t sid) const { return sid < symbols(); }
+		// columns, indexed by row(); a bar with count 0 saw no trade yet
+		uint64_t start(size_t r) const { return start_[r]; }
+		uint64_t end(size_t r) const { return end_[r]; }
+		double open(size_t r) const { return open_[r]; }
+		double high(size_t r) const { return high_[r]; }
+		double low(size_t r) const { return low_[r]; }
+		double close(size_t r) const { return close_[r]; }
+		double volume(size_t r) const { return volume_[r]; }
+		double value(size_t r) const { return value_[r]; }
+		int64_t count(size_t r) const { return count_[r]; }
+
+	private:
+		std::vector<BarSpec> specs_;
+		int base_[BarSpec::KINDS];						// slot of the finest bar of every kind, -1 for none
+		std::vector<size_t> coarser_[BarSpec::KINDS];	// the other slots of the kind
+
+		std::vector<uint64_t> start_;		// nanoseconds since epoch
+		std::vector<uint64_t> end_;
+		std::vector<double> open_;
+		std::vector<double> high_;
+		std::vector<double> low_;
+		std::vector<double> close_;
+		std::vector<double> volume_;
+		std::vector<double> value_;			// price times size
+		std::vector<int64_t> count_;
+
+		void trade(size_t r, double price, double size);
+		void merge(size_t from, size_t to);
+		bool full(size_t r) const;			// an information bar at or over its size
+		void closeBase(uint32_t sid, BarSpec::Kind kind, uint64_t end, std::vector<size_t>& done);
+	};
+}
+#endif // _MarketRobot_DataCenter_BarMatrix_H_
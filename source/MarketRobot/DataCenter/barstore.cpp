@@ -0,0 +1,178 @@
+#include "DataCenter/barstore.h"
+
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace MR::DC {
+	namespace fs = std::filesystem;
+
+	BarStore::BarStore() : head_(0), held_(0), spilled_(0), first_(0)
+#ifdef _WIN32
+		, file_(nullptr)
+#else
+		, fd_(-1), map_(nullptr), map_size_(0)
+#endif
+	{
+	}
+
+	BarStore::~BarStore() {
+		close();
+	}
+
+	bool BarStore::open(const std::string& path, size_t capacity) {
+		close();
+		ring_.resize(capacity > 0 ? capacity : 1);
+		if (path.empty())
+			return true;
+
+		std::error_code ec;
+		fs::path p(path);
+		if (p.has_parent_path())
+			fs::create_directories(p.parent_path(), ec);
+		uintmax_t size = fs::exists(p, ec) ? fs::file_size(p, ec) : 0;
+		if (ec)
+			return false;
+		size_t bars = (size_t)(size / sizeof(BarRecord));
+		if (size != bars * sizeof(BarRecord))
+			fs::resize_file(p, bars * sizeof(BarRecord), ec);
+		if (ec)
+			return false;
+
+#ifdef _WIN32
+		file_ = std::fopen(path.c_str(), "ab+");
+		if (file_ == nullptr)
+			return false;
+#else
+		fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+		if (fd_ < 0)
+			return false;
+#endif
+		spilled_ = bars;
+		return true;
+	}
+
+	// the bars in the ring go to the file too, the next open() takes them up
+	void BarStore::close() {
+		for (size_t i = 0; i < held_ && spill(ring_[(head_ + i) % ring_.size()]); ++i)
+			;
+#ifdef _WIN32
+		if (file_)
+			std::fclose(file_);
+		file_ = nullptr;
+#else
+		unmap();
+		if (fd_ >= 0)
+			::close(fd_);
+		fd_ = -1;
+#endif
+		head_ = 0;
+		held_ = 0;
+		spilled_ = 0;
+		first_ = 0;
+	}
+
+	void BarStore::push(const BarRecord& b) {
+		if (held_ == ring_.size()) {
+			// the oldest bar leaves the ring for the file; after a write
+			// failed the file is given up and only the ring is reached
+			if (!spill(ring_[head_]))
+				first_ = spilled_ + 1;
+			++spilled_;
+			head_ = (head_ + 1) % ring_.size();
+			--held_;
+		}
+		ring_[(head_ + held_) % ring_.size()] = b;
+		++held_;
+	}
+
+	bool BarStore::at(size_t i, BarRecord& b) const {
+		if (i < first_ || i >= size())
+			return false;
+		if (i >= spilled_) {
+			b = ring_[(head_ + i - spilled_) % ring_.size()];
+			return true;
+		}
+		return read(i, b);
+	}
+
+	size_t BarStore::lowerBound(uint64_t t) const {
+		size_t lo = first_, hi = size();
+		BarRecord b;
+		while (lo < hi) {
+			size_t mid = lo + (hi - lo) / 2;
+			if (!at(mid, b))
+				return size();
+			if (b.start_ < t)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo;
+	}
+
+#ifdef _WIN32
+	bool BarStore::spill(const BarRecord& b) {
+		if (file_ == nullptr)
+			return false;
+		// read() shares the stream, a write after a read has to reposition it first
+		if (_fseeki64(file_, 0, SEEK_END) != 0
+			|| std::fwrite(&b, sizeof(b), 1, file_) != 1 || std::fflush(file_) != 0) {
+			std::fclose(file_);
+			file_ = nullptr;
+			return false;
+		}
+		return true;
+	}
+
+	bool BarStore::read(size_t i, BarRecord& b) const {
+		return file_ != nullptr
+			&& _fseeki64(file_, (long long)(i * sizeof(BarRecord)), SEEK_SET) == 0
+			&& std::fread(&b, sizeof(b), 1, file_) == 1;
+	}
+#else
+	bool BarStore::spill(const BarRecord& b) {
+		if (fd_ < 0)
+			return false;
+		if (::write(fd_, &b, sizeof(b)) != (ssize_t)sizeof(b)) {
+			unmap();
+			::close(fd_);
+			fd_ = -1;
+			return false;
+		}
+		return true;
+	}
+
+	bool BarStore::read(size_t i, BarRecord& b) const {
+		if (fd_ < 0)
+			return false;
+		size_t offset = i * sizeof(BarRecord);
+		if (offset + sizeof(BarRecord) > map_size_) {
+			// map all of the file there is, pages are only read as touched
+			unmap();
+			size_t size = spilled_ * sizeof(BarRecord);
+			void* map = mmap(0, size, PROT_READ, MAP_SHARED, fd_, 0);
+			if (map == MAP_FAILED)
+				return false;
+			map_ = (const char*)map;
+			map_size_ = size;
+		}
+		std::memcpy(&b, map_ + offset, sizeof(b));
+		return true;
+	}
+
+	void BarStore::unmap() const {
+		if (map_)
+			munmap((void*)map_, map_size_);
+		map_ = nullptr;
+		map_size_ = 0;
+	}
+#endif
+}
@@ -0,0 +1,74 @@
+#ifndef _MarketRobot_DataCenter_BarStore_H_
+#define _MarketRobot_DataCenter_BarStore_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace MR::DC
+{
+	/// one bar as BarStore keeps it, in memory and in its file
+	struct BarRecord {
+		uint64_t start_;		// nanoseconds since epoch
+		uint64_t end_;
+		double open_;
+		double high_;
+		double low_;
+		double close_;
+		double volume_;
+		int64_t count_;
+	};
+
+	/// BarStore
+	/// the bars of one symbol and bar spec that are done, in time order. The
+	/// newest ones are held in a ring of fixed capacity; a bar pushed out of
+	/// it is appended to a file that is mapped for reading, so memory stays
+	/// flat over a long run while every bar is still reached by index or time.
+	/// close() writes out the ring as well and open() takes up the bars a
+	/// previous run left in the file, dropping a record torn by a crash.
+	///
+	/// It has no lock; DataCenter serializes pushes and reads.
+	class BarStore {
+	public:
+		BarStore();
+		~BarStore();
+
+		// path empty keeps the ring only, a bar pushed out of it is lost
+		bool open(const std::string& path, size_t capacity);
+		void close();
+		void push(const BarRecord& b);
+
+		// bars pushed, and taken up from the file
+		size_t size() const { return spilled_ + held_; }
+		// index of the oldest bar still there, 0 unless the ring dropped some
+		size_t first() const { return first_; }
+		bool at(size_t i, BarRecord& b) const;
+		// index of the first bar that starts at or after t, size() for none
+		size_t lowerBound(uint64_t t) const;
+
+	private:
+		std::vector<BarRecord> ring_;
+		size_t head_;				// slot of the oldest bar in the ring
+		size_t held_;				// bars in the ring
+		size_t spilled_;			// bars before the ring, in the file or dropped
+		size_t first_;
+
+#ifdef _WIN32
+		FILE* file_;
+#else
+		int fd_;
+		// the mapping follows the file when a read goes past it
+		mutable const char* map_;
+		mutable size_t map_size_;
+		void unmap() const;
+#endif
+		bool spill(const BarRecord& b);
+		bool read(size_t i, BarRecord& b) const;		// a bar in the file
+
+		BarStore(const BarStore&) = delete;
+		BarStore& operator=(const BarStore&) = delete;
+	};
+}
+#endif // _MarketRobot_DataCenter_BarStore_H_
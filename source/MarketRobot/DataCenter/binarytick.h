@@ -0,0 +1,53 @@
+#ifndef _MarketRobot_DataCenter_BinaryTick_H_
+#define _MarketRobot_DataCenter_BinaryTick_H_
+
+#include "Common/config.h"
+#include "Common/Data/datatype.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+namespace MR::DC
+{
+	using MarketRobot::DataType;
+
+	/// BinaryTick
+	/// fixed-layout tick carried from the feed to the DataCenter and published
+	/// as is in binary mode: a copy of 40 bytes, no string and no allocation.
+	/// The symbol is the SymbolRegistry id, times are nanoseconds since epoch.
+	struct BinaryTick {
+		uint64_t recv_time_;		// arrival at the feed, off its socket when it can tell
+		uint64_t exchange_time_;	// stamped by the exchange, 0 when the feed has none
+		double price_;
+		int32_t size_;
+		uint32_t sid_;				// SymbolRegistry id
+		int32_t datatype_;			// DataType
+		int32_t reserved_;
+
+		DataType datatype() const { return static_cast<DataType>(datatype_); }
+	};
+
+	static_assert(std::is_trivially_copyable<BinaryTick>::value, "BinaryTick is copied as raw bytes");
+	static_assert(sizeof(BinaryTick) == 40, "BinaryTick layout is part of the wire format");
+
+	/// binary tick message: <topic>|<BinaryTick bytes>, in host byte order.
+	/// msg keeps its capacity, so publishing from a reused string does not allocate.
+	inline void serializeBinaryTick(const BinaryTick& k, const std::string& topic, std::string& msg) {
+		msg.resize(topic.size() + 1 + sizeof(BinaryTick));
+		std::memcpy(&msg[0], topic.data(), topic.size());
+		msg[topic.size()] = SERIALIZATION_SEPARATOR;
+		std::memcpy(&msg[topic.size() + 1], &k, sizeof(BinaryTick));
+	}
+
+	inline bool deserializeBinaryTick(const char* msg, size_t len, const std::string& topic, BinaryTick& k) {
+		if (len != topic.size() + 1 + sizeof(BinaryTick)
+			|| std::memcmp(msg, topic.data(), topic.size()) != 0
+			|| msg[topic.size()] != SERIALIZATION_SEPARATOR)
+			return false;
+		std::memcpy(&k, msg + topic.size() + 1, sizeof(BinaryTick));
+		return true;
+	}
+}
+#endif // _MarketRobot_DataCenter_BinaryTick_H_
@@ -2,6 +2,7 @@
 #include "Common/Util/util.h"
 #include "Common/Util/pair_hash.h"
 
+#include <algorithm>
 #include <vector>
 
 namespace MR::DC {
@@ -10,7 +11,17 @@ namespace MR::DC {
 	DataCenter* DataCenter::pinstance_ = nullptr;
 	mutex DataCenter::instancelock_;
 
+	static const size_t TICKQUEUESIZE = 1 << 16;		// trades in flight to the bars
+	static const size_t BARQUEUESIZE = 1 << 12;			// 5s bars in flight
+	static const size_t TIMEQUEUESIZE = 64;				// bar intervals that are up
+	static const size_t DRAINBATCH = 1024;				// handled per queue before the other gets a turn
+	static const auto PARKTIMEOUT = std::chrono::milliseconds(100);		// the latency report and stop() are checked this often when idle
+
 	DataCenter::DataCenter() : quit_(true), running_(false), thread_(nullptr)
+		, tick_queue_(TICKQUEUESIZE)
+		, bar_queue_(BARQUEUESIZE)
+		, time_queue_(TIMEQUEUESIZE)
+		, queue_waiter_((uint64_t)std::max(CConfig::instance().datacenter_spin_us, 0) * 1000)
 	{
 		// message queue factory
 		if (CConfig::instance()._msgq == MSGQ::ZMQ) {
@@ -40,34 +51,38 @@ namespace MR::DC {
 
 	void DataCenter::iteration()
 	{
-		// process the tick que every 1s
-		std::this_thread::sleep_for(std::chrono::microseconds(1000000));
-		if (!tick_queue_.empty()) {
-			std::lock_guard lock_t(tick_queue_mutex_);
-			tick_swap_queue_.swap(tick_queue_);
-		}
-		if (!bar_queue_.empty()) {
-			std::lock_guard lock_b(bar_queue_mutex_);
-			bar_swap_queue_.swap(bar_queue_);
-		}
-		if (!tick_swap_queue_.empty()) {
-			DEBUG("Tick Swap size:{}", tick_swap_queue_.size());
-		}
-		while (!tick_swap_queue_.empty()) {
-			Tick& tick = tick_swap_queue_.front();
+		// a tick is on the bars as soon as the thread wakes up, not on the next second
+		queue_waiter_.wait([this] { return !tick_queue_.empty() || !bar_queue_.empty() || !time_queue_.empty(); }, PARKTIMEOUT);
+
+		tick_queue_.drain([this](BinaryTick& tick) {
 			//DEBUG("tick ={}", tick.str());
 			tick_update_bar(tick);
-			tick_swap_queue_.pop();
-		}
-		if (!bar_swap_queue_.empty()) {
-			DEBUG("Bar Swap size:{}", bar_swap_queue_.size());
-		}
-		while (!bar_swap_queue_.empty()) {
-			Bar* b = bar_swap_queue_.front();
+		}, DRAINBATCH);
+		bar_queue_.drain([this](Bar* b) {
 			//DEBUG("Bar ={}", b->str());
 			onBar(b);
-			bar_swap_queue_.pop();
-		}
+		}, DRAINBATCH);
+		// after the trades that came before the interval was up
+		time_queue_.drain([this](int t) {
+			roll_bars(t);
+		});
+
+		if (CConfig::instance().latency_trace)
+			report_latency(time::now_in_nano());
+	}
+
+	void DataCenter::report_latency(uint64_t now) {
+		int secs = CConfig::instance().latency_report_secs;
+		if (secs <= 0 || now - last_latency_report_ < (uint64_t)secs * time_unit::NANOSECONDS_PER_SECOND)
+			return;
+		last_latency_report_ = now;
+
+		string report = MR::Component::LatencyTrace::report();
+		if (report.empty())
+			return;
+		LOG_INFO("Tick path latency:\n{}", report);
+		latency_msg_ = CConfig::instance().latency_msg + SERIALIZATION_SEPARATOR + report;
+		msgq_pub_->sendmsg(latency_msg_);
 	}
 
 	void DataCenter::start() {
@@ -75,29 +90,40 @@ namespace MR::DC {
 		auto now_in_nano = time::now_in_nano();
 		quit_ = false;
 
+		load_bar_specs();
+		bar_matrix_.reset(bar_specs_);
 		for (auto& s : CConfig::instance().securities) {
-			FullTick k;
-			k.fullsymbol_ = s;
-			latest_quotes_[s] = k;
-
-			for (auto& t : time_intervals_) {
-				auto time_interval = t * time_unit::NANOSECONDS_PER_SECOND;
-				auto start_time = now_in_nano - now_in_nano % time_interval + time_interval;
-				Bar bar(s, t);
-				bar.start_time_ = start_time;
-				bar.end_time_ = start_time + time_interval;
-
-				BarSeries bs(s, t);
-				bs.bars().push_back(bar);
-				auto symbol_interval = std::make_pair(s, t);
-				barseries_[symbol_interval] = bs;
+			uint32_t id = SymbolRegistry::instance().intern(s);
+			if (id >= bars_by_id_.size()) {
+				bars_by_id_.resize(id + 1);
+				books_.resize(id + 1);
+			}
+			bars_by_id_[id].clear();
+			for (auto& spec : bar_specs_) {
+				// bars out of memory go on disk, there is nowhere without a data_dir
+				string path;
+				if (!CConfig::instance().dataDir().empty())
+					path = CConfig::instance().dataDir() + "/bars/" + s + "_" + spec.str() + ".bin";
+				auto store = make_unique<BarStore>();
+				if (!store->open(path, (size_t)std::max(CConfig::instance().bar_memory, 1))) {
+					LOG_ERROR("Bars of {} {} cannot be kept in {}, only the last {} are", s, spec.str(), path, CConfig::instance().bar_memory);
+					store->open("", (size_t)std::max(CConfig::instance().bar_memory, 1));
+				}
+				bars_by_id_[id].push_back(std::move(store));
 			}
+			bar_matrix_.addSymbol(id, now_in_nano);
+		}
+		// before the feeds start, no reader or writer is on the board yet
+		quotes_.reset(bars_by_id_.size());
+
+		//create Frame timer to notify the time event; the coarser time bars
+		//are done on the boundaries of the finest
+		int finest = bar_matrix_.finestInterval();
+		if (finest > 0) {
+			timer_ptr_ = make_unique<FrameTimer>(vector<int>{ finest });
+			timer_ptr_->subscribe([&,this](int i) {this->onTime(i); });
+			timer_ptr_->start();
 		}
-
-		//create Frame timer to notify the time event
-		timer_ptr_ = make_unique<FrameTimer>(time_intervals_);
-		timer_ptr_->subscribe([&,this](int i) {this->onTime(i); });
-		timer_ptr_->start();
 
 		if (!running_)
 		{
@@ -108,6 +134,35 @@ namespace MR::DC {
 		}
 
 	}
+	void DataCenter::load_bar_specs() {
+		bar_specs_.clear();
+		for (auto& s : CConfig::instance().bar_specs) {
+			BarSpec spec;
+			if (!BarSpec::parse(s, spec)) {
+				LOG_ERROR("Bar {} is not valid, expected e.g. 30s 1m 4h 500t 10000v 1000000$", s);
+				continue;
+			}
+			bar_specs_.push_back(spec);
+		}
+		std::sort(bar_specs_.begin(), bar_specs_.end());
+		bar_specs_.erase(std::unique(bar_specs_.begin(), bar_specs_.end(), [](const BarSpec& a, const BarSpec& b) {
+			return a.kind_ == b.kind_ && a.size_ == b.size_; }), bar_specs_.end());
+
+		// a time bar is made of whole bars of the finest one
+		if (!bar_specs_.empty() && bar_specs_[0].kind_ == BarSpec::TIME) {
+			int64_t finest = (int64_t)bar_specs_[0].size_;
+			for (size_t i = 1; i < bar_specs_.size(); ) {
+				if (bar_specs_[i].kind_ == BarSpec::TIME && (int64_t)bar_specs_[i].size_ % finest != 0) {
+					LOG_ERROR("Bar {} is not a multiple of {}, dropped", bar_specs_[i].str(), bar_specs_[0].str());
+					bar_specs_.erase(bar_specs_.begin() + i);
+				}
+				else {
+					++i;
+				}
+			}
+		}
+	}
+
 	void DataCenter::run() {
 		while (running_) {
 
@@ -129,9 +184,14 @@ namespace MR::DC {
 		clear();
 	}
 	void DataCenter::clear() {
-		latest_quotes_.clear();
-		barseries_.clear();
 		securityDetails_.clear();
+		quotes_.reset(0);
+		{
+			std::lock_guard lock(bars_mutex_);
+			bars_by_id_.clear();
+		}
+		bar_matrix_.reset(bar_specs_);
+		books_.clear();
 		
 	}
 
@@ -145,85 +205,177 @@ namespace MR::DC {
 		return *pinstance_;
 	}
 	void DataCenter::onTick(Tick& k) {
+		uint32_t sid = SymbolRegistry::instance().id(k.fullsymbol_);
+		if (sid == SymbolRegistry::INVALID_ID)
+			return;
 
 		if (k.datatype_ == DataType::DT_Bid) {
-			latest_quotes_[k.fullsymbol_].bidprice_L1_ = k.price_;
-			latest_quotes_[k.fullsymbol_].bidsize_L1_ = k.size_;
+			quotes_.setBid(sid, k.price_, k.size_, k.data_time_);
 		}
 		else if (k.datatype_ == DataType::DT_Ask) {
-			latest_quotes_[k.fullsymbol_].askprice_L1_ = k.price_;
-			latest_quotes_[k.fullsymbol_].asksize_L1_ = k.size_;
+			quotes_.setAsk(sid, k.price_, k.size_, k.data_time_);
 		}
 		else if (k.datatype_ == DataType::DT_Trade) {
-			latest_quotes_[k.fullsymbol_].price_ = k.price_;
-			latest_quotes_[k.fullsymbol_].size_ = k.size_;
+			quotes_.setTrade(sid, k.price_, k.size_, k.data_time_);
 			//push tick into the tick que
 			push_tick(k);
 		}
 		else if (k.datatype_ == DataType::DT_Full) {
-			// default assigement shallow copy
-			latest_quotes_[k.fullsymbol_] = dynamic_cast<FullTick&>(k);		
-
+			FullTick& f = dynamic_cast<FullTick&>(k);
+			Quote q;
+			q.time_ = f.data_time_;
+			q.price_ = f.price_;
+			q.size_ = f.size_;
+			q.bidprice_ = f.bidprice_L1_;
+			q.bidsize_ = f.bidsize_L1_;
+			q.askprice_ = f.askprice_L1_;
+			q.asksize_ = f.asksize_L1_;
+			q.reserved_ = 0;
+			quotes_.set(sid, q);
 		}
 
 	}
-	void DataCenter::onBar(Bar* k) {
+	void DataCenter::onTick(const BinaryTick& k) {
+		if (k.sid_ >= quotes_.size())
+			return;
 
-		auto & full_symbol = k->fullsymbol_;
-
-		for (auto& t : time_intervals_) {
-			auto symbol_interval = std::make_pair(full_symbol, t);
-			if (barseries_.find(symbol_interval) != barseries_.end())
-			{
-				BarSeries& barseries = barseries_[symbol_interval];
-				
-				if (!barseries.bars().empty()) {
-					Bar& current_bar = barseries.bars().back();
-					current_bar.onBar(k);
-				}
-			}
+		if (k.datatype() == DataType::DT_Bid) {
+			quotes_.setBid(k.sid_, k.price_, k.size_, k.recv_time_);
+		}
+		else if (k.datatype() == DataType::DT_Ask) {
+			quotes_.setAsk(k.sid_, k.price_, k.size_, k.recv_time_);
+		}
+		else if (k.datatype() == DataType::DT_Trade) {
+			quotes_.setTrade(k.sid_, k.price_, k.size_, k.recv_time_);
+			//push tick into the tick que
+			push_tick(k);
+		}
+		if (CConfig::instance().latency_trace)
+			MR::Component::LatencyTrace::record(MR::Component::TraceStage::DataCenter, time::now_in_nano() - k.recv_time_);
+	}
+	bool DataCenter::quote(const string& fullsymbol, Quote& q) const {
+		uint32_t sid = SymbolRegistry::instance().id(fullsymbol);
+		return sid != SymbolRegistry::INVALID_ID && quotes_.read(sid, q);
+	}
+	void DataCenter::onMarketDepth(uint32_t sid, int position, int operation, int side, double price, int size) {
+		BookDelta d;
+		// the books may be fed by several market data connections; the lock
+		// also covers the reused message
+		std::lock_guard lock(book_mutex_);
+		if (sid >= books_.size())
+			return;
+		OrderBook& book = books_[sid];
+		if (!book.apply(position, operation, side, price, size)) {
+			DEBUG("Depth operation {} at {} does not fit the book of {}", operation, position, sid);
+			return;
 		}
+		d.seq_ = book.seq();
+
+		d.recv_time_ = time::now_in_nano();
+		d.price_ = price;
+		d.size_ = size;
+		d.sid_ = sid;
+		d.position_ = (int8_t)position;
+		d.operation_ = (int8_t)operation;
+		d.side_ = (int8_t)side;
+		memset(d.reserved_, 0, sizeof(d.reserved_));
+
+		const string& topic = CConfig::instance().book_msg;
+		book_delta_msg_.resize(topic.size() + 1 + sizeof(BookDelta));
+		memcpy(&book_delta_msg_[0], topic.data(), topic.size());
+		book_delta_msg_[topic.size()] = SERIALIZATION_SEPARATOR;
+		memcpy(&book_delta_msg_[topic.size() + 1], &d, sizeof(BookDelta));
+		msgq_pub_->sendmsg(book_delta_msg_);
 	}
-	void DataCenter::tick_update_bar(const Tick& k) {
 
-		auto& full_symbol = k.fullsymbol_;
-		for (auto& t : time_intervals_) {
-			auto symbol_interval = std::make_pair(full_symbol, t);
-			if (barseries_.find(symbol_interval) != barseries_.end())
-			{
-				BarSeries& barseries = barseries_[symbol_interval];
-				if (!barseries.bars().empty()) {
-					Bar& current_bar = barseries.bars().back();
-					current_bar.onTick(k);
-				}
-			}
+	bool DataCenter::book(uint32_t sid, OrderBook& snapshot) {
+		std::lock_guard lock(book_mutex_);
+		if (sid >= books_.size())
+			return false;
+		snapshot = books_[sid];
+		return true;
+	}
+
+	bool DataCenter::bars(uint32_t sid, const BarSpec& spec, uint64_t from, uint64_t to, vector<BarRecord>& out) {
+		out.clear();
+		std::lock_guard lock(bars_mutex_);
+		if (sid >= bars_by_id_.size())
+			return false;
+		for (size_t slot = 0; slot < bars_by_id_[sid].size(); ++slot) {
+			if (bar_specs_[slot].kind_ != spec.kind_ || bar_specs_[slot].size_ != spec.size_)
+				continue;
+			const BarStore& store = *bars_by_id_[sid][slot];
+			BarRecord b;
+			for (size_t i = store.lowerBound(from); i < store.size() && store.at(i, b) && b.start_ < to; ++i)
+				out.push_back(b);
+			return true;
 		}
+		return false;
+	}
 
+	void DataCenter::onBar(Bar* k) {
+		uint32_t sid = SymbolRegistry::instance().id(k->fullsymbol_);
+		if (sid == SymbolRegistry::INVALID_ID || !bar_matrix_.has(sid))
+			return;
+		bar_matrix_.onBar(sid, k->open_, k->high_, k->low_, k->close_, k->volume_, k->count_);
+	}
+	void DataCenter::tick_update_bar(const BinaryTick& k) {
+		if (!bar_matrix_.has(k.sid_))
+			return;
+
+		done_bars_.clear();
+		bar_matrix_.onTrade(k.sid_, k.price_, k.size_, k.recv_time_, done_bars_);
+		if (!done_bars_.empty())
+			publish_bars(k.sid_, k.recv_time_);
+		if (CConfig::instance().latency_trace)
+			MR::Component::LatencyTrace::record(MR::Component::TraceStage::Bar, time::now_in_nano() - k.recv_time_);
 	}
 
+	// on the timer thread; the bars are rolled on the DataCenter thread
 	void DataCenter::onTime(int t) {
-		auto now_in_nano = time::now_in_nano();
-		for (auto& s : CConfig::instance().securities) {
-			auto time_interval = t * time_unit::NANOSECONDS_PER_SECOND;
-			auto start_time = now_in_nano - now_in_nano % time_interval;// +time_interval;
-			Bar bar(s, t);
-			bar.start_time_ = start_time;
-			bar.end_time_ = start_time + time_interval;
-
-			auto symbol_interval = std::make_pair(s, t);
-			if (barseries_.find(symbol_interval) != barseries_.end())
+		push_queue(time_queue_, t);
+	}
+
+	void DataCenter::roll_bars(int t) {
+		// the timer may fire a little either side of the boundary
+		uint64_t interval = t * time_unit::NANOSECONDS_PER_SECOND;
+		uint64_t boundary = (time::now_in_nano() + interval / 2) / interval * interval;
+		for (uint32_t sid = 0; sid < bars_by_id_.size(); ++sid) {
+			// an id interned outside the configured securities has neither
+			// rows nor stores, the ones after it still roll
+			if (!bar_matrix_.has(sid) || bars_by_id_[sid].empty())
+				continue;
+
+			done_bars_.clear();
+			bar_matrix_.onTime(sid, boundary, done_bars_);
+			publish_bars(sid, boundary);
+		}
+	}
+
+	void DataCenter::publish_bars(uint32_t sid, uint64_t now) {
+		const string& symbol = SymbolRegistry::instance().symbol(sid);
+		for (size_t r : done_bars_) {
+			size_t slot = bar_matrix_.slotOf(r);
+			const BarSpec& spec = bar_matrix_.spec(slot);
+			int interval = spec.kind_ == BarSpec::TIME ? (int)spec.size_ : 0;
+			Bar bar(symbol, interval, bar_matrix_.open(r), bar_matrix_.high(r), bar_matrix_.low(r),
+				bar_matrix_.close(r), (int)bar_matrix_.volume(r), (int)bar_matrix_.count(r));
+			bar.start_time_ = bar_matrix_.start(r);
+			bar.end_time_ = bar_matrix_.end(r);
+			string msg = bar.serialize();
+			// information bars have no interval, the spec tells them apart
+			if (spec.kind_ != BarSpec::TIME)
+				msg += SERIALIZATION_SEPARATOR + spec.str();
+			msgq_pub_->sendmsg(msg);
+			DEBUG("{}@{}:{}", spec.str(), symbol, msg);
 			{
-				BarSeries& barseries = barseries_[symbol_interval];
-				if (!barseries.bars().empty()) {
-					Bar& current_bar = barseries.bars().back();
-					msgq_pub_->sendmsg(current_bar.serialize());
-					DEBUG("{:04d}@{}:{}", t, s, current_bar.serialize());
-				}
-				barseries.bars().push_back(bar);
+				std::lock_guard lock(bars_mutex_);
+				bars_by_id_[sid][slot]->push(BarRecord{ bar_matrix_.start(r), bar_matrix_.end(r), bar_matrix_.open(r), bar_matrix_.high(r),
+					bar_matrix_.low(r), bar_matrix_.close(r), bar_matrix_.volume(r), bar_matrix_.count(r) });
 			}
 
+			bar_matrix_.roll(r, now);
 		}
-
 	}
 
 	void DataCenter::register_signal_callback(SignalCallback signal_callback)
@@ -233,24 +385,46 @@ namespace MR::DC {
 
 	void DataCenter::time_come() {
 		auto now_in_nano = time::now_in_nano();
-		for (auto& t : time_intervals_) {
+		for (auto& spec : bar_specs_) {
 
 		}
 
 	}
 	
+	// a full queue holds the feed back until the DataCenter thread catches up,
+	// losing a trade would leave the bars wrong
+	template<typename T>
+	void DataCenter::push_queue(MR::Component::MpscQueue<T>& q, const T& v) {
+		while (!q.try_push(v)) {
+			if (!running_)
+				return;
+			queue_waiter_.notify();
+			std::this_thread::yield();
+		}
+		queue_waiter_.notify();
+	}
+
 	void DataCenter::push_bar(Bar* b) {
 		if (b == nullptr || !b->isValid()) return;
-		std::lock_guard lock(bar_queue_mutex_);
-		bool is_notify = bar_queue_.empty();
-		bar_queue_.push(b);
-		//if (is_notify) bar_queue_cv_.notify_one();
+		push_queue(bar_queue_, b);
 	}
 
 	void DataCenter::push_tick(Tick t) {
-		std::lock_guard lock(tick_queue_mutex_);
-		tick_queue_.push(t);
+		BinaryTick k;
+		k.sid_ = SymbolRegistry::instance().id(t.fullsymbol_);
+		if (k.sid_ == SymbolRegistry::INVALID_ID)
+			return;
+		k.recv_time_ = t.data_time_;
+		k.exchange_time_ = 0;
+		k.price_ = t.price_;
+		k.size_ = t.size_;
+		k.datatype_ = (int32_t)t.datatype_;
+		k.reserved_ = 0;
+		push_tick(k);
+	}
 
+	void DataCenter::push_tick(const BinaryTick& t) {
+		push_queue(tick_queue_, t);
 	}
 }
 
@@ -6,7 +6,16 @@
 #include "Common/Security/security.h"
 #include "Common/Data/bar.h"
 #include "Common/Data/barseries.h"
+#include "DataCenter/symbolregistry.h"
+#include "DataCenter/binarytick.h"
+#include "DataCenter/orderbook.h"
+#include "DataCenter/barmatrix.h"
+#include "DataCenter/barstore.h"
+#include "DataCenter/quoteboard.h"
 #include "Components/frame_timer.h"
+#include "Components/latencytrace.h"
+#include "Components/mpscqueue.h"
+#include "Components/adaptivewaiter.h"
 #include "Common/Util/pair_hash.h"
 #include "Common/Logger/spdlogger.h"
 
@@ -63,50 +72,80 @@ namespace MR::DC
 		void iteration();
 		void clear();
 		void onTick(Tick& k);
+		void onTick(const BinaryTick& k);
 		void onBar(Bar* k);
+		// apply a market depth operation to the book of the symbol and publish it as a BookDelta
+		void onMarketDepth(uint32_t sid, int position, int operation, int side, double price, int size);
+		// consistent copy of the book of the symbol, false for a symbol without one
+		bool book(uint32_t sid, OrderBook& snapshot);
+		// copy of the bars of the symbol and spec that start in [from, to), oldest
+		// first, read from disk for the ones out of memory; false for no such bars
+		bool bars(uint32_t sid, const BarSpec& spec, uint64_t from, uint64_t to, vector<BarRecord>& out);
 		void onTime(int t); // t means t seconds of interval 
 		void register_signal_callback(SignalCallback handler);
 		//producer push Bar into Bar Que
 		void push_bar(Bar* b);
 		void push_tick(Tick t);
-		//buffer for the latest tick
-		std::map<string, FullTick> latest_quotes_;
+		void push_tick(const BinaryTick& t);
+		// latest quote of a symbol, from any thread without a lock; false for a
+		// symbol that is not subscribed
+		bool quote(uint32_t sid, Quote& q) const { return quotes_.read(sid, q); }
+		bool quote(const string& fullsymbol, Quote& q) const;
+		// the latest quote of every symbol, by SymbolRegistry id
+		void quotes(vector<Quote>& out) const { quotes_.snapshot(out); }
 	private:
 		unique_ptr<FrameTimer> timer_ptr_;
-		queue<int> time_queue_;
 		bool quit_;
 		//std::unique_ptr<TaskScheduler> scheduler_;
 		static volatile std::sig_atomic_t signal_received_;
 		vector<SignalCallback> signal_callbacks_;
 		static void signal_handler(int signal);
 		void time_come();
-		void tick_update_bar(const Tick& tick);
+		// parse the bars setting into bar_specs_, dropping what BarMatrix cannot form
+		void load_bar_specs();
+		void tick_update_bar(const BinaryTick& tick);
+		// the finest time bars end on the boundary of the interval nearest to now
+		void roll_bars(int interval);
+		// publish the bars in done_bars_ of the symbol, keep them and start the next ones at now
+		void publish_bars(uint32_t sid, uint64_t now);
+		// log and publish the tick path latencies every latency_report_secs
+		void report_latency(uint64_t now);
+		uint64_t last_latency_report_ = 0;
+		string latency_msg_;
 
 		// securities configed in config file
 		std::map<std::string, Security> securityDetails_;
-		// predefined time intervals
-		vector<int> time_intervals_ = { 60,180,900,3600 };
+		// bars formed, from the bars setting; sorted, so the finest of a kind comes first
+		vector<BarSpec> bar_specs_;
 
 		//std::unordered_map<std::pair<string, int>, Bar, pair_hash> bars_;
-		std::unordered_map<std::pair<string, int>, BarSeries, pair_hash> barseries_;
+		// bars being formed, by SymbolRegistry id and position in bar_specs_
+		BarMatrix bar_matrix_;
+		vector<size_t> done_bars_;		// reused for the rows BarMatrix reports done
 		
 		std::map<string, Bar> latest_bars_;
 
-
-		std::mutex tick_queue_mutex_;
-		std::condition_variable tick_queue_cv_;
-
-		//Tick input Queue
-		std::queue<Tick> tick_queue_;
-		//Tick Cache Queue
-		std::queue<Tick> tick_swap_queue_;
-
-		std::mutex bar_queue_mutex_;
-		std::condition_variable bar_queue_cv_;
-		//5s Bar input Queue
-		std::queue<Bar*> bar_queue_;
-		//5s Bar Cache Queue
-		std::queue<Bar*> bar_swap_queue_;
+		// written by the feed threads, read by everyone
+		QuoteBoard quotes_;
+		// bars that are done, by SymbolRegistry id and position in bar_specs_;
+		// the newest bar_memory of each in memory, the rest in data_dir/bars
+		vector<vector<unique_ptr<BarStore>>> bars_by_id_;
+		std::mutex bars_mutex_;
+
+		// one book per SymbolRegistry id, updated by the feed and copied out by book()
+		vector<OrderBook> books_;
+		std::mutex book_mutex_;
+		string book_delta_msg_;			// reused for BookDelta messages
+
+		// trades and 5s bars from the feed threads and bar intervals that are up
+		// from the timer; the DataCenter thread is woken by the first push and
+		// drains them in batches, it alone touches the bars
+		MR::Component::MpscQueue<BinaryTick> tick_queue_;
+		MR::Component::MpscQueue<Bar*> bar_queue_;
+		MR::Component::MpscQueue<int> time_queue_;
+		MR::Component::AdaptiveWaiter queue_waiter_;
+		template<typename T>
+		void push_queue(MR::Component::MpscQueue<T>& q, const T& v);
 		unique_ptr<std::thread> thread_;
 		bool running_;
 	};
@@ -0,0 +1,58 @@
+#include "DataCenter/orderbook.h"
+
+namespace MR::DC {
+	void OrderBook::clear() {
+		std::memset(levels_, 0, sizeof(levels_));
+		depth_[SIDE_ASK] = depth_[SIDE_BID] = 0;
+		total_size_[SIDE_ASK] = total_size_[SIDE_BID] = 0;
+		seq_ = 0;
+	}
+
+	bool OrderBook::apply(int position, int operation, int side, double price, int64_t size) {
+		if ((side != SIDE_ASK && side != SIDE_BID) || position < 0 || position >= BOOK_DEPTH)
+			return false;
+
+		BookLevel* levels = levels_[side];
+		int32_t& depth = depth_[side];
+
+		switch (operation) {
+		case OP_INSERT:
+			if (position > depth)
+				return false;
+			if (depth == BOOK_DEPTH) {
+				// the last level falls off the ladder
+				total_size_[side] -= levels[BOOK_DEPTH - 1].size_;
+				--depth;
+			}
+			std::memmove(&levels[position + 1], &levels[position], (depth - position) * sizeof(BookLevel));
+			++depth;
+			break;
+		case OP_UPDATE:
+			if (position > depth)
+				return false;
+			if (position == depth)
+				++depth;			// update of the level behind the last one adds it
+			else
+				total_size_[side] -= levels[position].size_;
+			break;
+		case OP_DELETE:
+			if (position >= depth)
+				return false;
+			total_size_[side] -= levels[position].size_;
+			std::memmove(&levels[position], &levels[position + 1], (depth - position - 1) * sizeof(BookLevel));
+			--depth;
+			levels[depth].price_ = 0;
+			levels[depth].size_ = 0;
+			++seq_;
+			return true;
+		default:
+			return false;
+		}
+
+		levels[position].price_ = price;
+		levels[position].size_ = size;
+		total_size_[side] += size;
+		++seq_;
+		return true;
+	}
+}
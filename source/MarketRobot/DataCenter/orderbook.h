@@ -0,0 +1,68 @@
+#ifndef _MarketRobot_DataCenter_OrderBook_H_
+#define _MarketRobot_DataCenter_OrderBook_H_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+namespace MR::DC
+{
+	const int BOOK_DEPTH = 10;			// levels kept per side, what subscribeMarketDepth asks for
+
+	struct BookLevel {
+		double price_;
+		int64_t size_;
+	};
+
+	/// OrderBook
+	/// fixed-depth price ladder of one security, rebuilt from the position based
+	/// insert/update/delete operations of IB market depth. Both sides live in
+	/// plain arrays inside the object, so applying an operation touches a few
+	/// cache lines and a copy of the book is a memcpy.
+	class OrderBook {
+	public:
+		enum Side { SIDE_ASK = 0, SIDE_BID = 1 };
+		enum Operation { OP_INSERT = 0, OP_UPDATE = 1, OP_DELETE = 2 };
+
+		OrderBook() { clear(); }
+		void clear();
+
+		// false when the operation does not fit the book, which is left as is
+		bool apply(int position, int operation, int side, double price, int64_t size);
+
+		int depth(int side) const { return depth_[side]; }
+		const BookLevel& level(int side, int position) const { return levels_[side][position]; }
+		// zero price and size when the side is empty
+		const BookLevel& best(int side) const { return levels_[side][0]; }
+		int64_t totalSize(int side) const { return total_size_[side]; }
+		uint64_t seq() const { return seq_; }
+
+	private:
+		BookLevel levels_[2][BOOK_DEPTH];
+		int32_t depth_[2];
+		int64_t total_size_[2];
+		uint64_t seq_;						// operations applied since the book was cleared
+	};
+
+	static_assert(std::is_trivially_copyable<OrderBook>::value, "OrderBook snapshots are plain copies");
+
+	/// BookDelta
+	/// one applied depth operation as published by the DataCenter; seq_ lets a
+	/// subscriber spot a gap and ask for a snapshot instead.
+	struct BookDelta {
+		uint64_t recv_time_;		// nanoseconds since epoch at arrival
+		uint64_t seq_;				// book sequence number after the operation
+		double price_;
+		int32_t size_;
+		uint32_t sid_;				// SymbolRegistry id
+		int8_t position_;
+		int8_t operation_;			// OrderBook::Operation
+		int8_t side_;				// OrderBook::Side
+		int8_t reserved_[5];
+	};
+
+	static_assert(std::is_trivially_copyable<BookDelta>::value, "BookDelta is copied as raw bytes");
+	static_assert(sizeof(BookDelta) == 40, "BookDelta layout is part of the wire format");
+}
+#endif // _MarketRobot_DataCenter_OrderBook_H_
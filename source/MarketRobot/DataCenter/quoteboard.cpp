@@ -0,0 +1,19 @@
+#include "DataCenter/quoteboard.h"
+
+namespace MR::DC {
+	void QuoteBoard::reset(size_t n) {
+		slots_.reset(n > 0 ? new Slot[n] : nullptr);
+		size_ = n;
+		for (size_t i = 0; i < n; ++i) {
+			slots_[i].seq_.store(0, std::memory_order_relaxed);
+			for (size_t w = 0; w < WORDS; ++w)
+				slots_[i].words_[w].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	void QuoteBoard::snapshot(std::vector<Quote>& out) const {
+		out.resize(size_);
+		for (size_t i = 0; i < size_; ++i)
+			read((uint32_t)i, out[i]);
+	}
+}
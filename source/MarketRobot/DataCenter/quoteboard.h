@@ -0,0 +1,117 @@
+#ifndef _MarketRobot_DataCenter_QuoteBoard_H_
+#define _MarketRobot_DataCenter_QuoteBoard_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace MR::DC
+{
+	/// latest level 1 quote and trade of a symbol
+	struct Quote {
+		uint64_t time_;			// arrival of the last update, nanoseconds since epoch
+		double price_;			// last trade
+		double bidprice_;
+		double askprice_;
+		int32_t size_;
+		int32_t bidsize_;
+		int32_t asksize_;
+		int32_t reserved_;
+	};
+
+	static_assert(std::is_trivially_copyable<Quote>::value, "Quote is copied as words");
+	static_assert(sizeof(Quote) % sizeof(uint64_t) == 0, "Quote is copied as words");
+
+	/// QuoteBoard
+	/// the latest Quote of every symbol, one cache line per SymbolRegistry id.
+	/// A slot is written by one thread at a time, the feed of its symbol, under
+	/// a sequence lock: the sequence is odd while the quote is being written
+	/// and readers retry until they copied it between two equal even values.
+	/// Readers take no lock and write nothing shared, so they cannot hold up
+	/// the feed; the feed does not wait for anyone.
+	///
+	/// reset() allocates the slots and must not run while the board is used.
+	class QuoteBoard {
+	public:
+		// n empty quotes, for ids 0 to n - 1
+		void reset(size_t n);
+		size_t size() const { return size_; }
+
+		// writer of the symbol
+		void setBid(uint32_t sid, double price, int32_t size, uint64_t time) {
+			write(sid, [&](Quote& q) { q.bidprice_ = price; q.bidsize_ = size; q.time_ = time; });
+		}
+		void setAsk(uint32_t sid, double price, int32_t size, uint64_t time) {
+			write(sid, [&](Quote& q) { q.askprice_ = price; q.asksize_ = size; q.time_ = time; });
+		}
+		void setTrade(uint32_t sid, double price, int32_t size, uint64_t time) {
+			write(sid, [&](Quote& q) { q.price_ = price; q.size_ = size; q.time_ = time; });
+		}
+		void set(uint32_t sid, const Quote& quote) {
+			write(sid, [&](Quote& q) { q = quote; });
+		}
+
+		// any thread; false for an id without a slot
+		bool read(uint32_t sid, Quote& q) const {
+			if (sid >= size_)
+				return false;
+			const Slot& s = slots_[sid];
+			uint64_t words[WORDS];
+			for (;;) {
+				uint64_t seq = s.seq_.load(std::memory_order_acquire);
+				if (seq & 1) {
+					std::this_thread::yield();
+					continue;
+				}
+				for (size_t w = 0; w < WORDS; ++w)
+					words[w] = s.words_[w].load(std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (s.seq_.load(std::memory_order_relaxed) == seq)
+					break;
+			}
+			std::memcpy(&q, words, sizeof(Quote));
+			return true;
+		}
+		// any thread; every quote, by id, each of them whole
+		void snapshot(std::vector<Quote>& out) const;
+
+	private:
+		static const size_t WORDS = sizeof(Quote) / sizeof(uint64_t);
+		struct alignas(64) Slot {
+			std::atomic<uint64_t> seq_;
+			std::atomic<uint64_t> words_[WORDS];
+		};
+		static_assert(sizeof(Slot) == 64, "a slot is one cache line");
+
+		std::unique_ptr<Slot[]> slots_;
+		size_t size_ = 0;
+
+		template<typename F>
+		void write(uint32_t sid, F&& f) {
+			if (sid >= size_)
+				return;
+			Slot& s = slots_[sid];
+			uint64_t words[WORDS];
+			// the slot holds what this thread wrote last
+			for (size_t w = 0; w < WORDS; ++w)
+				words[w] = s.words_[w].load(std::memory_order_relaxed);
+			Quote q;
+			std::memcpy(&q, words, sizeof(Quote));
+			f(q);
+			std::memcpy(words, &q, sizeof(Quote));
+
+			uint64_t seq = s.seq_.load(std::memory_order_relaxed);
+			s.seq_.store(seq + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			for (size_t w = 0; w < WORDS; ++w)
+				s.words_[w].store(words[w], std::memory_order_relaxed);
+			s.seq_.store(seq + 2, std::memory_order_release);
+		}
+	};
+}
+#endif // _MarketRobot_DataCenter_QuoteBoard_H_
@@ -0,0 +1,83 @@
+#include "DataCenter/symbolregistry.h"
+
+namespace MR::DC {
+	SymbolRegistry* SymbolRegistry::pinstance_ = nullptr;
+	std::mutex SymbolRegistry::instancelock_;
+
+	SymbolRegistry& SymbolRegistry::instance() {
+		if (pinstance_ == nullptr) {
+			std::lock_guard<std::mutex> g(instancelock_);
+			if (pinstance_ == nullptr) {
+				pinstance_ = new SymbolRegistry();
+			}
+		}
+		return *pinstance_;
+	}
+
+	SymbolRegistry::Table::Table(size_t capacity)
+		: mask_(capacity - 1), slots_(new std::atomic<uint32_t>[capacity]) {
+		for (size_t i = 0; i < capacity; ++i)
+			slots_[i].store(0, std::memory_order_relaxed);
+	}
+
+	SymbolRegistry::SymbolRegistry() : size_(0) {
+		for (auto& c : chunks_)
+			c.store(nullptr, std::memory_order_relaxed);
+		tables_.push_back(std::make_unique<Table>(1024));
+		table_.store(tables_.back().get(), std::memory_order_release);
+	}
+
+	void SymbolRegistry::insert(const Table& t, uint32_t id) const {
+		size_t i = std::hash<std::string>()(symbol(id)) & t.mask_;
+		while (t.slots_[i].load(std::memory_order_relaxed) != 0)
+			i = (i + 1) & t.mask_;
+		t.slots_[i].store(id + 1, std::memory_order_release);
+	}
+
+	uint32_t SymbolRegistry::intern(const std::string& fullsymbol) {
+		std::lock_guard<std::mutex> g(mutex_);
+		uint32_t id = this->id(fullsymbol);
+		if (id != INVALID_ID)
+			return id;
+
+		id = size_.load(std::memory_order_relaxed);
+		if (id >= MAX_SYMBOLS)
+			return INVALID_ID;
+		std::string* chunk = chunks_[id / CHUNK].load(std::memory_order_relaxed);
+		if (chunk == nullptr) {
+			chunk = new std::string[CHUNK];
+			chunks_[id / CHUNK].store(chunk, std::memory_order_release);
+		}
+		chunk[id % CHUNK] = fullsymbol;
+
+		// at half full the table is doubled into a new one, readers move over
+		// when it is published and those still in the old one find all but this id
+		const Table* t = table_.load(std::memory_order_relaxed);
+		if (2 * (size_t)(id + 1) > t->mask_ + 1) {
+			tables_.push_back(std::make_unique<Table>(2 * (t->mask_ + 1)));
+			t = tables_.back().get();
+			for (uint32_t i = 0; i < id; ++i)
+				insert(*t, i);
+			table_.store(t, std::memory_order_release);
+		}
+		insert(*t, id);
+		size_.store(id + 1, std::memory_order_release);
+		return id;
+	}
+
+	uint32_t SymbolRegistry::id(const std::string& fullsymbol) const {
+		const Table* t = table_.load(std::memory_order_acquire);
+		size_t i = std::hash<std::string>()(fullsymbol) & t->mask_;
+		for (;; i = (i + 1) & t->mask_) {
+			uint32_t v = t->slots_[i].load(std::memory_order_acquire);
+			if (v == 0)
+				return INVALID_ID;
+			if (symbol(v - 1) == fullsymbol)
+				return v - 1;
+		}
+	}
+
+	const std::string& SymbolRegistry::symbol(uint32_t id) const {
+		return chunks_[id / CHUNK].load(std::memory_order_acquire)[id % CHUNK];
+	}
+}
@@ -0,0 +1,64 @@
+#ifndef _MarketRobot_DataCenter_SymbolRegistry_H_
+#define _MarketRobot_DataCenter_SymbolRegistry_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <vector>
+#include <mutex>
+
+namespace MR::DC
+{
+	/// SymbolRegistry
+	/// interns full symbols into dense ids 0, 1, 2... so the market data path
+	/// carries and indexes by a uint32 instead of copying and hashing strings.
+	/// Symbols are interned when they are subscribed; the data path then only
+	/// looks them up by id.
+	///
+	/// Lookups take no lock, they run on every tick a text feed brings in.
+	/// intern() is serialized and publishes a symbol before its id, so a reader
+	/// finds either nothing or a symbol that is all there. Neither the symbols
+	/// nor the id tables are ever moved or freed.
+	class SymbolRegistry {
+	public:
+		static const uint32_t INVALID_ID = UINT32_MAX;
+
+		static SymbolRegistry& instance();
+
+		// id of the symbol, assigned on first use; INVALID_ID once MAX_SYMBOLS are in
+		uint32_t intern(const std::string& fullsymbol);
+		// id of a symbol interned before, INVALID_ID otherwise
+		uint32_t id(const std::string& fullsymbol) const;
+		// id must come from intern() or id()
+		const std::string& symbol(uint32_t id) const;
+		uint32_t size() const { return size_.load(std::memory_order_acquire); }
+
+	private:
+		static const uint32_t CHUNK = 1024;
+		static const uint32_t CHUNKS = 4096;
+		static const uint32_t MAX_SYMBOLS = CHUNK * CHUNKS;
+
+		// open addressing, a slot holds id + 1 and 0 when empty
+		struct Table {
+			size_t mask_;
+			std::unique_ptr<std::atomic<uint32_t>[]> slots_;
+			explicit Table(size_t capacity);
+		};
+
+		SymbolRegistry();
+		static SymbolRegistry* pinstance_;
+		static std::mutex instancelock_;
+
+		void insert(const Table& t, uint32_t id) const;
+
+		std::mutex mutex_;		// serializes intern()
+		std::atomic<uint32_t> size_;
+		// symbols in chunks of CHUNK, a chunk is never moved once there
+		std::atomic<std::string*> chunks_[CHUNKS];
+		std::atomic<const Table*> table_;
+		// a table outgrown stays, a reader may still be probing it
+		std::vector<std::unique_ptr<Table>> tables_;
+	};
+}
+#endif // _MarketRobot_DataCenter_SymbolRegistry_H_
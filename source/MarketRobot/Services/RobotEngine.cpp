@@ -10,6 +10,8 @@
 #include "Services/Brokerage/brokerageservice.h"
 #include "Services/Api/apiservice.h"
 #include "Services/Stage/StageManager.h"
+#include "Brokers/IB981/ibbrokerage.h"
+#include "Components/latencytrace.h"
 
 #include <iostream>
 #include <string>
@@ -40,11 +42,21 @@ namespace MarketRobot
 		while ((pbrokerage && pbrokerage->isConnectedToBrokerage()) || (pmkdata && pmkdata->isConnectedToMarketDataFeed())) {
 			msleep(100);
 		}
+		for (auto& p : pmkdataShards) {
+			while (p->isConnectedToMarketDataFeed())
+				msleep(100);
+		}
 
 		while (MICRO_SERVICE_NUMBER > 0) {
 			msleep(100);
 		}
 
+		if (CConfig::instance().latency_trace) {
+			string report = MR::Component::LatencyTrace::report();
+			if (!report.empty())
+				INFO("Tick path latency:\n{}", report);
+		}
+
 		if (CConfig::instance()._msgq == MSGQ::NANOMSG)
 			nn_term();
 		else if (CConfig::instance()._msgq == MSGQ::ZMQ)
@@ -65,6 +77,15 @@ namespace MarketRobot
 		return gShutdown == true;
 	}
 
+	void RobotEngine::startMarketDataShards() {
+		for (auto& p : pmkdataShards) {
+			// a market data connection owns its socket, decoder and state machine
+			auto pib = std::dynamic_pointer_cast<IBBrokerage>(p);
+			if (pib)
+				threads.push_back(make_unique<thread>(&IBBrokerage::runReactor, pib));
+		}
+	}
+
 	int RobotEngine::run() {
 		if (gShutdown)
 			return 1;
@@ -80,6 +101,7 @@ namespace MarketRobot
 				if( pStage ){
 					pmkdata = pStage->MarketFeed();
 					pbrokerage = pStage->Brokerage();
+					pmkdataShards = pStage->pmkdataShards;
 				}
 
 				if (pmkdata && pbrokerage) {
@@ -87,9 +109,24 @@ namespace MarketRobot
 					INFO("Stage built,Music Up ...!");
 
 					//this_thread::sleep_for(std::chrono::milliseconds(1));
-					threads.push_back(make_unique<thread>(BrokerageService, pbrokerage, 0));
-					threads.push_back(make_unique<thread>(MarketDataService, pmkdata,
-						CConfig::instance().ib_client_id++));
+					auto pib = std::dynamic_pointer_cast<IBBrokerage>(pbrokerage);
+					if (!pmkdataShards.empty()) {
+						// orders on a connection of their own, never behind a burst of ticks
+						if (pib && CConfig::instance().ib_reactor)
+							threads.push_back(make_unique<thread>(&IBBrokerage::runReactor, pib));
+						else
+							threads.push_back(make_unique<thread>(BrokerageService, pbrokerage, 0));
+						startMarketDataShards();
+					}
+					else if (pib && CConfig::instance().ib_reactor) {
+						// IBBrokerage is brokerage and market data feed: one thread runs both
+						threads.push_back(make_unique<thread>(&IBBrokerage::runReactor, pib));
+					}
+					else {
+						threads.push_back(make_unique<thread>(BrokerageService, pbrokerage, 0));
+						threads.push_back(make_unique<thread>(MarketDataService, pmkdata,
+							CConfig::instance().ib_client_id++));
+					}
 
 					threads.push_back(make_unique<thread>(TickRecordingService));
 					threads.push_back(make_unique<thread>(BarRecordService));
@@ -105,13 +142,19 @@ namespace MarketRobot
 
 				if (pStage) {
 					pmkdata = pStage->MarketFeed();
+					pmkdataShards = pStage->pmkdataShards;
+					if (!pmkdataShards.empty())
+						pbrokerage = pStage->Brokerage();		// owns the msgq the shards publish on
 				}
 				if( pmkdata ){
 
 					INFO("Stage built,Record the Music ...!");
 
-					threads.push_back(make_unique<thread>(MarketDataService, pmkdata,
-						CConfig::instance().ib_client_id++));
+					if (!pmkdataShards.empty())
+						startMarketDataShards();
+					else
+						threads.push_back(make_unique<thread>(MarketDataService, pmkdata,
+							CConfig::instance().ib_client_id++));
 					threads.push_back(make_unique<thread>(TickRecordingService));
 					threads.push_back(make_unique<thread>(BarRecordService));
 				}
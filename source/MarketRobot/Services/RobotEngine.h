@@ -24,8 +24,11 @@ namespace MarketRobot
 
 		shared_ptr<marketdatafeed> pmkdata;
 		shared_ptr<brokerage> pbrokerage;
+		vector<shared_ptr<marketdatafeed>> pmkdataShards;
 
 		vector<unique_ptr<thread>> threads;
+		// one thread per market data connection of a sharded stage
+		void startMarketDataShards();
 
 	public:
 		void init() {
@@ -23,6 +23,10 @@ namespace MarketRobot {
 		// brokerage connection
 		shared_ptr<brokerage> pbrokerage;
 
+		// market data connections the securities are split over, each run on
+		// its own thread; pmkdata is the first of them
+		vector<shared_ptr<marketdatafeed>> pmkdataShards;
+
 		shared_ptr<marketdatafeed> MarketFeed() {
 			return pmkdata;
 		}
@@ -36,9 +40,28 @@ namespace MarketRobot {
 	class IbStage : public Stage {
 	public:
 		IbStage() {
-			std::shared_ptr<IBBrokerage> tmp = std::make_shared<IBBrokerage>();
-			pmkdata = tmp;
-			pbrokerage = tmp;
+			int shards = CConfig::instance().ib_md_connections;
+			if (shards <= 0) {
+				std::shared_ptr<IBBrokerage> tmp = std::make_shared<IBBrokerage>(IBRole::All, CConfig::instance().ib_client_id++);
+				pmkdata = tmp;
+				pbrokerage = tmp;
+				return;
+			}
+
+			// the configured client id takes the orders (TWS gives client 0 the
+			// orders placed in TWS too); the securities are dealt out round robin
+			// over the next shards ids, the same ones on every start
+			int clientId = CConfig::instance().ib_client_id.fetch_add(shards + 1);
+			std::shared_ptr<IBBrokerage> orders = std::make_shared<IBBrokerage>(IBRole::Orders, clientId);
+			pbrokerage = orders;
+			vector<vector<int>> tickers(shards);
+			for (int i = 0; i < (int)CConfig::instance().securities.size(); ++i)
+				tickers[i % shards].push_back(i);
+			for (int n = 0; n < shards; ++n) {
+				pmkdataShards.push_back(std::make_shared<IBBrokerage>(IBRole::MarketData,
+					clientId + n + 1, n, tickers[n], orders.get()));
+			}
+			pmkdata = pmkdataShards.front();
 		}
 	};
 
@@ -58,6 +58,18 @@ namespace MarketRobot {
 			_msgq = MSGQ::KAFKA;
 		else
 			_msgq = MSGQ::NANOMSG;
+		if (config["tick_format"])
+			binary_tick = config["tick_format"].as<std::string>() == "binary";
+		if (config["latency_trace"])
+			latency_trace = config["latency_trace"].as<bool>();
+		if (config["latency_report_secs"])
+			latency_report_secs = config["latency_report_secs"].as<int>();
+		if (config["datacenter_spin_us"])
+			datacenter_spin_us = config["datacenter_spin_us"].as<int>();
+		if (config["bars"])
+			bar_specs = config["bars"].as<std::vector<string>>();
+		if (config["bar_memory"])
+			bar_memory = config["bar_memory"].as<int>();
 		
 		// TODO: support multiple accounts; currently only the last account loop counts
 		const std::vector<string> accounts = config["accounts"].as<std::vector<string>>();
@@ -67,6 +79,36 @@ namespace MarketRobot {
 				_broker = BROKERS::IB;
 				account = s;
 				ib_port = config[s]["port"].as<long>();
+				if (config[s]["client_id"])
+					ib_client_id = config[s]["client_id"].as<int>();
+				if (config[s]["busy_poll"])
+					ib_busy_poll = config[s]["busy_poll"].as<bool>();
+				if (config[s]["reader_cpu"])
+					ib_reader_cpu = config[s]["reader_cpu"].as<int>();
+				if (config[s]["wait_strategy"])
+					ib_wait_strategy = config[s]["wait_strategy"].as<std::string>();
+				if (config[s]["msg_batch"])
+					ib_msg_batch = config[s]["msg_batch"].as<int>();
+				if (config[s]["capture_file"])
+					ib_capture_file = config[s]["capture_file"].as<std::string>();
+				if (config[s]["tick_by_tick"])
+					ib_tick_by_tick = config[s]["tick_by_tick"].as<bool>();
+				if (config[s]["backfill_days"])
+					ib_backfill_days = config[s]["backfill_days"].as<int>();
+				if (config[s]["backfill_bar_size"])
+					ib_backfill_bar_size = config[s]["backfill_bar_size"].as<int>();
+				if (config[s]["hist_inflight"])
+					ib_hist_inflight = config[s]["hist_inflight"].as<int>();
+				if (config[s]["contract_cache_hours"])
+					ib_contract_cache_hours = config[s]["contract_cache_hours"].as<int>();
+				if (config[s]["reactor"])
+					ib_reactor = config[s]["reactor"].as<bool>();
+				if (config[s]["reactor_cpu"])
+					ib_reactor_cpu = config[s]["reactor_cpu"].as<int>();
+				if (config[s]["client_poll_us"])
+					ib_client_poll_us = config[s]["client_poll_us"].as<int>();
+				if (config[s]["md_connections"])
+					ib_md_connections = config[s]["md_connections"].as<int>();
 			}
 			else if (api == "CTP") {
 				_broker = BROKERS::CTP;
@@ -86,7 +86,21 @@ namespace MarketRobot {
 		// TODO: move to brokerage
 		string ib_host = "127.0.0.1";
 		uint64_t ib_port = 7496;
-		atomic_int ib_client_id;
+		atomic_int ib_client_id{ 0 };		// next TWS client id to connect with, the configured one first
+		bool ib_busy_poll = false;			// spin on the TWS socket instead of sleeping
+		int ib_reader_cpu = -1;				// pin the EReader thread to this cpu, -1 leaves it unpinned
+		string ib_wait_strategy = "blocking";	// how the message thread waits for frames: blocking, spin_futex, spin or eventfd
+		int ib_msg_batch = 256;				// frames decoded per wake-up before the state machine runs again
+		string ib_capture_file;				// record the inbound TWS stream here for replay, empty disables
+		bool ib_tick_by_tick = false;		// AllLast and BidAsk tick-by-tick streams instead of reqMktData snapshots
+		int ib_backfill_days = 0;			// days of historical bars downloaded into data_dir/hist on connect, 0 disables
+		int ib_backfill_bar_size = 5;		// seconds
+		int ib_hist_inflight = 50;			// historical requests in flight, IB allows 50
+		int ib_contract_cache_hours = 24;	// contract details cached in data_dir let a restart subscribe at once, 0 disables
+		bool ib_reactor = false;			// one thread runs the TWS connection, callbacks and both state machines
+		int ib_reactor_cpu = -1;			// pin the reactor thread to this cpu, -1 leaves it unpinned
+		int ib_client_poll_us = 100;		// reactor mode: client requests are polled this often while none come
+		int ib_md_connections = 0;			// market data connections the securities are split over, besides one for orders; 0 shares one connection
 
 		string account = "DU448830";
 		string filetoreplay = "";
@@ -108,8 +122,17 @@ namespace MarketRobot {
 		string BAR_AGGREGATOR_PUBSUB_PORT = "55557";		// bar from aggregation service
 		string API_PORT = "55558";							// client port
 		string API_ZMQ_DATA_PORT = "55559";					// client port
+		bool binary_tick = false;			// publish ticks as fixed-layout BinaryTick structs instead of text, the DataCenter takes them in-process
+		bool latency_trace = false;			// per-stage latency histograms of the tick path
+		int latency_report_secs = 60;		// how often the histograms are logged and published
+		int datacenter_spin_us = 50;		// the bar thread polls this long for ticks before it sleeps, 0 sleeps at once
+		vector<string> bar_specs = { "1m", "3m", "15m", "1h" };	// bars formed by DataCenter: time (30s, 1m, 4h), trades (500t), shares (10000v) or dollars (1000000$)
+		int bar_memory = 2048;				// bars of a symbol and spec held in memory, the older ones are in data_dir/bars
 				
 		string tick_msg = "k";
+		string binary_tick_msg = "t";
+		string book_msg = "d";				// BookDelta of a market depth update
+		string latency_msg = "l";			// latency trace report
 		string last_price_msg = "p";
 		string last_size_msg = "z";
 		string bar_msg = "b";
@@ -0,0 +1,259 @@
+// TWS decoder micro-benchmark: ns/message, messages/sec and heap allocations
+// per message for every EDecoder message path found in the corpus, then for
+// the whole parseAndProcessMsg loop.
+//
+//     bench_edecoder [capture file]
+//
+// The corpus is a capture recorded with EReader::startCapture (ib
+// capture_file in the config) or, without one, a built-in set of frames:
+// tick price/size, tick-by-tick, market depth, real-time bars, order status,
+// open order, execution details and contract details.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "StdAfx.h"
+#include "EDecoder.h"
+#include "ECapture.h"
+#include "DefaultEWrapper.h"
+#if defined(BENCH_IBBROKERAGE)
+#include "Brokers/IB981/ibbrokerage.h"
+#endif
+
+using namespace std;
+
+// every heap allocation made by the benchmarked code goes through here
+static size_t gAllocs = 0;
+
+void* operator new(size_t sz)
+{
+	++gAllocs;
+	if (void* p = malloc(sz ? sz : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t sz)
+{
+	return operator new(sz);
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+struct Frame
+{
+	int msgId;
+	string payload;			// frame without its length prefix
+};
+
+static const double MIN_SECONDS = 0.2;		// time spent on each path
+
+static const char* msgName(int msgId)
+{
+	switch (msgId) {
+	case TICK_PRICE: return "TICK_PRICE";
+	case TICK_SIZE: return "TICK_SIZE";
+	case ORDER_STATUS: return "ORDER_STATUS";
+	case ERR_MSG: return "ERR_MSG";
+	case OPEN_ORDER: return "OPEN_ORDER (EOrderDecoder)";
+	case ACCT_VALUE: return "ACCT_VALUE";
+	case PORTFOLIO_VALUE: return "PORTFOLIO_VALUE";
+	case NEXT_VALID_ID: return "NEXT_VALID_ID";
+	case CONTRACT_DATA: return "CONTRACT_DATA";
+	case EXECUTION_DATA: return "EXECUTION_DATA";
+	case MARKET_DEPTH: return "MARKET_DEPTH";
+	case MARKET_DEPTH_L2: return "MARKET_DEPTH_L2";
+	case HISTORICAL_DATA: return "HISTORICAL_DATA";
+	case REAL_TIME_BARS: return "REAL_TIME_BARS";
+	case COMMISSION_REPORT: return "COMMISSION_REPORT";
+	case POSITION_DATA: return "POSITION_DATA";
+	case TICK_GENERIC: return "TICK_GENERIC";
+	case TICK_STRING: return "TICK_STRING";
+	case TICK_REQ_PARAMS: return "TICK_REQ_PARAMS";
+	case TICK_BY_TICK: return "TICK_BY_TICK";
+	case COMPLETED_ORDER: return "COMPLETED_ORDER (EOrderDecoder)";
+	default: return 0;
+	}
+}
+
+static Frame makeFrame(int msgId, const vector<string>& fields, int padding = 0)
+{
+	Frame f;
+	f.msgId = msgId;
+	f.payload = to_string(msgId);
+	f.payload.push_back('\0');
+	for (const string& field : fields) {
+		f.payload += field;
+		f.payload.push_back('\0');
+	}
+	// "0" reads as an empty count, a zero number or a short string, so the
+	// remaining fields of a long message decode without taking any branch
+	for (int i = 0; i < padding; ++i)
+		f.payload.append("0", 2);
+	return f;
+}
+
+static void builtinCorpus(vector<Frame>& corpus)
+{
+	static const char* prices[] = { "24501.5", "24502", "24500.5", "24503" };
+	static const char* priceTypes[] = { "1", "2", "4" };		// bid, ask, last
+
+	for (int i = 0; i < 400; ++i) {
+		string id = to_string(i % 4);
+		string price = prices[i % 4];
+		string size = to_string(1 + i % 17);
+
+		corpus.push_back(makeFrame(TICK_PRICE, { "6", id, priceTypes[i % 3], price, size, "0" }));
+		corpus.push_back(makeFrame(TICK_SIZE, { "6", id, "8", to_string(12000 + i) }));
+		corpus.push_back(makeFrame(TICK_BY_TICK, { id, "1", to_string(1602324000 + i), price, size, "0", "HKFE", "" }));
+		corpus.push_back(makeFrame(TICK_BY_TICK, { id, "3", to_string(1602324000 + i), prices[(i + 1) % 4], prices[(i + 2) % 4], size, "3", "0" }));
+		corpus.push_back(makeFrame(MARKET_DEPTH, { "1", to_string(2000 + i % 4), to_string(i % 5), "1", to_string(i % 2), price, size }));
+		if (i % 8 == 0)
+			corpus.push_back(makeFrame(REAL_TIME_BARS, { "3", to_string(1000 + i % 4), to_string(1602324000 + i * 5), "24501", "24505.5", "24499", "24503", "57", "24502.25", "31" }));
+	}
+
+	corpus.push_back(makeFrame(ORDER_STATUS, { "17", "Submitted", "0", "1", "0", "1907301911", "0", "0", "0", "", "0" }));
+	corpus.push_back(makeFrame(ORDER_STATUS, { "17", "Filled", "1", "0", "24503", "1907301911", "0", "24503", "0", "", "0" }));
+
+	corpus.push_back(makeFrame(OPEN_ORDER, { "17", "387012353", "HSI", "FUT", "20201029", "0", "?", "50", "HKFE", "HKD",
+		"HSIV0", "HSI", "BUY", "1", "LMT", "24503", "0", "DAY", "", "DU1713512", "", "0", "", "0", "1907301911",
+		"0", "0", "0", "" }, 200));
+
+	corpus.push_back(makeFrame(EXECUTION_DATA, { "-1", "17", "387012353", "HSI", "FUT", "20201029", "0", "", "50", "HKFE",
+		"HKD", "HSIV0", "HSI", "0000e1a7.5f7e9b42.01.01", "20201010  10:00:01", "DU1713512", "HKFE", "BOT", "1",
+		"24503", "1907301911", "0", "0", "1", "24503", "", "", "", "", "2" }));
+
+	corpus.push_back(makeFrame(CONTRACT_DATA, { "8", "4001", "HSI", "FUT", "20201029", "0", "", "HKFE", "HKD", "HSIV0",
+		"HSI", "HSI", "387012353", "1", "1", "50", "ACTIVETIM,AD,ADJUST,ALERT,ALGO,ALLOC,AVGCOST,BASKET,DAY,DEACT,GAT,GTC,GTD,LIT,LMT,MIT,MKT,NONALGO,OCA,SCALE,STP,STPLMT,TRAIL",
+		"HKFE", "1", "0", "Hang Seng Stock Index", "", "202010", "", "", "Asia/Hong_Kong",
+		"20201010:0915-20201010:1200;20201010:1300-20201010:1630", "20201010:0915-20201010:1630" }, 200));
+}
+
+// Decode every frame once and cut the padding behind the last field read;
+// frames the decoder cannot parse are dropped.
+static void trimCorpus(vector<Frame>& corpus, int serverVersion)
+{
+	DefaultEWrapper wrapper;
+	EDecoder decoder(serverVersion, &wrapper);
+	size_t n = 0;
+
+	for (Frame& f : corpus) {
+		const char* beginPtr = f.payload.data();
+		int processed = decoder.parseAndProcessMsg(beginPtr, beginPtr + f.payload.size());
+
+		if (processed <= 0) {
+			printf("dropping malformed %s frame\n", msgName(f.msgId) ? msgName(f.msgId) : to_string(f.msgId).c_str());
+			continue;
+		}
+
+		f.payload.resize(processed);
+		corpus[n++] = f;
+	}
+
+	corpus.resize(n);
+}
+
+static bool loadCapture(const char* path, vector<Frame>& corpus, int& serverVersion)
+{
+	ECaptureReader capture;
+	if (!capture.open(path))
+		return false;
+
+	serverVersion = capture.serverVersion();
+
+	size_t pos = 0;
+	uint64_t timestamp;
+	const char* beginPtr;
+	const char* endPtr;
+
+	while (capture.next(pos, timestamp, beginPtr, endPtr)) {
+		Frame f;
+		f.msgId = atoi(beginPtr);
+		f.payload.assign(beginPtr, endPtr);
+		corpus.push_back(f);
+	}
+
+	return true;
+}
+
+// Decode the frames in a loop for at least MIN_SECONDS and print one line.
+static void run(const char* name, const vector<const Frame*>& frames, int serverVersion, EWrapper* wrapper)
+{
+	EDecoder decoder(serverVersion, wrapper);
+
+	using std::chrono::steady_clock;
+	size_t nMsgs = 0;
+	size_t allocs = gAllocs;
+	steady_clock::time_point start = steady_clock::now();
+	double secs = 0;
+
+	do {
+		for (const Frame* f : frames) {
+			const char* beginPtr = f->payload.data();
+			decoder.parseAndProcessMsg(beginPtr, beginPtr + f->payload.size());
+		}
+		nMsgs += frames.size();
+		secs = std::chrono::duration<double>(steady_clock::now() - start).count();
+	} while (secs < MIN_SECONDS);
+
+	allocs = gAllocs - allocs;
+
+	printf("%-40s %8.1f ns/msg %12.0f msgs/s %8.2f allocs/msg\n",
+		name, secs * 1e9 / nMsgs, nMsgs / secs, (double)allocs / nMsgs);
+}
+
+int main(int argc, char* argv[])
+{
+	vector<Frame> corpus;
+	int serverVersion = MAX_CLIENT_VER;
+
+	if (argc > 1) {
+		if (!loadCapture(argv[1], corpus, serverVersion)) {
+			printf("cannot read capture %s\n", argv[1]);
+			return 1;
+		}
+		printf("corpus: %s, server version %d\n", argv[1], serverVersion);
+	}
+	else {
+		builtinCorpus(corpus);
+		printf("corpus: built-in, server version %d\n", serverVersion);
+	}
+
+	trimCorpus(corpus, serverVersion);
+
+	map<int, vector<const Frame*> > paths;
+	vector<const Frame*> all;
+	for (const Frame& f : corpus) {
+		paths[f.msgId].push_back(&f);
+		all.push_back(&f);
+	}
+
+	printf("%zu frames, %zu message types\n\n", all.size(), paths.size());
+
+	DefaultEWrapper noop;
+
+	for (auto& path : paths) {
+		const char* name = msgName(path.first);
+		string label = name ? name : "msg " + to_string(path.first);
+		label += " x" + to_string(path.second.size());
+		run(label.c_str(), path.second, serverVersion, &noop);
+	}
+
+	printf("\n");
+	run("parseAndProcessMsg, no-op EWrapper", all, serverVersion, &noop);
+
+#if defined(BENCH_IBBROKERAGE)
+	MarketRobot::IBBrokerage brokerage;
+	run("parseAndProcessMsg, IBBrokerage", all, serverVersion, &brokerage);
+#endif
+
+	return 0;
+}
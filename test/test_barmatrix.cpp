@@ -0,0 +1,157 @@
+// BarMatrix: trades into bars, the coarser bars of a kind, rolling on the
+// clock, and bars reaching the BarStore of every symbol past one without any
+#include "DataCenter/barmatrix.h"
+#include "DataCenter/barstore.h"
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+using namespace MR::DC;
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+static const uint64_t SEC = 1000000000ULL;
+
+static std::vector<BarSpec> specs(std::vector<const char*> names)
+{
+	std::vector<BarSpec> v;
+	for (const char* n : names) {
+		BarSpec s;
+		CHECK(BarSpec::parse(n, s));
+		v.push_back(s);
+	}
+	return v;
+}
+
+void testParse()
+{
+	BarSpec s;
+	CHECK(BarSpec::parse("90s", s) && s.kind_ == BarSpec::TIME && s.size_ == 90);
+	CHECK(BarSpec::parse("4h", s) && s.kind_ == BarSpec::TIME && s.size_ == 4 * 3600);
+	CHECK(BarSpec::parse("500t", s) && s.kind_ == BarSpec::TICK && s.str() == "500t");
+	CHECK(BarSpec::parse("2m", s) && s.str() == "2m");
+	CHECK(!BarSpec::parse("1.5s", s));
+	CHECK(!BarSpec::parse("10x", s));
+	CHECK(!BarSpec::parse("m", s));
+}
+
+void testTrades()
+{
+	BarMatrix m;
+	m.reset(specs({ "1m", "3t", "6t" }));
+	m.addSymbol(0, 1000 * SEC);
+	std::vector<size_t> done;
+
+	double prices[] = { 10, 12, 9, 11, 13, 8 };
+	std::vector<size_t> slots;
+	size_t t3 = m.row(0, 1), t6 = m.row(0, 2);
+	for (int i = 0; i < 6; ++i) {
+		done.clear();
+		m.onTrade(0, prices[i], 1, (1000 + i) * SEC, done);
+		for (size_t r : done)
+			slots.push_back(m.slotOf(r));
+		if (i == 2)
+			CHECK(m.open(t3) == 10 && m.high(t3) == 12 && m.low(t3) == 9 && m.count(t3) == 3 && m.end(t3) == 1002 * SEC);
+		if (i == 5)
+			CHECK(m.open(t6) == 10 && m.high(t6) == 13 && m.low(t6) == 8 && m.close(t6) == 8 && m.count(t6) == 6);
+		// published bars are rolled before the next trade
+		for (size_t r : done)
+			m.roll(r, (1000 + i) * SEC);
+	}
+
+	// 3t twice, 6t once with the second; the minute goes on
+	CHECK(slots.size() == 3 && slots[0] == 1 && slots[1] == 1 && slots[2] == 2);
+	CHECK(m.count(t6) == 0 && m.start(t6) == 1005 * SEC);
+	size_t min = m.row(0, 0);
+	CHECK(m.count(min) == 6 && m.volume(min) == 6 && m.value(min) == 63);
+}
+
+void testTimeRoll()
+{
+	BarMatrix m;
+	m.reset(specs({ "5m", "1m" }));
+	CHECK(m.finestInterval() == 60);
+	m.addSymbol(0, 1010 * SEC);
+	size_t min = m.row(0, 1), five = m.row(0, 0);
+	CHECK(m.start(min) == 960 * SEC && m.end(min) == 1020 * SEC);
+	CHECK(m.start(five) == 900 * SEC);
+
+	std::vector<size_t> done;
+	m.onTrade(0, 5, 2, 1015 * SEC, done);
+	m.onTime(0, 1020 * SEC, done);
+	// 1020s is no 5 minute boundary, only the minute is done
+	CHECK(done.size() == 1 && done[0] == min);
+	CHECK(m.count(min) == 1 && m.close(min) == 5);
+	CHECK(m.count(five) == 1 && m.volume(five) == 2);
+	m.roll(min, 1020 * SEC);
+	CHECK(m.count(min) == 0 && m.start(min) == 1020 * SEC && m.end(min) == 1080 * SEC);
+
+	done.clear();
+	m.onTrade(0, 7, 1, 1100 * SEC, done);
+	m.onTime(0, 1200 * SEC, done);
+	CHECK(done.size() == 2 && done[0] == min && done[1] == five);
+	CHECK(m.open(five) == 5 && m.close(five) == 7 && m.volume(five) == 3 && m.count(five) == 2);
+}
+
+// rolls every symbol with stores on the boundary and keeps its done bars,
+// the way DataCenter::roll_bars and publish_bars do
+static void rollAll(BarMatrix& m, std::vector<std::vector<std::unique_ptr<BarStore>>>& stores, uint64_t boundary)
+{
+	std::vector<size_t> done;
+	for (uint32_t sid = 0; sid < stores.size(); ++sid) {
+		if (!m.has(sid) || stores[sid].empty())
+			continue;
+		done.clear();
+		m.onTime(sid, boundary, done);
+		for (size_t r : done) {
+			stores[sid][m.slotOf(r)]->push(BarRecord{ m.start(r), m.end(r), m.open(r), m.high(r),
+				m.low(r), m.close(r), m.volume(r), m.count(r) });
+			m.roll(r, boundary);
+		}
+	}
+}
+
+void testRollPastGap()
+{
+	BarMatrix m;
+	m.reset(specs({ "1m" }));
+	// symbol 1 is no configured security: its id has rows but no stores,
+	// symbol 4 is beyond the rows
+	std::vector<std::vector<std::unique_ptr<BarStore>>> stores(5);
+	for (uint32_t sid : { 0u, 2u, 3u, 4u }) {
+		stores[sid].push_back(std::make_unique<BarStore>());
+		stores[sid].back()->open("", 8);
+	}
+	m.addSymbol(3, 960 * SEC);
+	CHECK(m.has(1) && !m.has(4));
+
+	std::vector<size_t> done;
+	for (uint32_t sid = 0; sid < 4; ++sid)
+		m.onTrade(sid, 100 + sid, 1, 1000 * SEC, done);
+	CHECK(done.empty());
+	rollAll(m, stores, 1020 * SEC);
+
+	BarRecord b;
+	for (uint32_t sid : { 0u, 2u, 3u }) {
+		CHECK(stores[sid][0]->size() == 1);
+		CHECK(stores[sid][0]->at(0, b) && b.close_ == 100 + sid && b.end_ == 1020 * SEC);
+		CHECK(m.start(m.row(sid, 0)) == 1020 * SEC);
+	}
+	CHECK(stores[4][0]->size() == 0);
+	// not rolled, it has nowhere to go
+	CHECK(m.count(m.row(1, 0)) == 1);
+}
+
+int main()
+{
+	testParse();
+	testTrades();
+	testTimeRoll();
+	testRollPastGap();
+	printf("%s\n", failures ? "test_barmatrix FAILED" : "test_barmatrix passed");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,168 @@
+// EFrameScanner: framing the pre-V100 stream whatever way it is cut into
+// reads, long lists trickling in, and an incomplete message framed as soon as
+// the socket is drained with the rest of it
+#include "EFrameScanner.h"
+#include "EDecoder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+static const int SERVER_VERSION = 76;		// the last one before V100
+
+static void field(std::string& m, const std::string& f)
+{
+	m += f;
+	m.push_back('\0');
+}
+
+static std::string currentTime(int t)
+{
+	std::string m;
+	field(m, std::to_string(CURRENT_TIME));
+	field(m, "1");
+	field(m, std::to_string(t));
+	return m;
+}
+
+static std::string historicalData(int bars)
+{
+	std::string m;
+	field(m, std::to_string(HISTORICAL_DATA));
+	field(m, "3");
+	field(m, "6001");
+	field(m, "20260101 09:30:00");
+	field(m, "20260102 16:00:00");
+	field(m, std::to_string(bars));
+	for (int i = 0; i < bars; ++i) {
+		field(m, std::to_string(1767259800 + 5 * i));
+		field(m, "101.25");
+		field(m, "101.5");
+		field(m, "101");
+		field(m, "101.25");
+		field(m, "1200");
+		field(m, "101.2");
+		field(m, "false");
+		field(m, "17");
+	}
+	return m;
+}
+
+// the stream handed over in reads of the given sizes, each one draining the
+// socket; false when a framed message is not the next one expected
+static bool scan(const std::vector<std::string>& msgs, const std::vector<size_t>& reads, size_t& framed)
+{
+	std::string stream;
+	for (const std::string& m : msgs)
+		stream += m;
+
+	EFrameScanner scanner;
+	size_t off = 0;
+	framed = 0;
+
+	for (size_t r = 0; off < stream.size(); ++r) {
+		size_t want = r < reads.size() ? reads[r] : stream.size() - off;
+		while (want > 0 && off < stream.size()) {
+			size_t avail = 0;
+			char* buf = scanner.receiveSpace(avail);
+			size_t n = std::min(std::min(want, avail), stream.size() - off);
+			memcpy(buf, stream.data() + off, n);
+			scanner.received(n);
+			off += n;
+			want -= n;
+		}
+
+		const char* msg = 0;
+		int size;
+		while ((size = scanner.next(msg, SERVER_VERSION, true)) != 0) {
+			if (size < 0 || framed >= msgs.size() || (size_t)size != msgs[framed].size()
+				|| memcmp(msg, msgs[framed].data(), size) != 0)
+				return false;
+			scanner.pop(size);
+			++framed;
+		}
+	}
+	return scanner.empty();
+}
+
+void testEverySplit()
+{
+	std::vector<std::string> msgs = { currentTime(1), historicalData(3), currentTime(2) };
+	size_t total = 0;
+	for (const std::string& m : msgs)
+		total += m.size();
+
+	for (size_t k = 1; k < total; ++k) {
+		size_t framed = 0;
+		CHECK(scan(msgs, { k }, framed) && framed == msgs.size());
+	}
+
+	// a byte at a time
+	size_t framed = 0;
+	CHECK(scan(msgs, std::vector<size_t>(total, 1), framed) && framed == msgs.size());
+}
+
+void testLongList()
+{
+	// far more than the receive buffer, in segments of a TCP packet
+	std::vector<std::string> msgs = { historicalData(20000), currentTime(3) };
+	std::vector<size_t> reads(msgs[0].size() / 1460 + 2, 1460);
+	size_t framed = 0;
+	CHECK(scan(msgs, reads, framed) && framed == msgs.size());
+
+	// nothing is framed before the last bar is in
+	EFrameScanner scanner;
+	const std::string& m = msgs[0];
+	const char* msg = 0;
+	size_t off = 0;
+	while (off < m.size()) {
+		size_t avail = 0;
+		char* buf = scanner.receiveSpace(avail);
+		size_t n = std::min(std::min<size_t>(1460, avail), m.size() - off);
+		memcpy(buf, m.data() + off, n);
+		scanner.received(n);
+		off += n;
+		int size = scanner.next(msg, SERVER_VERSION, true);
+		CHECK(size == (off == m.size() ? (int)m.size() : 0));
+	}
+}
+
+void testDrained()
+{
+	std::string m = currentTime(4);
+	EFrameScanner scanner;
+	const char* msg = 0;
+	size_t avail = 0;
+
+	char* buf = scanner.receiveSpace(avail);
+	memcpy(buf, m.data(), 4);
+	scanner.received(4);
+	CHECK(scanner.next(msg, SERVER_VERSION, true) == 0);
+
+	// the rest came but more may be waiting on the socket
+	buf = scanner.receiveSpace(avail);
+	memcpy(buf, m.data() + 4, m.size() - 4);
+	scanner.received(m.size() - 4);
+	CHECK(scanner.next(msg, SERVER_VERSION, false) == 0);
+
+	// drained without another byte: framed, no timer involved
+	CHECK(scanner.next(msg, SERVER_VERSION, true) == (int)m.size());
+	scanner.pop(m.size());
+	CHECK(scanner.empty());
+}
+
+int main()
+{
+	testEverySplit();
+	testLongList();
+	testDrained();
+	printf("%s\n", failures ? "test_framescanner FAILED" : "test_framescanner passed");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,129 @@
+// IBOrderTable: orders found by either id, removal shifting back the entries
+// probed past the hole, and the live orders of every symbol in order
+#include "Brokers/IB981/ibordertable.h"
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+using namespace MarketRobot;
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+static IBOrderTable::OrderPtr order(int64_t brokerOrderId, int64_t serverOrderId)
+{
+	IBOrderTable::OrderPtr o = std::make_shared<Order>();
+	o->brokerOrderId = brokerOrderId;
+	o->serverOrderId = serverOrderId;
+	return o;
+}
+
+static std::vector<int64_t> live(const IBOrderTable& t, uint32_t sid)
+{
+	std::vector<int64_t> ids;
+	t.forEachLive(sid, [&](const IBOrderTable::OrderPtr& o) { ids.push_back(o->brokerOrderId); });
+	return ids;
+}
+
+void testAddFind()
+{
+	IBOrderTable t(8);
+	CHECK(t.capacity() == 8 && t.size() == 0);
+
+	CHECK(t.add(order(1, 101), 0));
+	CHECK(t.add(order(2, 102), 1));
+	CHECK(t.size() == 2);
+	CHECK(t.byBrokerOrderId(1) && (*t.byBrokerOrderId(1))->serverOrderId == 101);
+	CHECK(t.byServerOrderId(102) && (*t.byServerOrderId(102))->brokerOrderId == 2);
+	CHECK(!t.byBrokerOrderId(3) && !t.byServerOrderId(1));
+
+	// same IB order id: replaced, not added
+	CHECK(t.add(order(1, 111), 0));
+	CHECK(t.size() == 2 && (*t.byBrokerOrderId(1))->serverOrderId == 111);
+	CHECK(!t.byServerOrderId(101));
+
+	for (int64_t id = 3; id <= 8; ++id)
+		CHECK(t.add(order(id, 100 + id), 2));
+	CHECK(!t.add(order(9, 109), 2));		// slab full
+	CHECK(t.size() == 8);
+
+	t.clear();
+	CHECK(t.size() == 0 && !t.byBrokerOrderId(1) && live(t, 2).empty());
+	CHECK(t.add(order(9, 109), 2));
+}
+
+void testBackwardShift()
+{
+	// scattered ids fill the table half way, as far as it goes, so removals
+	// leave holes in the middle of long probe runs
+	const int n = 256;
+	IBOrderTable t(n);
+	std::vector<int64_t> ids;
+	uint64_t x = 88172645463325252ull;
+	for (int i = 0; i < n; ++i) {
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		ids.push_back((int64_t)(x >> 1));
+		CHECK(t.add(order(ids[i], ids[i] ^ 0x5555), (uint32_t)(i % 3)));
+	}
+
+	for (int i = 0; i < n; i += 2)
+		t.remove(ids[i]);
+	CHECK(t.size() == n / 2);
+
+	for (int i = 0; i < n; ++i) {
+		bool kept = i % 2 == 1;
+		CHECK((t.byBrokerOrderId(ids[i]) != nullptr) == kept);
+		CHECK((t.byServerOrderId(ids[i] ^ 0x5555) != nullptr) == kept);
+	}
+
+	// the freed slots are taken again and everything is still found
+	for (int i = 0; i < n; i += 2)
+		CHECK(t.add(order(ids[i] + 1, ids[i] + 2), 0));
+	CHECK(t.size() == n);
+	for (int i = 0; i < n; ++i) {
+		int64_t id = i % 2 ? ids[i] : ids[i] + 1;
+		CHECK(t.byBrokerOrderId(id) && (*t.byBrokerOrderId(id))->brokerOrderId == id);
+	}
+
+	t.remove(12345);		// not there
+	CHECK(t.size() == n);
+}
+
+void testLiveBySymbol()
+{
+	IBOrderTable t(16);
+	for (int64_t id = 1; id <= 6; ++id)
+		CHECK(t.add(order(id, 100 + id), (uint32_t)(id % 2)));
+
+	CHECK(live(t, 1) == std::vector<int64_t>({ 1, 3, 5 }));
+	CHECK(live(t, 0) == std::vector<int64_t>({ 2, 4, 6 }));
+	CHECK(live(t, 7).empty());
+
+	// head, middle and tail of a list
+	t.remove(1);
+	CHECK(live(t, 1) == std::vector<int64_t>({ 3, 5 }));
+	t.remove(4);
+	CHECK(live(t, 0) == std::vector<int64_t>({ 2, 6 }));
+	t.remove(6);
+	CHECK(live(t, 0) == std::vector<int64_t>({ 2 }));
+
+	// a replaced order moves to the back of its symbol
+	CHECK(t.add(order(3, 203), 1));
+	CHECK(live(t, 1) == std::vector<int64_t>({ 5, 3 }));
+	CHECK(t.add(order(7, 107), 0));
+	CHECK(live(t, 0) == std::vector<int64_t>({ 2, 7 }));
+}
+
+int main()
+{
+	testAddFind();
+	testBackwardShift();
+	testLiveBySymbol();
+	printf("%s\n", failures ? "test_ibordertable FAILED" : "test_ibordertable passed");
+	return failures ? 1 : 0;
+}
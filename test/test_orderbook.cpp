@@ -0,0 +1,99 @@
+// OrderBook: IB market depth operations into the fixed-depth ladder, the
+// level falling off a full side and the operations the book refuses
+#include "DataCenter/orderbook.h"
+
+#include <cstdio>
+
+using namespace MR::DC;
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+static bool levelIs(const OrderBook& b, int side, int position, double price, int64_t size)
+{
+	return b.level(side, position).price_ == price && b.level(side, position).size_ == size;
+}
+
+void testInsertUpdateDelete()
+{
+	OrderBook b;
+	CHECK(b.depth(OrderBook::SIDE_BID) == 0 && b.best(OrderBook::SIDE_BID).price_ == 0 && b.seq() == 0);
+
+	CHECK(b.apply(0, OrderBook::OP_INSERT, OrderBook::SIDE_BID, 100.0, 5));
+	CHECK(b.apply(1, OrderBook::OP_INSERT, OrderBook::SIDE_BID, 99.5, 7));
+	// a better price goes in front and pushes the others back
+	CHECK(b.apply(0, OrderBook::OP_INSERT, OrderBook::SIDE_BID, 100.5, 2));
+	CHECK(b.depth(OrderBook::SIDE_BID) == 3);
+	CHECK(levelIs(b, OrderBook::SIDE_BID, 0, 100.5, 2));
+	CHECK(levelIs(b, OrderBook::SIDE_BID, 1, 100.0, 5));
+	CHECK(levelIs(b, OrderBook::SIDE_BID, 2, 99.5, 7));
+	CHECK(b.totalSize(OrderBook::SIDE_BID) == 14);
+
+	CHECK(b.apply(1, OrderBook::OP_UPDATE, OrderBook::SIDE_BID, 100.0, 9));
+	CHECK(levelIs(b, OrderBook::SIDE_BID, 1, 100.0, 9) && b.totalSize(OrderBook::SIDE_BID) == 18);
+	// an update of the level behind the last one adds it
+	CHECK(b.apply(3, OrderBook::OP_UPDATE, OrderBook::SIDE_BID, 99.0, 1));
+	CHECK(b.depth(OrderBook::SIDE_BID) == 4 && b.totalSize(OrderBook::SIDE_BID) == 19);
+
+	CHECK(b.apply(0, OrderBook::OP_DELETE, OrderBook::SIDE_BID, 0, 0));
+	CHECK(b.depth(OrderBook::SIDE_BID) == 3);
+	CHECK(levelIs(b, OrderBook::SIDE_BID, 0, 100.0, 9));
+	CHECK(levelIs(b, OrderBook::SIDE_BID, 2, 99.0, 1));
+	CHECK(levelIs(b, OrderBook::SIDE_BID, 3, 0, 0));
+	CHECK(b.totalSize(OrderBook::SIDE_BID) == 17);
+
+	// the sides do not see each other
+	CHECK(b.depth(OrderBook::SIDE_ASK) == 0 && b.totalSize(OrderBook::SIDE_ASK) == 0);
+	CHECK(b.seq() == 6);
+
+	b.clear();
+	CHECK(b.depth(OrderBook::SIDE_BID) == 0 && b.totalSize(OrderBook::SIDE_BID) == 0 && b.seq() == 0);
+}
+
+void testFullSide()
+{
+	OrderBook b;
+	for (int i = 0; i < BOOK_DEPTH; ++i)
+		CHECK(b.apply(i, OrderBook::OP_INSERT, OrderBook::SIDE_ASK, 10.0 + i, 1 + i));
+	CHECK(b.depth(OrderBook::SIDE_ASK) == BOOK_DEPTH);
+
+	// the last level falls off and its size leaves the total
+	CHECK(b.apply(0, OrderBook::OP_INSERT, OrderBook::SIDE_ASK, 9.5, 100));
+	CHECK(b.depth(OrderBook::SIDE_ASK) == BOOK_DEPTH);
+	CHECK(levelIs(b, OrderBook::SIDE_ASK, 0, 9.5, 100));
+	CHECK(levelIs(b, OrderBook::SIDE_ASK, BOOK_DEPTH - 1, 10.0 + BOOK_DEPTH - 2, BOOK_DEPTH - 1));
+
+	int64_t total = 0;
+	for (int i = 0; i < BOOK_DEPTH; ++i)
+		total += b.level(OrderBook::SIDE_ASK, i).size_;
+	CHECK(b.totalSize(OrderBook::SIDE_ASK) == total);
+}
+
+void testRefused()
+{
+	OrderBook b;
+	CHECK(b.apply(0, OrderBook::OP_INSERT, OrderBook::SIDE_BID, 100.0, 5));
+	OrderBook before = b;
+
+	CHECK(!b.apply(2, OrderBook::OP_INSERT, OrderBook::SIDE_BID, 99.0, 1));		// leaves a hole
+	CHECK(!b.apply(2, OrderBook::OP_UPDATE, OrderBook::SIDE_BID, 99.0, 1));
+	CHECK(!b.apply(1, OrderBook::OP_DELETE, OrderBook::SIDE_BID, 0, 0));		// nothing there
+	CHECK(!b.apply(BOOK_DEPTH, OrderBook::OP_INSERT, OrderBook::SIDE_BID, 99.0, 1));
+	CHECK(!b.apply(-1, OrderBook::OP_UPDATE, OrderBook::SIDE_BID, 99.0, 1));
+	CHECK(!b.apply(0, OrderBook::OP_INSERT, 2, 99.0, 1));
+	CHECK(!b.apply(0, 3, OrderBook::SIDE_BID, 99.0, 1));
+
+	CHECK(b.depth(OrderBook::SIDE_BID) == 1 && b.seq() == before.seq());
+	CHECK(levelIs(b, OrderBook::SIDE_BID, 0, 100.0, 5) && b.totalSize(OrderBook::SIDE_BID) == 5);
+}
+
+int main()
+{
+	testInsertUpdateDelete();
+	testFullSide();
+	testRefused();
+	printf("%s\n", failures ? "test_orderbook FAILED" : "test_orderbook passed");
+	return failures ? 1 : 0;
+}
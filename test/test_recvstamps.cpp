@@ -0,0 +1,89 @@
+// ERecvStamps: frames take the arrival time of their batch, also once the
+// stamp queue ran full
+#include "ERecvStamps.h"
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+// batch i ends at ring position 100 * (i + 1) and arrived at 1000 + i
+static size_t batchEnd(size_t i) { return 100 * (i + 1); }
+static uint64_t batchTime(size_t i) { return 1000 + i; }
+
+void testInOrder()
+{
+	ERecvStamps stamps;
+	CHECK(stamps.lookUp(0) == 0);		// published, not stamped yet
+	for (size_t i = 0; i < 10; ++i)
+		stamps.stamp(batchEnd(i), batchTime(i));
+	CHECK(stamps.lookUp(0) == batchTime(0));
+	CHECK(stamps.lookUp(99) == batchTime(0));
+	CHECK(stamps.lookUp(100) == batchTime(1));
+	CHECK(stamps.lookUp(950) == batchTime(9));
+	CHECK(stamps.lookUp(1000) == 0);
+}
+
+void testFull()
+{
+	ERecvStamps stamps;
+	const size_t batches = RECV_STAMPS_DEFAULT + 50;
+	for (size_t i = 0; i < batches; ++i)
+		stamps.stamp(batchEnd(i), batchTime(i));
+
+	// the batches stamped while the queue was full take the last time, none
+	// is left with the time of a batch before them or without one
+	size_t newest = RECV_STAMPS_DEFAULT - 1;
+	CHECK(stamps.lookUp(0) == batchTime(0));
+	CHECK(stamps.lookUp(batchEnd(newest - 1) - 1) == batchTime(newest - 1));
+	CHECK(stamps.lookUp(batchEnd(newest - 1)) == batchTime(batches - 1));
+	CHECK(stamps.lookUp(batchEnd(batches - 1) - 1) == batchTime(batches - 1));
+
+	// room again, the next batch is stamped on its own
+	stamps.stamp(batchEnd(batches), batchTime(batches));
+	CHECK(stamps.lookUp(batchEnd(batches) - 1) == batchTime(batches));
+}
+
+// a reader stamping while the consumer looks up, the consumer mostly far behind
+void testConcurrent()
+{
+	ERecvStamps stamps;
+	const size_t batches = 200000;
+	std::atomic<size_t> published(0);
+
+	std::thread reader([&] {
+		for (size_t i = 0; i < batches; ++i) {
+			published.store(batchEnd(i), std::memory_order_release);
+			stamps.stamp(batchEnd(i), batchTime(i));
+		}
+	});
+
+	// a frame never takes a time older than its batch's or newer than the last stamp
+	uint64_t last = 0;
+	for (size_t pos = 0; pos < batchEnd(batches - 1); pos += 37) {
+		while (published.load(std::memory_order_acquire) <= pos)
+			;
+		uint64_t time = stamps.lookUp(pos);
+		if (time == 0)
+			continue;
+		CHECK(time >= batchTime(pos / 100));
+		CHECK(time >= last);
+		if (time < batchTime(pos / 100) || time < last)
+			break;
+		last = time;
+	}
+	reader.join();
+}
+
+int main()
+{
+	testInOrder();
+	testFull();
+	testConcurrent();
+	printf("%s\n", failures ? "test_recvstamps FAILED" : "test_recvstamps passed");
+	return failures ? 1 : 0;
+}
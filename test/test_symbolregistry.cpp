@@ -0,0 +1,93 @@
+// SymbolRegistry: dense ids, lookups across the table growing, and readers
+// that never see a symbol before it is all there
+#include "DataCenter/symbolregistry.h"
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+using namespace MR::DC;
+
+static int failures = 0;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+static std::string name(const char* prefix, uint32_t i)
+{
+	return std::string(prefix) + std::to_string(i) + " STK SMART";
+}
+
+void testIntern()
+{
+	SymbolRegistry& r = SymbolRegistry::instance();
+	uint32_t first = r.size();
+
+	uint32_t a = r.intern("AAPL STK SMART");
+	uint32_t b = r.intern("MSFT STK SMART");
+	CHECK(a == first && b == first + 1);
+	CHECK(r.intern("AAPL STK SMART") == a);
+	CHECK(r.size() == first + 2);
+
+	CHECK(r.id("MSFT STK SMART") == b);
+	CHECK(r.id("IBM STK SMART") == SymbolRegistry::INVALID_ID);
+	CHECK(r.symbol(a) == "AAPL STK SMART" && r.symbol(b) == "MSFT STK SMART");
+}
+
+void testGrowth()
+{
+	SymbolRegistry& r = SymbolRegistry::instance();
+	uint32_t first = r.size();
+
+	// the table starts at 1024 slots and doubles at half full, a few times over
+	const uint32_t n = 5000;
+	for (uint32_t i = 0; i < n; ++i)
+		CHECK(r.intern(name("G", i)) == first + i);
+
+	for (uint32_t i = 0; i < n; ++i) {
+		CHECK(r.id(name("G", i)) == first + i);
+		CHECK(r.symbol(first + i) == name("G", i));
+	}
+	CHECK(r.size() == first + n);
+}
+
+void testConcurrentLookups()
+{
+	SymbolRegistry& r = SymbolRegistry::instance();
+	const uint32_t n = 20000;
+	std::atomic<bool> done(false);
+	std::atomic<int> torn(0);
+
+	std::thread reader([&] {
+		while (!done.load(std::memory_order_acquire)) {
+			uint32_t size = r.size();
+			for (uint32_t i = 0; i < n; i += 97) {
+				uint32_t id = r.id(name("C", i));
+				// not interned yet, or interned with its whole name
+				if (id != SymbolRegistry::INVALID_ID && (id >= r.size() || r.symbol(id) != name("C", i)))
+					++torn;
+			}
+			if (size > 0 && r.symbol(size - 1).empty())
+				++torn;
+		}
+	});
+
+	for (uint32_t i = 0; i < n; ++i)
+		r.intern(name("C", i));
+	done.store(true, std::memory_order_release);
+	reader.join();
+
+	CHECK(torn.load() == 0);
+	for (uint32_t i = 0; i < n; i += 97)
+		CHECK(r.id(name("C", i)) != SymbolRegistry::INVALID_ID);
+}
+
+int main()
+{
+	testIntern();
+	testGrowth();
+	testConcurrentLookups();
+	printf("%s\n", failures ? "test_symbolregistry FAILED" : "test_symbolregistry passed");
+	return failures ? 1 : 0;
+}